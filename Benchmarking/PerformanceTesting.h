@@ -17,6 +17,8 @@
 #define SPEED_TEST_4_WARN_COUNT    000
 #define SPEED_TEST_4_ERROR_COUNT   100
 
+#define CONTENTION_TEST_COUNT 10000 // Log statements per thread
+
 // Further documentation on these tests may be found in the implementation file.
 
 @interface PerformanceTesting : NSObject
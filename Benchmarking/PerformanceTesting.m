@@ -36,6 +36,18 @@
  * DynamicLogging use a non-const log level, meaning each log statement will incur an integer comparison penalty.
 **/
 
+// Does nothing, so that the contention test only measures how log statements reach the logging queue.
+@interface ContentionLogger : DDAbstractLogger
+@end
+
+@implementation ContentionLogger
+
+- (void)logMessage:(DDLogMessage *)logMessage
+{
+}
+
+@end
+
 @implementation PerformanceTesting
 
 static NSTimeInterval base[5][3]; // [test][min,avg,max]
@@ -322,14 +334,94 @@ static DDFileLogger *fileLogger = nil;
 	return str;
 }
 
+/**
+ * Contention test - Several threads executing asynchronous log statements at the same time.
+ * 
+ * Each ingress mode of DDLog is measured with 1, 2, 4, 8 and 16 threads,
+ * each thread executing CONTENTION_TEST_COUNT log statements.
+ * The logger does nothing, so the results show what it costs to hand the log messages over to the logging queue.
+ * The closer the throughput grows to linearly with the number of threads (up to the number of cores),
+ * the better the ingress mode scales.
+**/
++ (NSString *)executeContentionTests
+{
+	NSMutableString *str = [NSMutableString stringWithCapacity:1000];
+	
+	[str appendFormat:@"Results are given as log statements per second, calculated over the course of %i runs.\n", NUMBER_OF_RUNS];
+	[str appendString:@"The first number is measured until all threads are done, the second one until the logger got every message.\n"];
+	[str appendString:@"\n"];
+	
+	DDLogIngressMode modes[] = { DDLogIngressModeDispatch, DDLogIngressModeRingBuffer, DDLogIngressModeShardedRingBuffer };
+	NSString *modeNames[] = { @"Dispatch         ", @"RingBuffer       ", @"ShardedRingBuffer" };
+	
+	for (int m = 0; m < 3; m++)
+	{
+		DDLog *log = [[DDLog alloc] init];
+		log.ingressMode = modes[m];
+		[log addLogger:[[ContentionLogger alloc] init]];
+		
+		for (NSUInteger threadCount = 1; threadCount <= 16; threadCount *= 2)
+		{
+			NSTimeInterval producersTotal = 0.0;
+			NSTimeInterval flushedTotal = 0.0;
+			
+			for (int k = 0; k < NUMBER_OF_RUNS; k++)
+			{
+				@autoreleasepool {
+				
+					// Real threads, as dispatch_apply wouldn't run more iterations at once than there are cores.
+					dispatch_group_t group = dispatch_group_create();
+					dispatch_semaphore_t start = dispatch_semaphore_create(0);
+					
+					for (NSUInteger t = 0; t < threadCount; t++)
+					{
+						dispatch_group_enter(group);
+						[NSThread detachNewThreadWithBlock:^{
+							dispatch_semaphore_wait(start, DISPATCH_TIME_FOREVER);
+							for (int i = 0; i < CONTENTION_TEST_COUNT; i++)
+							{
+								[log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"Contention %i", i];
+							}
+							dispatch_group_leave(group);
+						}];
+					}
+					
+					NSDate *startDate = [NSDate date];
+					
+					for (NSUInteger t = 0; t < threadCount; t++)
+					{
+						dispatch_semaphore_signal(start);
+					}
+					dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+					producersTotal += [startDate timeIntervalSinceNow] * -1.0;
+					
+					[log flushLog];
+					flushedTotal += [startDate timeIntervalSinceNow] * -1.0;
+				
+				}
+			}
+			
+			double statementCount = (double)threadCount * CONTENTION_TEST_COUNT * NUMBER_OF_RUNS;
+			[str appendFormat:@"%@ %2lu threads:[%.0f][%.0f]\n", modeNames[m], (unsigned long)threadCount,
+			       statementCount / producersTotal, statementCount / flushedTotal];
+		}
+		
+		[log removeAllLoggers];
+		[str appendString:@"\n"];
+	}
+	
+	return str;
+}
+
 + (void)startPerformanceTests
 {
 	BOOL runBase   = YES;
 	BOOL runSuite1 = YES;
 	BOOL runSuite2 = YES;
 	BOOL runSuite3 = YES;
+	BOOL runContention = YES;
 	
-	if (!runBase && !runSuite1 && !runSuite2 && !runSuite3)
+	if (!runBase && !runSuite1 && !runSuite2 && !runSuite3 && !runContention)
 	{
 		// Nothing to do, all suites disabled
 		return;
@@ -377,6 +469,13 @@ static DDFileLogger *fileLogger = nil;
 		NSLog(@"\n\n\n\n");
 	}
 	
+	NSString *contentionResults = nil;
+	
+	if (runContention)
+	{
+		contentionResults = [self executeContentionTests];
+	}
+	
 	if (runSuite1)
 	{
 		NSLog(@"======================================================================");
@@ -401,6 +500,14 @@ static DDFileLogger *fileLogger = nil;
 		NSLog(@"\n\n%@", printableResults3);
 		NSLog(@"======================================================================");
 	}
+	if (runContention)
+	{
+		NSLog(@"======================================================================");
+		NSLog(@"Contention:");
+		NSLog(@"Several threads logging asynchronously at the same time, for each ingress mode.");
+		NSLog(@"\n\n%@", contentionResults);
+		NSLog(@"======================================================================");
+	}
 	
 #if TARGET_OS_IPHONE
 	NSString *csvResultsPath = [@"~/Documents/LumberjackBenchmark.csv" stringByExpandingTildeInPath];
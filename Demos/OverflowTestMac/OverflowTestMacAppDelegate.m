@@ -31,8 +31,10 @@ static const DDLogLevel ddLogLevel = DDLogLevelVerbose;
     // This Xcode project demonstrates this feature by using a "Slow Logger".
     
     NSLog(@"How to use this test:");
-    NSLog(@"1. Set the DEBUG definition to YES in DDLog.m");
-    NSLog(@"2. Set the LOG_MAX_QUEUE_SIZE definition to 5 in DDLog.m\n\n");
+    NSLog(@"1. Set the DD_DEBUG definition to 1 in DDLog.m");
+    NSLog(@"2. Try the other overflow policies (DDLog.overflowPolicy)\n\n");
+    
+    DDLog.sharedInstance.maximumQueueSize = 5;
     
     SlowLogger *slowLogger = [[SlowLogger alloc] init];
     [DDLog addLogger:slowLogger];
@@ -80,7 +80,7 @@ static DDASLLogger *sharedInstance;
         return;
     }
 
-    __auto_type message = _logFormatter ? [_logFormatter formatLogMessage:logMessage] : logMessage->_message;
+    __auto_type message = _logFormatter ? [logMessage formattedMessageUsingFormatter:_logFormatter] : logMessage.message;
 
     if (message) {
         __auto_type msg = [message UTF8String];
@@ -218,7 +218,7 @@
     DDAbstractLoggerAssertLockedPropertyAccess();
 
     __block NSUInteger result;
-    dispatch_sync(DDLog.loggingQueue, ^{
+    dispatch_sync(self.owningLoggingQueue, ^{
         dispatch_sync(self.loggerQueue, ^{
             result = self->_saveThreshold;
         });
@@ -252,7 +252,7 @@
         block();
     } else {
         DDAbstractLoggerAssertNotOnGlobalLoggingQueue();
-        dispatch_async(DDLog.loggingQueue, ^{
+        dispatch_async(self.owningLoggingQueue, ^{
             dispatch_async(self.loggerQueue, block);
         });
     }
@@ -272,7 +272,7 @@
     DDAbstractLoggerAssertLockedPropertyAccess();
 
     __block NSTimeInterval result;
-    dispatch_sync(DDLog.loggingQueue, ^{
+    dispatch_sync(self.owningLoggingQueue, ^{
         dispatch_sync(self.loggerQueue, ^{
             result = self->_saveInterval;
         });
@@ -337,7 +337,7 @@
         block();
     } else {
         DDAbstractLoggerAssertNotOnGlobalLoggingQueue();
-        dispatch_async(DDLog.loggingQueue, ^{
+        dispatch_async(self.owningLoggingQueue, ^{
             dispatch_async(self.loggerQueue, block);
         });
     }
@@ -358,7 +358,7 @@
 
     __block NSTimeInterval result;
 
-    dispatch_sync(DDLog.loggingQueue, ^{
+    dispatch_sync(self.owningLoggingQueue, ^{
         dispatch_sync(self.loggerQueue, ^{
             result = self->_maxAge;
         });
@@ -429,7 +429,7 @@
         block();
     } else {
         DDAbstractLoggerAssertNotOnGlobalLoggingQueue();
-        dispatch_async(DDLog.loggingQueue, ^{
+        dispatch_async(self.owningLoggingQueue, ^{
             dispatch_async(self.loggerQueue, block);
         });
     }
@@ -450,7 +450,7 @@
 
     __block NSTimeInterval result;
 
-    dispatch_sync(DDLog.loggingQueue, ^{
+    dispatch_sync(self.owningLoggingQueue, ^{
         dispatch_sync(self.loggerQueue, ^{
             result = self->_deleteInterval;
         });
@@ -515,7 +515,7 @@
     } else {
         DDAbstractLoggerAssertNotOnGlobalLoggingQueue();
 
-        dispatch_async(DDLog.loggingQueue, ^{
+        dispatch_async(self.owningLoggingQueue, ^{
             dispatch_async(self.loggerQueue, block);
         });
     }
@@ -536,7 +536,7 @@
 
     __block BOOL result;
 
-    dispatch_sync(DDLog.loggingQueue, ^{
+    dispatch_sync(self.owningLoggingQueue, ^{
         dispatch_sync(self.loggerQueue, ^{
             result = self->_deleteOnEverySave;
         });
@@ -557,7 +557,7 @@
         block();
     } else {
         DDAbstractLoggerAssertNotOnGlobalLoggingQueue();
-        dispatch_async(DDLog.loggingQueue, ^{
+        dispatch_async(self.owningLoggingQueue, ^{
             dispatch_async(self.loggerQueue, block);
         });
     }
@@ -625,6 +625,41 @@
     }
 }
 
+- (void)logMessages:(NSArray<DDLogMessage *> *)logMessages {
+    // Subclasses customizing logMessage: must still see every log message.
+    if ([self methodForSelector:@selector(logMessage:)] != [DDAbstractDatabaseLogger instanceMethodForSelector:@selector(logMessage:)]) {
+        for (DDLogMessage *logMessage in logMessages) {
+            @autoreleasepool {
+                [self logMessage:logMessage];
+            }
+        }
+        return;
+    }
+
+    // Same as logMessage:, but the save threshold and the save timer are only checked once per batch.
+    __auto_type firstUnsavedEntry = (_unsavedCount == 0);
+    NSUInteger loggedCount = 0;
+
+    for (DDLogMessage *logMessage in logMessages) {
+        if ([self db_log:logMessage]) {
+            loggedCount++;
+        }
+    }
+
+    if (loggedCount == 0) {
+        return;
+    }
+
+    _unsavedCount += loggedCount;
+
+    if ((_unsavedCount >= _saveThreshold) && (_saveThreshold > 0)) {
+        [self performSaveAndSuspendSaveTimer];
+    } else if (firstUnsavedEntry) {
+        _unsavedTime = dispatch_time(DISPATCH_TIME_NOW, 0);
+        [self updateAndResumeSaveTimer];
+    }
+}
+
 - (void)flush {
     // This method is invoked by DDLog's flushLog method.
     //
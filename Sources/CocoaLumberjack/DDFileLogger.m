@@ -20,6 +20,8 @@
 #import <sys/xattr.h>
 #import <sys/file.h>
 #import <errno.h>
+#import <stdatomic.h>
+#import <time.h>
 #import <unistd.h>
 
 #import "DDFileLogger+Internal.h"
@@ -53,6 +55,11 @@ unsigned long long const kDDDefaultLogFilesDiskQuota   = 20 * 1024 * 1024; // 20
 
 NSTimeInterval     const kDDRollingLeeway              = 1.0;              // 1s
 
+NSString * const DDFileLoggerStatisticsRollCountKey            = @"rollCount";
+NSString * const DDFileLoggerStatisticsFlushCountKey           = @"flushCount";
+NSString * const DDFileLoggerStatisticsTotalFlushDurationKey   = @"totalFlushDuration";
+NSString * const DDFileLoggerStatisticsMaximumFlushDurationKey = @"maximumFlushDuration";
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark -
@@ -600,7 +607,12 @@ NSTimeInterval     const kDDRollingLeeway              = 1.0;              // 1s
 - (NSString *)formatLogMessage:(DDLogMessage *)logMessage {
     __auto_type dateAndTime = [_dateFormatter stringFromDate:logMessage->_timestamp];
     // Note: There are two spaces between the date and the message.
-    return [NSString stringWithFormat:@"%@  %@", dateAndTime, logMessage->_message];
+    return [NSString stringWithFormat:@"%@  %@", dateAndTime, logMessage.message];
+}
+
+- (BOOL)isPure {
+    // NSDateFormatter is thread-safe, and the output only depends on the message.
+    return YES;
 }
 
 @end
@@ -623,10 +635,22 @@ NSTimeInterval     const kDDRollingLeeway              = 1.0;              // 1s
     unsigned long long _maximumFileSize;
 
     dispatch_queue_t _completionQueue;
+
+    // Statistics, only updated on the logger queue.
+    atomic_ulong _rollCount;
+    atomic_ulong _flushCount;
+    atomic_ullong _totalFlushDuration;
+    atomic_ullong _maximumFlushDuration;
 }
 
 @end
 
+static uint64_t DDFileLoggerMonotonicNanoseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wincomplete-implementation"
 @implementation DDFileLogger
@@ -731,7 +755,7 @@ NSTimeInterval     const kDDRollingLeeway              = 1.0;              // 1s
 
     DDAbstractLoggerAssertLockedPropertyAccess();
 
-    dispatch_sync(DDLog.loggingQueue, ^{
+    dispatch_sync(self.owningLoggingQueue, ^{
         dispatch_sync(self.loggerQueue, block);
     });
 
@@ -760,7 +784,7 @@ NSTimeInterval     const kDDRollingLeeway              = 1.0;              // 1s
 
     DDAbstractLoggerAssertLockedPropertyAccess();
 
-    dispatch_async(DDLog.loggingQueue, ^{
+    dispatch_async(self.owningLoggingQueue, ^{
         dispatch_async(self.loggerQueue, block);
     });
 }
@@ -784,7 +808,7 @@ NSTimeInterval     const kDDRollingLeeway              = 1.0;              // 1s
 
     DDAbstractLoggerAssertLockedPropertyAccess();
 
-    dispatch_sync(DDLog.loggingQueue, ^{
+    dispatch_sync(self.owningLoggingQueue, ^{
         dispatch_sync(self.loggerQueue, block);
     });
 
@@ -813,7 +837,7 @@ NSTimeInterval     const kDDRollingLeeway              = 1.0;              // 1s
 
     DDAbstractLoggerAssertLockedPropertyAccess();
 
-    dispatch_async(DDLog.loggingQueue, ^{
+    dispatch_async(self.owningLoggingQueue, ^{
         dispatch_async(self.loggerQueue, block);
     });
 }
@@ -892,7 +916,7 @@ NSTimeInterval     const kDDRollingLeeway              = 1.0;              // 1s
         block();
     } else {
         DDAbstractLoggerAssertNotOnGlobalLoggingQueue();
-        dispatch_async(DDLog.loggingQueue, ^{
+        dispatch_async(self.owningLoggingQueue, ^{
             dispatch_async(self.loggerQueue, block);
         });
     }
@@ -926,6 +950,7 @@ NSTimeInterval     const kDDRollingLeeway              = 1.0;              // 1s
         [_currentLogFileHandle closeFile];
     }
     _currentLogFileHandle = nil;
+    atomic_fetch_add_explicit(&_rollCount, 1, memory_order_relaxed);
 
     _currentLogFileInfo.isArchived = YES;
 
@@ -974,6 +999,32 @@ NSTimeInterval     const kDDRollingLeeway              = 1.0;              // 1s
     }
 }
 
+- (BOOL)lt_getCurrentLogFileSize:(unsigned long long *)fileSize {
+    if (@available(macOS 10.15, iOS 13.0, tvOS 13.0, watchOS 6.0, *)) {
+        __autoreleasing NSError *error = nil;
+        __auto_type success = [_currentLogFileHandle getOffset:fileSize error:&error];
+        if (!success) {
+            NSLogError(@"DDFileLogger: Failed to get offset: %@", error);
+        }
+        return success;
+    } else {
+        *fileSize = [_currentLogFileHandle offsetInFile];
+        return YES;
+    }
+}
+
+// The number of bytes which can still be written before the log file is rolled due to its size.
+- (unsigned long long)lt_remainingFileSize {
+    DDAbstractLoggerAssertOnInternalLoggerQueue();
+
+    unsigned long long fileSize;
+    if (_maximumFileSize == 0 || [self lt_currentLogFileHandle] == nil || ![self lt_getCurrentLogFileSize:&fileSize]) {
+        return ULLONG_MAX;
+    }
+
+    return fileSize < _maximumFileSize ? _maximumFileSize - fileSize : 0;
+}
+
 - (void)lt_maybeRollLogFileDueToSize {
     DDAbstractLoggerAssertOnInternalLoggerQueue();
 
@@ -985,15 +1036,8 @@ NSTimeInterval     const kDDRollingLeeway              = 1.0;              // 1s
 
     if (_currentLogFileHandle != nil && _maximumFileSize > 0) {
         unsigned long long fileSize;
-        if (@available(macOS 10.15, iOS 13.0, tvOS 13.0, watchOS 6.0, *)) {
-            __autoreleasing NSError *error = nil;
-            __auto_type success = [_currentLogFileHandle getOffset:&fileSize error:&error];
-            if (!success) {
-                NSLogError(@"DDFileLogger: Failed to get offset: %@", error);
-                return;
-            }
-        } else {
-            fileSize = [_currentLogFileHandle offsetInFile];
+        if (![self lt_getCurrentLogFileSize:&fileSize]) {
+            return;
         }
 
         if (fileSize >= _maximumFileSize) {
@@ -1063,7 +1107,7 @@ NSTimeInterval     const kDDRollingLeeway              = 1.0;              // 1s
         info = [self lt_currentLogFileInfo];
     };
 
-    dispatch_sync(DDLog.loggingQueue, ^{
+    dispatch_sync(self.owningLoggingQueue, ^{
         dispatch_sync(self->_loggerQueue, block);
     });
 
@@ -1240,6 +1284,64 @@ static int exception_count = 0;
     [self lt_logData:data];
 }
 
+// Whether a subclass customizes how a single log message is logged, in which case batches are logged one message at a time.
+- (BOOL)lt_customizesMessageLogging {
+    static const SEL selectors[] = {
+        @selector(logMessage:),
+        @selector(willLogMessage:),
+        @selector(didLogMessage:),
+        @selector(lt_dataForMessage:),
+    };
+    for (size_t i = 0; i < sizeof(selectors) / sizeof(selectors[0]); i++) {
+        if ([self methodForSelector:selectors[i]] != [DDFileLogger instanceMethodForSelector:selectors[i]]) {
+            return YES;
+        }
+    }
+
+    // The deprecated hooks are only implemented by subclasses.
+    return [self respondsToSelector:@selector(willLogMessage)] || [self respondsToSelector:@selector(didLogMessage)];
+}
+
+- (void)logMessages:(NSArray<DDLogMessage *> *)logMessages {
+    // Subclasses customizing logMessage:, willLogMessage: or didLogMessage: must still see every log message.
+    if ([self lt_customizesMessageLogging]) {
+        for (DDLogMessage *logMessage in logMessages) {
+            @autoreleasepool {
+                [self logMessage:logMessage];
+            }
+        }
+        return;
+    }
+
+    // One write (and one check whether the log file needs to be rolled) for the whole batch,
+    // unless it fills the log file: it is then split, so that the file is rolled on time.
+    NSMutableData *data = nil;
+    unsigned long long remainingFileSize = 0;
+
+    for (DDLogMessage *logMessage in logMessages) {
+        @autoreleasepool {
+            __auto_type messageData = [self lt_dataForMessage:logMessage];
+            if (messageData.length == 0) {
+                continue;
+            }
+
+            if (data == nil) {
+                data = [NSMutableData dataWithCapacity:messageData.length * logMessages.count];
+                remainingFileSize = [self lt_remainingFileSize];
+            }
+            [data appendData:messageData];
+
+            if (data.length >= remainingFileSize) {
+                // Rolls the log file.
+                [self lt_logData:data];
+                data = nil;
+            }
+        }
+    }
+
+    [self lt_logData:data];
+}
+
 - (void)willLogMessage:(DDLogFileInfo *)logFileInfo {}
 
 - (void)didLogMessage:(DDLogFileInfo *)logFileInfo {
@@ -1254,6 +1356,11 @@ static int exception_count = 0;
     [self lt_rollLogFileNow];
 }
 
+- (BOOL)isDurable {
+    // Every log message is written to the file right away, the kernel keeps it if the process crashes.
+    return YES;
+}
+
 - (void)flush {
     // This method is public.
     // We need to execute the rolling on our logging thread/queue.
@@ -1271,7 +1378,7 @@ static int exception_count = 0;
         block();
     } else {
         DDAbstractLoggerAssertNotOnGlobalLoggingQueue();
-        dispatch_sync(DDLog.loggingQueue, ^{
+        dispatch_sync(self.owningLoggingQueue, ^{
             dispatch_sync(self.loggerQueue, block);
         });
     }
@@ -1281,6 +1388,7 @@ static int exception_count = 0;
     DDAbstractLoggerAssertOnInternalLoggerQueue();
 
     if (_currentLogFileHandle != nil) {
+        __auto_type start = DDFileLoggerMonotonicNanoseconds();
         if (@available(macOS 10.15, iOS 13.0, tvOS 13.0, watchOS 6.0, *)) {
             __autoreleasing NSError *error = nil;
             __auto_type success = [_currentLogFileHandle synchronizeAndReturnError:&error];
@@ -1294,9 +1402,25 @@ static int exception_count = 0;
                 NSLogError(@"DDFileLogger: Failed to synchronize file: %@", exception);
             }
         }
+
+        __auto_type duration = DDFileLoggerMonotonicNanoseconds() - start;
+        atomic_fetch_add_explicit(&_flushCount, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&_totalFlushDuration, duration, memory_order_relaxed);
+        if (duration > atomic_load_explicit(&_maximumFlushDuration, memory_order_relaxed)) {
+            atomic_store_explicit(&_maximumFlushDuration, duration, memory_order_relaxed);
+        }
     }
 }
 
+- (NSDictionary<NSString *, NSNumber *> *)statistics {
+    return @{
+        DDFileLoggerStatisticsRollCountKey: @(atomic_load_explicit(&_rollCount, memory_order_relaxed)),
+        DDFileLoggerStatisticsFlushCountKey: @(atomic_load_explicit(&_flushCount, memory_order_relaxed)),
+        DDFileLoggerStatisticsTotalFlushDurationKey: @((NSTimeInterval)atomic_load_explicit(&_totalFlushDuration, memory_order_relaxed) / NSEC_PER_SEC),
+        DDFileLoggerStatisticsMaximumFlushDurationKey: @((NSTimeInterval)atomic_load_explicit(&_maximumFlushDuration, memory_order_relaxed) / NSEC_PER_SEC),
+    };
+}
+
 - (DDLoggerName)loggerName {
     return DDLoggerNameFile;
 }
@@ -1322,7 +1446,7 @@ static int exception_count = 0;
         block();
     } else {
         DDAbstractLoggerAssertNotOnGlobalLoggingQueue();
-        dispatch_sync(DDLog.loggingQueue, ^{
+        dispatch_sync(self.owningLoggingQueue, ^{
             dispatch_sync(self.loggerQueue, block);
         });
     }
@@ -1442,24 +1566,37 @@ static int exception_count = 0;
 - (NSData *)lt_dataForMessage:(DDLogMessage *)logMessage {
     DDAbstractLoggerAssertOnInternalLoggerQueue();
 
-    __auto_type messageString = logMessage->_message;
+    __auto_type messageString = logMessage.message;
     __auto_type isFormatted = NO;
 
     if (_logFormatter != nil) {
-        messageString = [_logFormatter formatLogMessage:logMessage];
-        isFormatted = messageString != logMessage->_message;
+        messageString = [logMessage formattedMessageUsingFormatter:_logFormatter];
+        isFormatted = messageString != logMessage.message;
     }
 
     if (messageString.length == 0) {
         return nil;
     }
 
+    __auto_type serializer = [self lt_logFileSerializer];
+    if (!isFormatted && [serializer isMemberOfClass:[DDFileLogPlainTextMessageSerializer class]]) {
+        // The plain text is the UTF-8 encoding of the message, which is already shared by the loggers.
+        __auto_type messageData = logMessage.messageUTF8Data;
+        if (messageData.length > 0 && ((const char *)messageData.bytes)[messageData.length - 1] == '\n') {
+            return messageData;
+        }
+        __auto_type data = [NSMutableData dataWithCapacity:messageData.length + 1];
+        [data appendData:messageData];
+        [data appendBytes:"\n" length:1];
+        return data;
+    }
+
     __auto_type shouldFormat = !isFormatted || _automaticallyAppendNewlineForCustomFormatters;
     if (shouldFormat && ![messageString hasSuffix:@"\n"]) {
         messageString = [messageString stringByAppendingString:@"\n"];
     }
 
-    return [[self lt_logFileSerializer] dataForString:messageString originatingFromMessage:logMessage];
+    return [serializer dataForString:messageString originatingFromMessage:logMessage];
 }
 
 @end
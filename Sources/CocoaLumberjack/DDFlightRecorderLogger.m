@@ -0,0 +1,345 @@
+// Software License Agreement (BSD License)
+//
+// Copyright (c) 2010-2026, Deusty, LLC
+// All rights reserved.
+//
+// Redistribution and use of this software in source and binary forms,
+// with or without modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+//
+// * Neither the name of Deusty nor the names of its contributors may be used
+//   to endorse or promote products derived from this software without specific
+//   prior written permission of Deusty, LLC.
+
+#if !__has_feature(objc_arc)
+#error This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+#import <sys/mman.h>
+#import <errno.h>
+#import <fcntl.h>
+#import <stdatomic.h>
+#import <unistd.h>
+
+#import <CocoaLumberjack/DDFlightRecorderLogger.h>
+
+NSErrorDomain const DDFlightRecorderLoggerErrorDomain = @"DDFlightRecorderLoggerErrorDomain";
+
+// The file starts with a header, followed by the circular buffer.
+// Records are written one after the other, wrapping around at the end of the buffer.
+//
+// head and tail are offsets counted since the recording started (they aren't reduced modulo the capacity),
+// the records between tail and head are the ones still in the buffer.
+// To append a record, the logger
+// 1. moves tail past the records the new one is going to overwrite,
+// 2. copies the record into the buffer,
+// 3. moves head past the new record.
+// So whenever the process dies, the records between tail and head are complete.
+
+static const uint32_t kDDFlightRecorderMagic = 0x52464444; // "DDFR"
+static const uint32_t kDDFlightRecorderVersion = 1;
+static const NSUInteger kDDFlightRecorderMinimumCapacity = 4096;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    _Atomic(uint64_t) tail;
+    _Atomic(uint64_t) head;
+    char _padding[32];
+} DDFlightRecorderHeader;
+
+// Followed by the UTF-8 bytes of the file, the function and the message (not NUL terminated).
+typedef struct {
+    uint32_t length; // Of the whole record
+    uint32_t flag;
+    uint64_t level;
+    int64_t context;
+    uint64_t timestampNanoseconds;
+    uint32_t line;
+    uint32_t fileLength;
+    uint32_t functionLength;
+    uint32_t messageLength;
+} DDFlightRecorderRecordHeader;
+
+NS_INLINE void DDFlightRecorderCopyIn(uint8_t *buffer, uint64_t capacity, uint64_t offset, const void *bytes, NSUInteger length) {
+    __auto_type position = (NSUInteger)(offset % capacity);
+    __auto_type firstLength = MIN(length, (NSUInteger)capacity - position);
+    memcpy(buffer + position, bytes, firstLength);
+    memcpy(buffer, (const uint8_t *)bytes + firstLength, length - firstLength);
+}
+
+NS_INLINE void DDFlightRecorderCopyOut(const uint8_t *buffer, uint64_t capacity, uint64_t offset, void *bytes, NSUInteger length) {
+    __auto_type position = (NSUInteger)(offset % capacity);
+    __auto_type firstLength = MIN(length, (NSUInteger)capacity - position);
+    memcpy(bytes, buffer + position, firstLength);
+    memcpy((uint8_t *)bytes + firstLength, buffer, length - firstLength);
+}
+
+// Truncates the string (on a character boundary) if it doesn't fit.
+static NSUInteger DDFlightRecorderCopyString(NSString *string, uint8_t *buffer, NSUInteger maximumLength) {
+    if (string == nil) {
+        return 0;
+    }
+
+    NSUInteger usedLength = 0;
+    [string getBytes:buffer
+           maxLength:maximumLength
+          usedLength:&usedLength
+            encoding:NSUTF8StringEncoding
+             options:0
+               range:NSMakeRange(0, string.length)
+      remainingRange:NULL];
+    return usedLength;
+}
+
+static NSError * DDFlightRecorderPOSIXError(NSString *filePath) {
+    return [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{ NSFilePathErrorKey: filePath }];
+}
+
+static NSError * DDFlightRecorderInvalidFileError(NSString *filePath) {
+    return [NSError errorWithDomain:DDFlightRecorderLoggerErrorDomain
+                               code:DDFlightRecorderLoggerErrorInvalidFile
+                           userInfo:@{
+        NSFilePathErrorKey: filePath,
+        NSLocalizedDescriptionKey: @"The file isn't a flight recorder file.",
+    }];
+}
+
+@implementation DDFlightRecorderLogger {
+    DDFlightRecorderHeader *_header;
+    uint8_t *_buffer;
+    size_t _mappingLength;
+
+    // A record is assembled here before being copied into the buffer.
+    uint8_t *_record;
+    NSUInteger _maximumRecordLength;
+}
+
+- (instancetype)initWithFilePath:(NSString *)filePath capacity:(NSUInteger)capacity error:(NSError **)error {
+    NSParameterAssert(filePath);
+
+    if ((self = [super init])) {
+        _filePath = [filePath copy];
+        _capacity = MAX(capacity, kDDFlightRecorderMinimumCapacity);
+        _mappingLength = sizeof(DDFlightRecorderHeader) + _capacity;
+
+        __auto_type fd = open(filePath.fileSystemRepresentation, O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            if (error) {
+                *error = DDFlightRecorderPOSIXError(filePath);
+            }
+            return nil;
+        }
+
+        if (ftruncate(fd, (off_t)_mappingLength) != 0) {
+            if (error) {
+                *error = DDFlightRecorderPOSIXError(filePath);
+            }
+            close(fd);
+            return nil;
+        }
+
+        // The mapping keeps the file open.
+        __auto_type mapping = mmap(NULL, _mappingLength, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            if (error) {
+                *error = DDFlightRecorderPOSIXError(filePath);
+            }
+            return nil;
+        }
+
+        _header = mapping;
+        _buffer = (uint8_t *)mapping + sizeof(DDFlightRecorderHeader);
+
+        // A single record may take up to a quarter of the buffer, longer messages are truncated.
+        _maximumRecordLength = _capacity / 4;
+        _record = malloc(_maximumRecordLength);
+
+        // Start a new recording, the magic number being written last.
+        _header->magic = 0;
+        _header->version = kDDFlightRecorderVersion;
+        _header->capacity = _capacity;
+        atomic_store_explicit(&_header->tail, 0, memory_order_relaxed);
+        atomic_store_explicit(&_header->head, 0, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        _header->magic = kDDFlightRecorderMagic;
+    }
+
+    return self;
+}
+
+- (void)dealloc {
+    if (_header) {
+        munmap(_header, _mappingLength);
+    }
+    free(_record);
+}
+
+#pragma mark - DDLogger
+
+- (DDLoggerName)loggerName {
+    return DDLoggerNameFlightRecorder;
+}
+
+- (void)logMessage:(DDLogMessage *)logMessage {
+    __auto_type message = _logFormatter ? [logMessage formattedMessageUsingFormatter:_logFormatter] : logMessage.message;
+    if (message == nil) {
+        return;
+    }
+
+    // The file and the function get at most a quarter of the record each, the message gets the rest.
+    __auto_type recordHeader = (DDFlightRecorderRecordHeader *)_record;
+    __auto_type bytes = _record + sizeof(DDFlightRecorderRecordHeader);
+    __auto_type available = _maximumRecordLength - sizeof(DDFlightRecorderRecordHeader);
+
+    __auto_type fileLength = DDFlightRecorderCopyString(logMessage->_file, bytes, available / 4);
+    __auto_type functionLength = DDFlightRecorderCopyString(logMessage->_function, bytes + fileLength, available / 4);
+    __auto_type messageBytes = bytes + fileLength + functionLength;
+    __auto_type messageAvailable = available - fileLength - functionLength;
+    NSUInteger messageLength;
+    NSData *messageData = message == logMessage.message ? logMessage.messageUTF8Data : nil;
+    if (messageData != nil && messageData.length <= messageAvailable) {
+        // Already encoded, possibly by another logger.
+        messageLength = messageData.length;
+        memcpy(messageBytes, messageData.bytes, messageLength);
+    } else {
+        messageLength = DDFlightRecorderCopyString(message, messageBytes, messageAvailable);
+    }
+
+    *recordHeader = (DDFlightRecorderRecordHeader) {
+        .length = (uint32_t)(sizeof(DDFlightRecorderRecordHeader) + fileLength + functionLength + messageLength),
+        .flag = (uint32_t)logMessage->_flag,
+        .level = (uint64_t)logMessage->_level,
+        .line = (uint32_t)logMessage->_line,
+        .context = (int64_t)logMessage->_context,
+        .timestampNanoseconds = logMessage->_timestampNanoseconds,
+        .fileLength = (uint32_t)fileLength,
+        .functionLength = (uint32_t)functionLength,
+        .messageLength = (uint32_t)messageLength,
+    };
+
+    [self appendRecordOfLength:recordHeader->length];
+}
+
+- (void)appendRecordOfLength:(uint32_t)length {
+    __auto_type capacity = _header->capacity;
+    __auto_type head = atomic_load_explicit(&_header->head, memory_order_relaxed);
+    __auto_type tail = atomic_load_explicit(&_header->tail, memory_order_relaxed);
+
+    // 1. Make room for the record.
+    while (head + length - tail > capacity) {
+        uint32_t oldLength;
+        DDFlightRecorderCopyOut(_buffer, capacity, tail, &oldLength, sizeof(oldLength));
+        if (oldLength < sizeof(DDFlightRecorderRecordHeader) || oldLength > head - tail) {
+            // Somebody else wrote to the file, start over.
+            tail = head;
+            break;
+        }
+        tail += oldLength;
+    }
+    atomic_store_explicit(&_header->tail, tail, memory_order_release);
+
+    // 2. Copy it.
+    DDFlightRecorderCopyIn(_buffer, capacity, head, _record, length);
+
+    // 3. Publish it.
+    atomic_store_explicit(&_header->head, head + length, memory_order_release);
+}
+
+- (void)flush {
+    // Not needed for the records to survive a crash of the process, but they'd be lost on a crash of the system.
+    msync(_header, _mappingLength, MS_SYNC);
+}
+
+- (BOOL)isDurable {
+    return YES;
+}
+
+#pragma mark - Recovery
+
++ (NSArray<DDLogMessage *> *)recoverLogMessagesFromFileAtPath:(NSString *)filePath error:(NSError **)error {
+    NSParameterAssert(filePath);
+
+    __auto_type data = [NSData dataWithContentsOfFile:filePath options:NSDataReadingMappedIfSafe error:error];
+    if (data == nil) {
+        return nil;
+    }
+
+    DDFlightRecorderHeader header;
+    if (data.length < sizeof(header)) {
+        if (error) {
+            *error = DDFlightRecorderInvalidFileError(filePath);
+        }
+        return nil;
+    }
+    memcpy(&header, data.bytes, sizeof(header));
+
+    __auto_type capacity = header.capacity;
+    __auto_type tail = atomic_load_explicit(&header.tail, memory_order_relaxed);
+    __auto_type head = atomic_load_explicit(&header.head, memory_order_relaxed);
+    if (header.magic != kDDFlightRecorderMagic
+        || header.version != kDDFlightRecorderVersion
+        || capacity < kDDFlightRecorderMinimumCapacity
+        || data.length - sizeof(header) < capacity
+        || head < tail
+        || head - tail > capacity) {
+        if (error) {
+            *error = DDFlightRecorderInvalidFileError(filePath);
+        }
+        return nil;
+    }
+
+    __auto_type buffer = (const uint8_t *)data.bytes + sizeof(header);
+    __auto_type logMessages = [NSMutableArray<DDLogMessage *> new];
+    __auto_type record = [NSMutableData new];
+
+    for (__auto_type offset = tail; head - offset >= sizeof(DDFlightRecorderRecordHeader);) {
+        DDFlightRecorderRecordHeader recordHeader;
+        DDFlightRecorderCopyOut(buffer, capacity, offset, &recordHeader, sizeof(recordHeader));
+
+        // Records are only damaged if somebody else wrote to the file, keep what we've got so far and drop the rest.
+        __auto_type stringsLength = (uint64_t)recordHeader.fileLength + recordHeader.functionLength + recordHeader.messageLength;
+        if (recordHeader.length < sizeof(recordHeader)
+            || recordHeader.length > head - offset
+            || stringsLength != recordHeader.length - sizeof(recordHeader)) {
+            break;
+        }
+
+        record.length = (NSUInteger)stringsLength;
+        DDFlightRecorderCopyOut(buffer, capacity, offset + sizeof(recordHeader), record.mutableBytes, record.length);
+
+        __auto_type bytes = (const uint8_t *)record.bytes;
+        __auto_type file = [[NSString alloc] initWithBytes:bytes
+                                                    length:recordHeader.fileLength
+                                                  encoding:NSUTF8StringEncoding];
+        __auto_type function = [[NSString alloc] initWithBytes:bytes + recordHeader.fileLength
+                                                        length:recordHeader.functionLength
+                                                      encoding:NSUTF8StringEncoding];
+        __auto_type message = [[NSString alloc] initWithBytes:bytes + recordHeader.fileLength + recordHeader.functionLength
+                                                       length:recordHeader.messageLength
+                                                     encoding:NSUTF8StringEncoding];
+        __auto_type timestamp = [NSDate dateWithTimeIntervalSince1970:(NSTimeInterval)recordHeader.timestampNanoseconds / NSEC_PER_SEC];
+
+        [logMessages addObject:[[DDLogMessage alloc] initWithFormat:message ?: @""
+                                                          formatted:message ?: @""
+                                                              level:(DDLogLevel)recordHeader.level
+                                                               flag:(DDLogFlag)recordHeader.flag
+                                                            context:(NSInteger)recordHeader.context
+                                                               file:file ?: @""
+                                                           function:function.length > 0 ? function : nil
+                                                               line:recordHeader.line
+                                                                tag:nil
+                                                            options:(DDLogMessageOptions)0
+                                                          timestamp:timestamp]];
+
+        offset += recordHeader.length;
+    }
+
+    return logMessages;
+}
+
+@end
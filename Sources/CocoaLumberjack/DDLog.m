@@ -18,9 +18,24 @@
 #endif
 
 #import <pthread.h>
+#import <unistd.h>
+#import <stdatomic.h>
 #import <objc/runtime.h>
 #import <sys/qos.h>
 
+#if defined(__linux__)
+    #import <sys/syscall.h>
+    #import <unistd.h>
+#endif
+
+#if __has_include(<mach-o/dyld.h>)
+    #import <dlfcn.h>
+    #import <mach-o/dyld.h>
+    #define DD_HAS_DYLD 1
+#else
+    #define DD_HAS_DYLD 0
+#endif
+
 #if TARGET_OS_IOS
     #import <UIKit/UIDevice.h>
     #import <UIKit/UIApplication.h>
@@ -53,291 +68,2611 @@ NSAssert(dispatch_get_specific(GlobalLoggingQueueIdentityKey), @"This method mus
 #define DDLogAssertNotOnGlobalLoggingQueue() \
 NSAssert(!dispatch_get_specific(GlobalLoggingQueueIdentityKey), @"This method must not be called on the logging thread/queue!")
 
-// The "global logging queue" refers to [DDLog loggingQueue].
-// It is the queue that all log statements go through.
+// The "global logging queue" refers to [DDLog loggingQueue], or to the logging queue of another DDLog instance.
+// It is the queue that all log statements of an instance go through.
 //
-// The logging queue sets a flag via dispatch_queue_set_specific using this key.
-// We can check for this key via dispatch_get_specific() to see if we're on the "global logging queue".
+// Every logging queue sets a flag via dispatch_queue_set_specific using this key.
+// We can check for this key via dispatch_get_specific() to see if we're on a "global logging queue".
 
 static void *const GlobalLoggingQueueIdentityKey = (void *)&GlobalLoggingQueueIdentityKey;
 
-@interface DDLoggerNode : NSObject
-{
-    // Direct accessors to be used only for performance
-    @public
-    id <DDLogger> _logger;
-    DDLogLevel _level;
-    dispatch_queue_t _loggerQueue;
-}
+// Every logging queue also sets its DDLog instance using this key,
+// to tell whether we're on the logging queue of a given instance.
+static void *const LoggingQueueOwnerKey = (void *)&LoggingQueueOwnerKey;
 
-@property (nonatomic, readonly) id <DDLogger> logger;
-@property (nonatomic, readonly) DDLogLevel level;
-@property (nonatomic, readonly) dispatch_queue_t loggerQueue;
+// Non-zero while the current thread is handing a log message to a logger.
+// Loggers logging themselves must never block on a full queue, since the logging queue waits for them.
+static __thread NSUInteger DDLogDeliveryDepth = 0;
 
-+ (instancetype)nodeWithLogger:(id <DDLogger>)logger
-                   loggerQueue:(dispatch_queue_t)loggerQueue
-                         level:(DDLogLevel)level;
+// Threads are numbered in the order in which they first need it, and keep their number.
+// Spreads the threads over stripes of counters (statistics) or shards of queues (sharded ingress).
+static atomic_ulong DDLogNextThreadIndex;
+static __thread NSUInteger DDLogThreadIndexPlusOne = 0;
 
-@end
+NS_INLINE NSUInteger DDLogCurrentThreadIndex(void) {
+    if (DDLogThreadIndexPlusOne == 0) {
+        DDLogThreadIndexPlusOne = (NSUInteger)atomic_fetch_add_explicit(&DDLogNextThreadIndex, 1, memory_order_relaxed) + 1;
+    }
+    return DDLogThreadIndexPlusOne - 1;
+}
 
+// The ring buffer used by DDLogIngressModeRingBuffer.
+//
+// This is a bounded multi-producer/single-consumer queue (Dmitry Vyukov's bounded queue).
+// (The message pool uses it as a multi-consumer queue, through DDLogRingTryDequeue.)
+// Every slot carries a sequence number, which tells producers whether the slot is free,
+// and tells the consumer whether the slot has been published.
+//
+// Producers (the logging threads) reserve a slot with a single CAS, publish the item with a release store,
+// and then increment pendingCount. The producer that moves pendingCount from 0 to 1 schedules the drain.
+// The consumer (the drain on the logging queue) is the only one touching dequeuePosition.
+//
+// The consumer may also pop every reserved slot, including the ones whose producer didn't increment pendingCount yet
+// (see DDLogRingReservedCount). pendingCount is then briefly negative, and must be read as a signed value.
+//
+// A producer may be preempted between reserving its slot and publishing it, while later slots are published.
+// The drains never wait for it on the logging queue: they stop at the unpublished slot, and are scheduled again
+// a moment later (the producer won't schedule them, since pendingCount isn't zero).
+// Only the drain of the reserved slots (lt_drainIngress) has to wait, and it sleeps rather than spinning,
+// so that a producer of lower priority gets to run.
+//
+// The fields written by the producers and the consumer are kept on separate cache lines.
+
+static const NSUInteger kDDLogRingCapacity = 4096; // Must be a power of 2
+static const NSUInteger kDDLogRingBatchSize = 64;
+static const NSUInteger kDDLogMessagePoolCapacity = 256; // Must be a power of 2
+static const NSUInteger kDDLogPriorityLaneCapacity = 256; // Must be a power of 2
+static const int64_t kDDLogRedrainDelay = 50 * NSEC_PER_USEC; // Before draining again, once stopped at an unpublished slot.
+
+typedef struct {
+    atomic_uintptr_t sequence;
+    void *item;
+} DDLogRingSlot;
+
+typedef struct {
+    NSUInteger mask;
+    char _padding0[64 - sizeof(NSUInteger)];
+    atomic_uintptr_t enqueuePosition;
+    char _padding1[64 - sizeof(atomic_uintptr_t)];
+    atomic_uintptr_t dequeuePosition;
+    char _padding2[64 - sizeof(atomic_uintptr_t)];
+    atomic_uintptr_t pendingCount;
+    char _padding3[64 - sizeof(atomic_uintptr_t)];
+    DDLogRingSlot slots[];
+} DDLogRing;
+
+static DDLogRing * DDLogRingCreate(NSUInteger capacity) {
+    DDLogRing *ring = calloc(1, sizeof(DDLogRing) + capacity * sizeof(DDLogRingSlot));
+    if (ring == NULL) {
+        return NULL;
+    }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark -
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    ring->mask = capacity - 1;
+    for (NSUInteger i = 0; i < capacity; i++) {
+        atomic_init(&ring->slots[i].sequence, i);
+    }
+    atomic_init(&ring->enqueuePosition, 0);
+    atomic_init(&ring->dequeuePosition, 0);
+    atomic_init(&ring->pendingCount, 0);
 
-@interface DDLog ()
+    return ring;
+}
 
-// An array used to manage all the individual loggers.
-// The array is only modified on the loggingQueue/loggingThread.
-@property (nonatomic, strong) NSMutableArray *_loggers;
+// Returns NO if the ring is full.
+NS_INLINE BOOL DDLogRingTryEnqueue(DDLogRing *ring, void *item) {
+    __auto_type position = atomic_load_explicit(&ring->enqueuePosition, memory_order_relaxed);
+    DDLogRingSlot *slot;
 
-@end
+    for (;;) {
+        slot = &ring->slots[position & ring->mask];
+        __auto_type sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        __auto_type difference = (intptr_t)sequence - (intptr_t)position;
 
-@implementation DDLog
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->enqueuePosition, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return NO;
+        } else {
+            position = atomic_load_explicit(&ring->enqueuePosition, memory_order_relaxed);
+        }
+    }
 
-// All logging statements are added to the same queue to ensure FIFO operation.
-static dispatch_queue_t _loggingQueue;
+    slot->item = item;
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
 
-// Individual loggers are executed concurrently per log statement.
-// Each logger has it's own associated queue, and a dispatch group is used for synchronization.
-static dispatch_group_t _loggingGroup;
+    return YES;
+}
 
-// Minor optimization for uniprocessor machines
-static NSUInteger _numProcessors;
+// Must only be called by the consumer.
+// Returns NULL if the next slot isn't published yet: the ring is empty, or its producer didn't finish publishing it.
+NS_INLINE void * DDLogRingDequeueIfPublished(DDLogRing *ring) {
+    __auto_type position = atomic_load_explicit(&ring->dequeuePosition, memory_order_relaxed);
+    __auto_type slot = &ring->slots[position & ring->mask];
 
-/**
- *  Returns the singleton `DDLog`.
- *  The instance is used by `DDLog` class methods.
- *
- *  @return The singleton `DDLog`.
- */
-+ (instancetype)sharedInstance {
-    static DDLog *sharedInstance = nil;
+    if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != position + 1) {
+        return NULL;
+    }
 
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        sharedInstance = [[self alloc] init];
-    });
+    __auto_type item = slot->item;
+    slot->item = NULL;
+    atomic_store_explicit(&ring->dequeuePosition, position + 1, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, position + ring->mask + 1, memory_order_release);
 
-    return sharedInstance;
+    return item;
 }
 
-/**
- * The runtime sends initialize to each class in a program exactly one time just before the class,
- * or any class that inherits from it, is sent its first message from within the program. (Thus the
- * method may never be invoked if the class is not used.) The runtime sends the initialize message to
- * classes in a thread-safe manner. Superclasses receive this message before their subclasses.
- *
- * This method may also be called directly, hence the safety mechanism.
- **/
-+ (void)initialize {
-    static dispatch_once_t DDLogOnceToken;
+// Must only be called by the consumer, and only for a slot reserved by a producer (see DDLogRingReservedCount).
+// The producer may not have published it yet, in which case we sleep until it did.
+// Spinning instead would keep a preempted producer of lower priority from finishing.
+NS_INLINE void * DDLogRingDequeueReserved(DDLogRing *ring) {
+    void *item;
+    useconds_t delay = 1;
+    while ((item = DDLogRingDequeueIfPublished(ring)) == NULL) {
+        usleep(delay);
+        delay = MIN(delay * 2, 1000);
+    }
+    return item;
+}
 
-    dispatch_once(&DDLogOnceToken, ^{
-        NSLogDebug(@"DDLog: Using grand central dispatch");
+// The number of slots reserved by producers and not dequeued yet. Must only be called by the consumer.
+// Every one of them can be dequeued with DDLogRingDequeueReserved, whether it is accounted for in pendingCount or not.
+NS_INLINE NSUInteger DDLogRingReservedCount(DDLogRing *ring) {
+    return (NSUInteger)(atomic_load_explicit(&ring->enqueuePosition, memory_order_acquire)
+                        - atomic_load_explicit(&ring->dequeuePosition, memory_order_relaxed));
+}
 
-        _loggingQueue = dispatch_queue_create("cocoa.lumberjack", NULL);
-        _loggingGroup = dispatch_group_create();
+// May be called by several consumers at once (but not together with DDLogRingDequeueIfPublished).
+// Returns NULL if the ring is empty.
+NS_INLINE void * DDLogRingTryDequeue(DDLogRing *ring) {
+    __auto_type position = atomic_load_explicit(&ring->dequeuePosition, memory_order_relaxed);
+    DDLogRingSlot *slot;
+
+    for (;;) {
+        slot = &ring->slots[position & ring->mask];
+        __auto_type sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        __auto_type difference = (intptr_t)sequence - (intptr_t)(position + 1);
+
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->dequeuePosition, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return NULL;
+        } else {
+            position = atomic_load_explicit(&ring->dequeuePosition, memory_order_relaxed);
+        }
+    }
 
-        void *nonNullValue = GlobalLoggingQueueIdentityKey; // Whatever, just not null
-        dispatch_queue_set_specific(_loggingQueue, GlobalLoggingQueueIdentityKey, nonNullValue, NULL);
+    __auto_type item = slot->item;
+    slot->item = NULL;
+    atomic_store_explicit(&slot->sequence, position + ring->mask + 1, memory_order_release);
 
-        // Figure out how many processors are available.
-        // This may be used later for an optimization on uniprocessor machines.
+    return item;
+}
 
-        _numProcessors = MAX([NSProcessInfo processInfo].processorCount, (NSUInteger) 1);
+// The shards used by DDLogIngressModeShardedRingBuffer.
+//
+// Every shard is a ring like the one above, with its own pendingCount, and each thread sticks to a shard.
+// So threads logging at the same time rarely touch the same cache lines, and never contend on a single CAS.
+// The producer that moves the pendingCount of a shard from 0 to 1 schedules the drain, which drains all shards.
+//
+// The drain pops up to kDDLogRingBatchSize messages from each shard and merges them by monotonic timestamp.
+// Within a shard the order is kept as is, so messages logged from the same thread are never reordered.
+// Messages logged from different threads are ordered within a drained batch (the merge window), not across batches.
+
+enum {
+    kDDLogMaximumShardCount = 16, // Must be a power of 2
+    kDDLogShardCapacity = 1024, // Must be a power of 2
+};
+
+typedef struct {
+    NSUInteger mask;
+    DDLogRing *rings[];
+} DDLogShards;
+
+static DDLogShards * DDLogShardsCreate(NSUInteger count) {
+    DDLogShards *shards = calloc(1, sizeof(DDLogShards) + count * sizeof(DDLogRing *));
+    if (shards == NULL) {
+        return NULL;
+    }
 
-        NSLogDebug(@"DDLog: numProcessors = %@", @(_numProcessors));
-    });
+    shards->mask = count - 1;
+    for (NSUInteger i = 0; i < count; i++) {
+        shards->rings[i] = DDLogRingCreate(kDDLogShardCapacity);
+        if (shards->rings[i] == NULL) {
+            for (NSUInteger j = 0; j < i; j++) {
+                free(shards->rings[j]);
+            }
+            free(shards);
+            return NULL;
+        }
+    }
+
+    return shards;
 }
 
-/**
- *  The `DDLog` initializer.
- *  Static variables are set only once.
- *
- *  @return An initialized `DDLog` instance.
- */
-- (instancetype)init {
-    self = [super init];
+// The shards must be empty.
+static void DDLogShardsFree(DDLogShards *shards) {
+    for (NSUInteger i = 0; i <= shards->mask; i++) {
+        free(shards->rings[i]);
+    }
+    free(shards);
+}
 
-    if (self) {
-        self._loggers = [[NSMutableArray alloc] initWithCapacity:4];
+// The arguments of a log message whose formatting is deferred (DDLog.defersMessageFormatting).
+//
+// The format is split into segments, each one starting with the specifier of its argument
+// (except the first one, which holds the text before the first specifier).
+// Rendering appends every segment along with its single argument, so no va_list is needed later on.
+//
+// Only formats available as a C string, with up to kDDLogMaximumDeferredArguments plain specifiers, are deferred.
+// Positional arguments, `*` width or precision, `%n` and wide strings are formatted right away instead.
+
+static const NSUInteger kDDLogMaximumDeferredArguments = 16;
+
+typedef NS_ENUM(uint8_t, DDLogArgumentType) {
+    DDLogArgumentTypeInt,
+    DDLogArgumentTypeLong,
+    DDLogArgumentTypeLongLong,
+    DDLogArgumentTypeIntMax,
+    DDLogArgumentTypeSize,
+    DDLogArgumentTypePtrDiff,
+    DDLogArgumentTypeDouble,
+    DDLogArgumentTypeLongDouble,
+    DDLogArgumentTypePointer,
+    DDLogArgumentTypeCString, // Copied
+    DDLogArgumentTypeObject,  // Strings are copied, numbers retained, other objects described right away
+};
+
+typedef struct {
+    DDLogArgumentType type;
+    uint32_t segmentStart;
+    union {
+        int i;
+        long l;
+        long long ll;
+        intmax_t j;
+        size_t z;
+        ptrdiff_t t;
+        double d;
+        long double ld;
+        void *p;
+    } value;
+} DDLogArgument;
+
+typedef struct {
+    const char *format; // Owned by the message format
+    NSUInteger formatLength;
+    NSUInteger count;
+    DDLogArgument arguments[];
+} DDLogArguments;
+
+// Returns NO if the format can't be deferred.
+static BOOL DDLogParseFormat(const char *format, DDLogArgument *arguments, NSUInteger *count) {
+    *count = 0;
+
+    for (const char *c = format; *c; c++) {
+        if (*c != '%') {
+            continue;
+        }
 
-#if TARGET_OS_IOS
-        __auto_type notificationName = UIApplicationWillTerminateNotification;
-#else
-        NSString *notificationName = nil;
+        __auto_type start = c++;
+        if (*c == '%') {
+            continue;
+        }
 
-        // On Command Line Tool apps AppKit may not be available
-#if !defined(DD_CLI) && __has_include(<AppKit/NSApplication.h>)
-        if (NSApp) {
-            notificationName = NSApplicationWillTerminateNotification;
+        while (*c && strchr("-+ #0'", *c)) {
+            c++;
+        }
+        while (*c >= '0' && *c <= '9') {
+            c++;
+        }
+        if (*c == '*' || *c == '$') {
+            return NO;
+        }
+        if (*c == '.') {
+            c++;
+            if (*c == '*') {
+                return NO;
+            }
+            while (*c >= '0' && *c <= '9') {
+                c++;
+            }
         }
-#endif
 
-        if (!notificationName) {
-            // If there is no NSApp -> we are running Command Line Tool app.
-            // In this case terminate notification wouldn't be fired, so we use workaround.
-            __weak __auto_type weakSelf = self;
-            atexit_b (^{
-                [weakSelf applicationWillTerminate:nil];
-            });
+        // Length modifier
+        char length = 0;
+        if (c[0] == 'h' && c[1] == 'h') {
+            length = 'H';
+            c += 2;
+        } else if ((c[0] == 'l' && c[1] == 'l') || c[0] == 'q') {
+            length = 'Q';
+            c += (c[0] == 'q') ? 1 : 2;
+        } else if (*c && strchr("hlLjzt", *c)) {
+            length = *c++;
         }
 
-#endif /* if TARGET_OS_IOS */
+        DDLogArgumentType type;
+        switch (*c) {
+            case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+                switch (length) {
+                    case 0: case 'H': case 'h': type = DDLogArgumentTypeInt; break;
+                    case 'l': type = DDLogArgumentTypeLong; break;
+                    case 'Q': type = DDLogArgumentTypeLongLong; break;
+                    case 'j': type = DDLogArgumentTypeIntMax; break;
+                    case 'z': type = DDLogArgumentTypeSize; break;
+                    case 't': type = DDLogArgumentTypePtrDiff; break;
+                    default: return NO;
+                }
+                break;
+            case 'D': case 'U': case 'O':
+                type = DDLogArgumentTypeLong;
+                break;
+            case 'c': case 'C':
+                if (length != 0) {
+                    return NO;
+                }
+                type = DDLogArgumentTypeInt;
+                break;
+            case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+                if (length == 'L') {
+                    type = DDLogArgumentTypeLongDouble;
+                } else if (length == 0 || length == 'l') {
+                    type = DDLogArgumentTypeDouble;
+                } else {
+                    return NO;
+                }
+                break;
+            case 's':
+                if (length != 0) {
+                    return NO;
+                }
+                type = DDLogArgumentTypeCString;
+                break;
+            case 'p':
+                type = DDLogArgumentTypePointer;
+                break;
+            case '@':
+                type = DDLogArgumentTypeObject;
+                break;
+            default:
+                // %n, %S, and anything we don't know about.
+                return NO;
+        }
 
-        if (notificationName) {
-            [[NSNotificationCenter defaultCenter] addObserver:self
-                                                     selector:@selector(applicationWillTerminate:)
-                                                         name:notificationName
-                                                       object:nil];
+        if (*count == kDDLogMaximumDeferredArguments) {
+            return NO;
         }
+        arguments[*count].type = type;
+        arguments[*count].segmentStart = (uint32_t)(start - format);
+        (*count)++;
     }
 
-    return self;
+    return YES;
 }
 
-/**
- * Provides access to the logging queue.
- **/
-+ (dispatch_queue_t)loggingQueue {
-    return _loggingQueue;
+// Returns NULL if the format can't be deferred, in which case the arguments haven't been consumed.
+static DDLogArguments * DDLogArgumentsCreate(NSString *format, va_list args) {
+    __auto_type cFormat = CFStringGetCStringPtr((__bridge CFStringRef)format, kCFStringEncodingUTF8);
+    if (cFormat == NULL) {
+        return NULL;
+    }
+
+    DDLogArgument parsedArguments[kDDLogMaximumDeferredArguments];
+    NSUInteger count;
+    if (!DDLogParseFormat(cFormat, parsedArguments, &count)) {
+        return NULL;
+    }
+
+    DDLogArguments *arguments = malloc(sizeof(DDLogArguments) + count * sizeof(DDLogArgument));
+    if (arguments == NULL) {
+        return NULL;
+    }
+
+    arguments->format = cFormat;
+    arguments->formatLength = strlen(cFormat);
+    arguments->count = count;
+
+    for (NSUInteger i = 0; i < count; i++) {
+        __auto_type argument = &arguments->arguments[i];
+        *argument = parsedArguments[i];
+
+        switch (argument->type) {
+            case DDLogArgumentTypeInt: argument->value.i = va_arg(args, int); break;
+            case DDLogArgumentTypeLong: argument->value.l = va_arg(args, long); break;
+            case DDLogArgumentTypeLongLong: argument->value.ll = va_arg(args, long long); break;
+            case DDLogArgumentTypeIntMax: argument->value.j = va_arg(args, intmax_t); break;
+            case DDLogArgumentTypeSize: argument->value.z = va_arg(args, size_t); break;
+            case DDLogArgumentTypePtrDiff: argument->value.t = va_arg(args, ptrdiff_t); break;
+            case DDLogArgumentTypeDouble: argument->value.d = va_arg(args, double); break;
+            case DDLogArgumentTypeLongDouble: argument->value.ld = va_arg(args, long double); break;
+            case DDLogArgumentTypePointer: argument->value.p = va_arg(args, void *); break;
+            case DDLogArgumentTypeCString: {
+                const char *string = va_arg(args, const char *);
+                argument->value.p = string ? strdup(string) : NULL;
+                break;
+            }
+            case DDLogArgumentTypeObject: {
+                // Only strings (copied, as mutable ones are likely to change right after the log statement)
+                // and numbers are safe to describe later on, from another thread.
+                // Other objects may be mutated or only be usable on the calling thread, so they're described now.
+                id object = va_arg(args, id);
+                if ([object isKindOfClass:[NSString class]]) {
+                    object = [object copy];
+                } else if (object && ![object isKindOfClass:[NSNumber class]]) {
+                    object = [[object description] copy];
+                }
+                argument->value.p = object ? (void *)CFBridgingRetain(object) : NULL;
+                break;
+            }
+        }
+    }
+
+    return arguments;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Notifications
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void DDLogArgumentsFree(DDLogArguments *arguments) {
+    for (NSUInteger i = 0; i < arguments->count; i++) {
+        __auto_type argument = &arguments->arguments[i];
+        if (argument->type == DDLogArgumentTypeCString) {
+            free(argument->value.p);
+        } else if (argument->type == DDLogArgumentTypeObject && argument->value.p) {
+            CFRelease(argument->value.p);
+        }
+    }
+    free(arguments);
+}
 
-- (void)applicationWillTerminate:(NSNotification * __attribute__((unused)))notification {
-    [self flushLog];
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wformat-nonliteral"
+#pragma clang diagnostic ignored "-Wformat-security"
+static NSString * DDLogArgumentsRender(DDLogArguments *arguments) {
+    __auto_type message = [NSMutableString stringWithCapacity:arguments->formatLength * 2];
+
+    for (NSUInteger i = 0; i <= arguments->count; i++) {
+        __auto_type start = (i == 0) ? 0 : arguments->arguments[i - 1].segmentStart;
+        __auto_type end = (i == arguments->count) ? arguments->formatLength : arguments->arguments[i].segmentStart;
+        __auto_type segment = [[NSString alloc] initWithBytesNoCopy:(void *)(arguments->format + start)
+                                                             length:end - start
+                                                           encoding:NSUTF8StringEncoding
+                                                       freeWhenDone:NO];
+        if (i == 0) {
+            [message appendFormat:segment];
+            continue;
+        }
+
+        __auto_type argument = &arguments->arguments[i - 1];
+        switch (argument->type) {
+            case DDLogArgumentTypeInt: [message appendFormat:segment, argument->value.i]; break;
+            case DDLogArgumentTypeLong: [message appendFormat:segment, argument->value.l]; break;
+            case DDLogArgumentTypeLongLong: [message appendFormat:segment, argument->value.ll]; break;
+            case DDLogArgumentTypeIntMax: [message appendFormat:segment, argument->value.j]; break;
+            case DDLogArgumentTypeSize: [message appendFormat:segment, argument->value.z]; break;
+            case DDLogArgumentTypePtrDiff: [message appendFormat:segment, argument->value.t]; break;
+            case DDLogArgumentTypeDouble: [message appendFormat:segment, argument->value.d]; break;
+            case DDLogArgumentTypeLongDouble: [message appendFormat:segment, argument->value.ld]; break;
+            case DDLogArgumentTypePointer:
+            case DDLogArgumentTypeCString: [message appendFormat:segment, argument->value.p]; break;
+            case DDLogArgumentTypeObject: [message appendFormat:segment, (__bridge id)argument->value.p]; break;
+        }
+    }
+
+    return [message copy];
 }
+#pragma clang diagnostic pop
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Logger Management
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Per thread cache of the metadata captured by every log message.
+//
+// The thread ID never changes, and the thread name is only looked up again when the name of the pthread changes.
+// C strings (files, functions and queue labels) are interned by address,
+// and checked against a copy of their content, since the same address may hold another string later on.
+// File names are cached per file.
+//
+// The cache is released by a pthread key destructor when the thread exits.
+
+enum {
+    kDDLogInternedStringCount = 16, // Must be a power of 2
+    kDDLogInternedQueueLabelCount = 4, // Must be a power of 2
+};
+
+typedef struct {
+    const char *pointer;
+    char *copy;
+    CFStringRef string;
+} DDLogInternedString;
+
+typedef struct {
+    CFStringRef file;
+    CFStringRef fileName;
+} DDLogCachedFileName;
+
+typedef struct {
+    CFStringRef threadID;
+    BOOL hasThreadName;
+    char pthreadName[64];
+    CFStringRef threadName;
+    DDLogInternedString files[kDDLogInternedStringCount];
+    DDLogInternedString functions[kDDLogInternedStringCount];
+    DDLogInternedString queueLabels[kDDLogInternedQueueLabelCount];
+    DDLogCachedFileName fileNames[kDDLogInternedStringCount];
+} DDLogThreadCache;
+
+static pthread_key_t DDLogThreadCacheKey;
+static __thread DDLogThreadCache *DDLogCurrentThreadCache = NULL;
+
+NS_INLINE void DDLogCFReleaseIfNeeded(CFTypeRef object) {
+    if (object) {
+        CFRelease(object);
+    }
+}
 
-+ (void)addLogger:(id <DDLogger>)logger {
-    [self.sharedInstance addLogger:logger];
+static void DDLogInternedStringsClear(DDLogInternedString *strings, NSUInteger count) {
+    for (NSUInteger i = 0; i < count; i++) {
+        free(strings[i].copy);
+        DDLogCFReleaseIfNeeded(strings[i].string);
+    }
 }
 
-- (void)addLogger:(id <DDLogger>)logger {
-    [self addLogger:logger withLevel:DDLogLevelAll]; // DDLogLevelAll has all bits set
+static void DDLogThreadCacheDestroy(void *value) {
+    DDLogThreadCache *cache = value;
+
+    // Anything logged by the remaining destructors of the thread allocates a new cache.
+    if (DDLogCurrentThreadCache == cache) {
+        DDLogCurrentThreadCache = NULL;
+    }
+
+    DDLogCFReleaseIfNeeded(cache->threadID);
+    DDLogCFReleaseIfNeeded(cache->threadName);
+    DDLogInternedStringsClear(cache->files, kDDLogInternedStringCount);
+    DDLogInternedStringsClear(cache->functions, kDDLogInternedStringCount);
+    DDLogInternedStringsClear(cache->queueLabels, kDDLogInternedQueueLabelCount);
+    for (NSUInteger i = 0; i < kDDLogInternedStringCount; i++) {
+        DDLogCFReleaseIfNeeded(cache->fileNames[i].file);
+        DDLogCFReleaseIfNeeded(cache->fileNames[i].fileName);
+    }
+    free(cache);
 }
 
-+ (void)addLogger:(id <DDLogger>)logger withLevel:(DDLogLevel)level {
-    [self.sharedInstance addLogger:logger withLevel:level];
+// Returns NULL if the cache can't be allocated.
+static DDLogThreadCache * DDLogGetThreadCache(void) {
+    if (DDLogCurrentThreadCache) {
+        return DDLogCurrentThreadCache;
+    }
+
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pthread_key_create(&DDLogThreadCacheKey, DDLogThreadCacheDestroy);
+    });
+
+    DDLogThreadCache *cache = calloc(1, sizeof(DDLogThreadCache));
+    if (cache == NULL || pthread_setspecific(DDLogThreadCacheKey, cache) != 0) {
+        free(cache);
+        return NULL;
+    }
+
+    DDLogCurrentThreadCache = cache;
+    return cache;
 }
 
-- (void)addLogger:(id <DDLogger>)logger withLevel:(DDLogLevel)level {
-    if (!logger) {
-        return;
+static NSString * DDLogInternCString(DDLogInternedString *strings, NSUInteger count, const char *cString) {
+    if (cString == NULL) {
+        return nil;
     }
 
-    dispatch_async(_loggingQueue, ^{ @autoreleasepool {
-        [self lt_addLogger:logger level:level];
-    } });
+    __auto_type entry = &strings[((uintptr_t)cString >> 3) & (count - 1)];
+    if (entry->pointer == cString && strcmp(entry->copy, cString) == 0) {
+        return (__bridge NSString *)entry->string;
+    }
+
+    NSString *string = @(cString);
+    __auto_type copy = strdup(cString);
+    if (copy == NULL) {
+        return string;
+    }
+
+    free(entry->copy);
+    DDLogCFReleaseIfNeeded(entry->string);
+    entry->pointer = cString;
+    entry->copy = copy;
+    entry->string = CFBridgingRetain(string);
+
+    return string;
 }
 
-+ (void)removeLogger:(id <DDLogger>)logger {
-    [self.sharedInstance removeLogger:logger];
+static NSString * DDLogThreadID(DDLogThreadCache *cache) {
+    if (cache && cache->threadID) {
+        return (__bridge NSString *)cache->threadID;
+    }
+
+    NSString *threadID;
+#if defined(__linux__)
+    threadID = [[NSString alloc] initWithFormat:@"%llu", (unsigned long long)syscall(SYS_gettid)];
+#else
+    __uint64_t tid;
+    if (pthread_threadid_np(NULL, &tid) == 0) {
+        threadID = [[NSString alloc] initWithFormat:@"%llu", tid];
+    } else {
+        threadID = @"N/A";
+    }
+#endif
+
+    if (cache) {
+        cache->threadID = CFBridgingRetain(threadID);
+    }
+    return threadID;
 }
 
-- (void)removeLogger:(id <DDLogger>)logger {
-    if (!logger) {
-        return;
+static NSString * DDLogThreadName(DDLogThreadCache *cache) {
+    if (cache == NULL) {
+        return NSThread.currentThread.name;
     }
 
-    dispatch_async(_loggingQueue, ^{ @autoreleasepool {
-        [self lt_removeLogger:logger];
-    } });
+    // NSThread keeps the name of the pthread in sync when the thread is named.
+    // On Darwin the name is read from the pthread structure, without a system call, so it is checked on every message.
+    char pthreadName[sizeof(cache->pthreadName)] = "";
+    pthread_getname_np(pthread_self(), pthreadName, sizeof(pthreadName));
+
+    if (!cache->hasThreadName || strcmp(pthreadName, cache->pthreadName) != 0) {
+        DDLogCFReleaseIfNeeded(cache->threadName);
+        cache->threadName = CFBridgingRetain(NSThread.currentThread.name);
+        memcpy(cache->pthreadName, pthreadName, sizeof(cache->pthreadName));
+        cache->hasThreadName = YES;
+    }
+
+    return (__bridge NSString *)cache->threadName;
 }
 
-+ (void)removeAllLoggers {
-    [self.sharedInstance removeAllLoggers];
+static NSString * DDLogFileName(DDLogThreadCache *cache, NSString *file) {
+    DDLogCachedFileName *entry = NULL;
+    if (cache) {
+        entry = &cache->fileNames[((uintptr_t)file >> 4) & (kDDLogInternedStringCount - 1)];
+        if (entry->file && ((__bridge NSString *)entry->file == file || [file isEqualToString:(__bridge NSString *)entry->file])) {
+            return (__bridge NSString *)entry->fileName;
+        }
+    }
+
+    // Get the file name without extension
+    NSString *fileName = [file lastPathComponent];
+    __auto_type dotLocation = [fileName rangeOfString:@"." options:NSBackwardsSearch].location;
+    if (dotLocation != NSNotFound) {
+        fileName = [fileName substringToIndex:dotLocation];
+    }
+
+    if (entry) {
+        // The file is retained, so that its address isn't reused by another string.
+        DDLogCFReleaseIfNeeded(entry->file);
+        DDLogCFReleaseIfNeeded(entry->fileName);
+        entry->file = CFBridgingRetain(file);
+        entry->fileName = CFBridgingRetain(fileName);
+    }
+    return fileName;
 }
 
-- (void)removeAllLoggers {
-    dispatch_async(_loggingQueue, ^{ @autoreleasepool {
-        [self lt_removeAllLoggers];
-    } });
+static NSString * DDLogQueueLabel(DDLogThreadCache *cache) {
+    __auto_type label = dispatch_queue_get_label(DISPATCH_CURRENT_QUEUE_LABEL);
+    if (cache == NULL) {
+        return @(label);
+    }
+    return DDLogInternCString(cache->queueLabels, kDDLogInternedQueueLabelCount, label);
 }
 
-+ (NSArray<id<DDLogger>> *)allLoggers {
-    return [self.sharedInstance allLoggers];
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Timestamps
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Nanoseconds since 1970, as read from the wall clock.
+NS_INLINE uint64_t DDLogWallClockNanoseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
 }
 
-- (NSArray<id<DDLogger>> *)allLoggers {
-    __block NSArray *theLoggers;
+// Nanoseconds from an unspecified point, never going backwards (even if the wall clock is changed).
+NS_INLINE uint64_t DDLogMonotonicNanoseconds(void) {
+#if defined(__APPLE__)
+    return clock_gettime_nsec_np(CLOCK_MONOTONIC_RAW);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+#endif
+}
 
-    dispatch_sync(_loggingQueue, ^{ @autoreleasepool {
-        theLoggers = [self lt_allLoggers];
-    } });
+NS_INLINE uint64_t DDLogNanosecondsFromDate(NSDate *date) {
+    __auto_type interval = date.timeIntervalSince1970;
+    return interval > 0 ? (uint64_t)(interval * NSEC_PER_SEC) : 0;
+}
+
+NS_INLINE NSDate * DDLogDateFromNanoseconds(uint64_t nanoseconds) {
+    return [NSDate dateWithTimeIntervalSince1970:(NSTimeInterval)nanoseconds / NSEC_PER_SEC];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Sampling
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The sampling policy of a context and a single flag.
+typedef struct {
+    NSInteger context;
+    DDLogFlag flag;
+    CFTypeRef policy;
+} DDLogSamplingRule;
+
+static __thread uint64_t DDLogRandomState = 0;
+
+// A uniformly distributed number in [0, 1), from a per thread xorshift64* generator.
+NS_INLINE double DDLogRandomUnit(void) {
+    __auto_type x = DDLogRandomState;
+    if (x == 0) {
+        x = (DDLogMonotonicNanoseconds() ^ (uint64_t)(uintptr_t)&DDLogRandomState) | 1;
+    }
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    DDLogRandomState = x;
+    return (double)((x * 0x2545F4914F6CDD1DULL) >> 11) * 0x1.0p-53;
+}
+
+// Depends on the contents of the file path only, so that it's stable from one run to the next.
+NS_INLINE double DDLogCallsiteUnit(const char *file, NSUInteger line) {
+    uint64_t hash = 0xcbf29ce484222325ULL; // FNV-1a
+    for (__auto_type c = file ?: ""; *c != '\0'; c++) {
+        hash = (hash ^ (uint8_t)*c) * 0x100000001b3ULL;
+    }
+    hash = (hash ^ line) * 0x100000001b3ULL;
+    hash ^= hash >> 29;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 32;
+    return (double)(hash >> 11) * 0x1.0p-53;
+}
+
+@interface DDLogSamplingPolicy ()
+
+// Returns YES if the log message is kept. Counts it either way.
+- (BOOL)sampleLogMessageWithFile:(const char *)file line:(NSUInteger)line;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Statistics
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum {
+    kDDLogStatisticsFlagCount = 8, // Flags are counted by bit, the last bucket counting all the higher bits
+    kDDLogStatisticsStripeCount = 16, // Must be a power of 2
+    kDDLogServiceTimeBucketCount = 65, // Bucket i counts durations below 2^i nanoseconds (and not below 2^(i-1))
+};
+
+// Counters updated by the calling threads.
+// Each thread sticks to a stripe, so that threads rarely write to the same cache line.
+// The stripes are summed up when a snapshot is taken.
+typedef struct {
+    _Alignas(64) atomic_ulong enqueuedCounts[kDDLogStatisticsFlagCount];
+} DDLogStatisticsStripe;
+
+NS_INLINE NSUInteger DDLogStatisticsCurrentStripe(void) {
+    return DDLogCurrentThreadIndex() & (kDDLogStatisticsStripeCount - 1);
+}
+
+NS_INLINE NSUInteger DDLogStatisticsFlagIndex(DDLogFlag flag) {
+    if (flag == 0) {
+        return kDDLogStatisticsFlagCount - 1;
+    }
+    return MIN((NSUInteger)__builtin_ctzl(flag), (NSUInteger)kDDLogStatisticsFlagCount - 1);
+}
+
+NS_INLINE NSUInteger DDLogServiceTimeBucket(uint64_t nanoseconds) {
+    return nanoseconds == 0 ? 0 : 64 - (NSUInteger)__builtin_clzll(nanoseconds);
+}
+
+NS_INLINE void DDLogAtomicMaximum(atomic_ullong *maximum, uint64_t value) {
+    __auto_type current = (uint64_t)atomic_load_explicit(maximum, memory_order_relaxed);
+    while (value > current
+           && !atomic_compare_exchange_weak_explicit(maximum, &current, value, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+// The upper bound of the bucket the given percentile falls into, capped by the maximum.
+static NSTimeInterval DDLogServiceTimePercentile(const NSUInteger *histogram, double percentile, uint64_t maximum) {
+    NSUInteger count = 0;
+    for (NSUInteger i = 0; i < kDDLogServiceTimeBucketCount; i++) {
+        count += histogram[i];
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    __auto_type target = MAX((NSUInteger)ceil(count * percentile), (NSUInteger)1);
+    NSUInteger cumulativeCount = 0;
+    NSUInteger bucket = 0;
+    while (bucket < kDDLogServiceTimeBucketCount - 1 && (cumulativeCount += histogram[bucket]) < target) {
+        bucket++;
+    }
+
+    __auto_type upperBound = bucket == 0 ? 0 : (bucket >= 64 ? UINT64_MAX : (1ULL << bucket) - 1);
+    return (NSTimeInterval)MIN(upperBound, maximum) / NSEC_PER_SEC;
+}
+
+@interface DDLoggerStatistics ()
+
+- (instancetype)initWithLogger:(id <DDLogger>)logger
+         deliveredMessageCount:(NSUInteger)deliveredMessageCount
+             medianServiceTime:(NSTimeInterval)medianServiceTime
+ninetyNinthPercentileServiceTime:(NSTimeInterval)ninetyNinthPercentileServiceTime
+            maximumServiceTime:(NSTimeInterval)maximumServiceTime
+                    flushCount:(NSUInteger)flushCount
+            totalFlushDuration:(NSTimeInterval)totalFlushDuration
+          maximumFlushDuration:(NSTimeInterval)maximumFlushDuration
+          additionalStatistics:(NSDictionary<NSString *, NSNumber *> *)additionalStatistics;
+
+@end
+
+@interface DDLogStatistics ()
+{
+    @package
+    NSUInteger _enqueuedCounts[kDDLogStatisticsFlagCount];
+    NSUInteger _deliveredCounts[kDDLogStatisticsFlagCount];
+    NSUInteger _queueDepth;
+    NSUInteger _maximumQueueDepth;
+    NSUInteger _droppedMessageCount;
+    NSUInteger _discardedMessageCount;
+    NSUInteger _suppressedMessageCount;
+    NSUInteger _sampledOutMessageCount;
+    NSArray<DDLoggerStatistics *> *_loggerStatistics;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Duplicate Suppression
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum {
+    kDDLogSuppressionSlotCount = 256, // Must be a power of 2
+};
+
+// The last log message logged (not suppressed) in this slot, and the window it started.
+// Each slot has its own lock, so that threads logging different messages don't contend.
+typedef struct {
+    pthread_mutex_t mutex;
+    uint64_t windowStart; // Monotonic nanoseconds, 0 while unused.
+    NSUInteger suppressedCount;
+    DDLogLevel level; // The level of the log message, reused by the summary.
+    DDLogFlag flag;
+    NSInteger context;
+    NSUInteger line;
+    CFTypeRef file;
+    CFTypeRef function;
+    CFTypeRef message; // Only set with DDLogSuppressionModeMessage.
+} DDLogSuppressionSlot;
+
+typedef struct {
+    DDLogSuppressionSlot slots[kDDLogSuppressionSlotCount];
+} DDLogSuppressionTable;
+
+static DDLogSuppressionTable * DDLogSuppressionTableCreate(void) {
+    DDLogSuppressionTable *table = calloc(1, sizeof(DDLogSuppressionTable));
+    if (table) {
+        for (NSUInteger i = 0; i < kDDLogSuppressionSlotCount; i++) {
+            pthread_mutex_init(&table->slots[i].mutex, NULL);
+        }
+    }
+    return table;
+}
+
+static void DDLogSuppressionTableFree(DDLogSuppressionTable *table) {
+    for (NSUInteger i = 0; i < kDDLogSuppressionSlotCount; i++) {
+        __auto_type slot = &table->slots[i];
+        pthread_mutex_destroy(&slot->mutex);
+        DDLogCFReleaseIfNeeded(slot->file);
+        DDLogCFReleaseIfNeeded(slot->function);
+        DDLogCFReleaseIfNeeded(slot->message);
+    }
+    free(table);
+}
+
+NS_INLINE NSUInteger DDLogSuppressionSlotIndex(DDLogSuppressionMode mode,
+                                               NSInteger context,
+                                               NSString *file,
+                                               NSUInteger line,
+                                               NSString *message) {
+    // Only cheap properties of the strings are used, the slot compares them anyway.
+    __auto_type hash = mode == DDLogSuppressionModeMessage ? message.hash : (line * 31 + file.length);
+    hash ^= (NSUInteger)context * 0x9E3779B9;
+    return (hash ^ (hash >> 8)) & (kDDLogSuppressionSlotCount - 1);
+}
+
+// Must be called with the slot locked.
+NS_INLINE BOOL DDLogSuppressionSlotMatches(DDLogSuppressionSlot *slot,
+                                           DDLogFlag flag,
+                                           NSInteger context,
+                                           NSString *file,
+                                           NSUInteger line,
+                                           NSString *message) {
+    if (slot->windowStart == 0 || slot->flag != flag || slot->context != context) {
+        return NO;
+    }
+    if (message) {
+        __auto_type slotMessage = (__bridge NSString *)slot->message;
+        return slotMessage == message || [slotMessage isEqualToString:message];
+    }
+    __auto_type slotFile = (__bridge NSString *)slot->file;
+    return slot->message == NULL
+        && slot->line == line
+        && (slotFile == file || [slotFile isEqualToString:file]);
+}
+
+// Must be called with the slot locked.
+static void DDLogSuppressionSlotReset(DDLogSuppressionSlot *slot,
+                                      uint64_t windowStart,
+                                      DDLogLevel level,
+                                      DDLogFlag flag,
+                                      NSInteger context,
+                                      NSString *file,
+                                      NSString *function,
+                                      NSUInteger line,
+                                      NSString *message) {
+    DDLogCFReleaseIfNeeded(slot->file);
+    DDLogCFReleaseIfNeeded(slot->function);
+    DDLogCFReleaseIfNeeded(slot->message);
+
+    slot->windowStart = windowStart;
+    slot->suppressedCount = 0;
+    slot->level = level;
+    slot->flag = flag;
+    slot->context = context;
+    slot->line = line;
+    slot->file = file ? CFBridgingRetain(file) : NULL;
+    slot->function = function ? CFBridgingRetain(function) : NULL;
+    slot->message = message ? CFBridgingRetain([message copy]) : NULL;
+}
+
+// Must be called with the slot locked.
+// Returns nil if nothing was suppressed since the last summary.
+static DDLogMessage * DDLogSuppressionSlotTakeSummary(DDLogSuppressionSlot *slot) {
+    if (slot->suppressedCount == 0) {
+        return nil;
+    }
+
+    __auto_type message = [NSString stringWithFormat:@"Last message repeated %lu times", (unsigned long)slot->suppressedCount];
+    slot->suppressedCount = 0;
+
+    return [[DDLogMessage alloc] initWithMessage:message
+                                           level:slot->level
+                                            flag:slot->flag
+                                         context:slot->context
+                                            file:(__bridge NSString *)slot->file
+                                        function:(__bridge NSString *)slot->function
+                                            line:slot->line
+                                             tag:nil
+                                         options:DDLogMessageDontCopyMessage
+                                       timestamp:nil];
+}
+
+// Creates the strings of the callsite, the first time it logs.
+// Threads racing to do so may all create them, but only the ones published first are kept.
+// The file name is published last, and tells the strings are all set.
+
+NS_INLINE void DDLogCallsitePublishString(void * _Nullable *slot, NSString *string) {
+    if (string == nil) {
+        return;
+    }
+
+    void *expected = NULL;
+    __auto_type value = (void *)CFBridgingRetain(string);
+    if (!__atomic_compare_exchange_n(slot, &expected, value, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        CFRelease(value);
+    }
+}
+
+static void DDLogCallsitePrepare(DDLogCallsite *callsite) {
+    if (__atomic_load_n(&callsite->_fileName, __ATOMIC_ACQUIRE) != NULL) {
+        return;
+    }
+
+    DDLogCallsitePublishString(&callsite->_file, @(callsite->file));
+    if (callsite->function) {
+        DDLogCallsitePublishString(&callsite->_function, @(callsite->function));
+    }
+    __auto_type file = (__bridge NSString *)__atomic_load_n(&callsite->_file, __ATOMIC_ACQUIRE);
+    DDLogCallsitePublishString(&callsite->_fileName, DDLogFileName(NULL, file));
+}
+
+// The callsites of the Swift logging functions, which are never freed.
+// This is an open addressing hash table: lookups don't lock, insertions do.
+
+enum {
+    kDDLogCallsiteTableSize = 4096, // Must be a power of 2
+    kDDLogCallsiteTableMaximumProbes = 16,
+};
+
+static _Atomic(DDLogCallsite *) DDLogCallsiteTable[kDDLogCallsiteTableSize];
+static pthread_mutex_t DDLogCallsiteTableMutex = PTHREAD_MUTEX_INITIALIZER;
+
+DDLogCallsite * DDLogCallsiteForLocation(const char *file, const char *function, NSUInteger line) {
+    __auto_type hash = ((uintptr_t)file * 31 + (uintptr_t)function) * 31 + line;
+    hash ^= hash >> 16;
+
+    for (NSUInteger probe = 0; probe < kDDLogCallsiteTableMaximumProbes; probe++) {
+        __auto_type slot = &DDLogCallsiteTable[(hash + probe) & (kDDLogCallsiteTableSize - 1)];
+        __auto_type callsite = atomic_load_explicit(slot, memory_order_acquire);
+
+        if (callsite == NULL) {
+            pthread_mutex_lock(&DDLogCallsiteTableMutex);
+            callsite = atomic_load_explicit(slot, memory_order_relaxed);
+            if (callsite == NULL) {
+                callsite = calloc(1, sizeof(DDLogCallsite));
+                if (callsite) {
+                    callsite->file = file;
+                    callsite->function = function;
+                    callsite->line = line;
+                    atomic_store_explicit(slot, callsite, memory_order_release);
+                }
+            }
+            pthread_mutex_unlock(&DDLogCallsiteTableMutex);
+
+            if (callsite == NULL) {
+                return NULL;
+            }
+        }
+
+        if (callsite->file == file && callsite->function == function && callsite->line == line) {
+            return callsite;
+        }
+    }
+
+    return NULL;
+}
+
+// The effective levels of the names in use, looked up by DDLogName.
+// Entries are never removed, so that names can keep the address of their level.
+// The table grows by chunks, which are never moved for the same reason.
+// Setting a level updates every entry, under the mutex. The root name is always the first entry.
+
+enum {
+    kDDLogNameTableChunkSize = 1024,
+    kDDLogNameTableMaximumChunkCount = 64, // The names which don't fit look their level up on every log statement.
+};
+
+static pthread_mutex_t DDLogNameTableMutex = PTHREAD_MUTEX_INITIALIZER;
+static NSMutableArray<NSString *> *DDLogNameTableNames;
+static NSMutableDictionary<NSString *, NSNumber *> *DDLogNameTableIndexes;
+static NSMutableDictionary<NSString *, NSNumber *> *DDLogNameLevels; // The levels which were set.
+static NSUInteger *DDLogNameTableChunks[kDDLogNameTableMaximumChunkCount];
+static BOOL DDLogNameTableDidOverflow;
+static __thread NSUInteger DDLogNameOverflowLevel; // The level of the last name which didn't fit, for the calling thread.
+
+NS_INLINE NSUInteger * DDLogNameTableLevelAtIndex(NSUInteger index) {
+    return &DDLogNameTableChunks[index / kDDLogNameTableChunkSize][index % kDDLogNameTableChunkSize];
+}
+
+// Must be called with the mutex held.
+// Returns NO if the table can't grow any further.
+static BOOL DDLogNameTableReserveIndex(NSUInteger index) {
+    __auto_type chunk = index / kDDLogNameTableChunkSize;
+    if (chunk >= kDDLogNameTableMaximumChunkCount) {
+        return NO;
+    }
+    if (DDLogNameTableChunks[chunk] == NULL) {
+        DDLogNameTableChunks[chunk] = calloc(kDDLogNameTableChunkSize, sizeof(NSUInteger));
+    }
+    return DDLogNameTableChunks[chunk] != NULL;
+}
+
+// Must be called with the mutex held.
+static void DDLogNameTablePrepare(void) {
+    if (DDLogNameTableNames != nil) {
+        return;
+    }
+    DDLogNameTableNames = [NSMutableArray arrayWithObject:@""];
+    DDLogNameTableIndexes = [NSMutableDictionary dictionaryWithObject:@0 forKey:@""];
+    DDLogNameLevels = [NSMutableDictionary new];
+    static NSUInteger firstChunk[kDDLogNameTableChunkSize];
+    DDLogNameTableChunks[0] = firstChunk;
+    __atomic_store_n(DDLogNameTableLevelAtIndex(0), (NSUInteger)DDLogLevelAll, __ATOMIC_RELAXED);
+}
+
+// Must be called with the mutex held.
+static DDLogLevel DDLogNameEffectiveLevel(NSString *name) {
+    for (;;) {
+        NSNumber *level = DDLogNameLevels[name];
+        if (level != nil) {
+            return (DDLogLevel)level.unsignedIntegerValue;
+        }
+        if (name.length == 0) {
+            return DDLogLevelAll;
+        }
+        __auto_type dot = [name rangeOfString:@"." options:NSBackwardsSearch];
+        name = dot.location == NSNotFound ? @"" : [name substringToIndex:dot.location];
+    }
+}
+
+// Must be called with the mutex held.
+static void DDLogNameTableUpdateLevels(void) {
+    __auto_type count = DDLogNameTableNames.count;
+    for (NSUInteger i = 0; i < count; i++) {
+        __atomic_store_n(DDLogNameTableLevelAtIndex(i), (NSUInteger)DDLogNameEffectiveLevel(DDLogNameTableNames[i]), __ATOMIC_RELAXED);
+    }
+}
+
+const NSUInteger * DDLogNameResolveLevel(DDLogName *logName) {
+    __auto_type name = (logName->name ? @(logName->name) : nil) ?: @"";
+
+    pthread_mutex_lock(&DDLogNameTableMutex);
+    DDLogNameTablePrepare();
+    NSNumber *index = DDLogNameTableIndexes[name];
+    if (index == nil && DDLogNameTableReserveIndex(DDLogNameTableNames.count)) {
+        index = @(DDLogNameTableNames.count);
+        [DDLogNameTableNames addObject:name];
+        DDLogNameTableIndexes[name] = index;
+        __atomic_store_n(DDLogNameTableLevelAtIndex(index.unsignedIntegerValue), (NSUInteger)DDLogNameEffectiveLevel(name), __ATOMIC_RELAXED);
+    }
+
+    // A name which doesn't fit keeps no address, so its level is computed from the hierarchy every time.
+    const NSUInteger *level;
+    if (index != nil) {
+        level = DDLogNameTableLevelAtIndex(index.unsignedIntegerValue);
+        __atomic_store_n(&logName->_level, (void *)level, __ATOMIC_RELEASE);
+    } else {
+        if (!DDLogNameTableDidOverflow) {
+            DDLogNameTableDidOverflow = YES;
+            NSLog(@"DDLog: Too many names in use (%lu), the levels of the other names are looked up on every log statement",
+                  (unsigned long)DDLogNameTableNames.count);
+        }
+        DDLogNameOverflowLevel = (NSUInteger)DDLogNameEffectiveLevel(name);
+        level = &DDLogNameOverflowLevel;
+    }
+    pthread_mutex_unlock(&DDLogNameTableMutex);
+
+    return level;
+}
+
+// The routing table maps a context and a flag to the logger nodes getting their log messages.
+// It is an open addressing hash table, only used on the logging queue.
+// Routes are added the first time a context and flag are logged, and the table is cleared whenever the loggers change.
+
+enum {
+    kDDLogRouteTableMinimumCapacity = 16, // Must be a power of 2
+    kDDLogRouteTableMaximumCount = 4096, // Past this many routes, the table is cleared rather than grown
+};
+
+typedef struct {
+    NSInteger context;
+    DDLogFlag flag;
+    CFArrayRef nodes; // Retained, NULL for an empty slot
+} DDLogRoute;
+
+typedef struct {
+    DDLogRoute *routes;
+    NSUInteger capacity; // A power of 2, or 0 until the first route is added
+    NSUInteger count;
+} DDLogRouteTable;
+
+NS_INLINE NSUInteger DDLogRouteTableSlot(const DDLogRouteTable *table, NSInteger context, DDLogFlag flag) {
+    __auto_type hash = ((uint64_t)context * 0x9E3779B97F4A7C15ULL) ^ (uint64_t)flag;
+    hash ^= hash >> 32;
+    return (NSUInteger)hash & (table->capacity - 1);
+}
+
+NS_INLINE CFArrayRef DDLogRouteTableLookup(const DDLogRouteTable *table, NSInteger context, DDLogFlag flag) {
+    if (table->capacity == 0) {
+        return NULL;
+    }
+
+    for (__auto_type slot = DDLogRouteTableSlot(table, context, flag);; slot = (slot + 1) & (table->capacity - 1)) {
+        __auto_type route = &table->routes[slot];
+        if (route->nodes == NULL) {
+            return NULL;
+        }
+        if (route->context == context && route->flag == flag) {
+            return route->nodes;
+        }
+    }
+}
+
+static void DDLogRouteTableClear(DDLogRouteTable *table) {
+    for (NSUInteger i = 0; i < table->capacity; i++) {
+        DDLogCFReleaseIfNeeded(table->routes[i].nodes);
+        table->routes[i].nodes = NULL;
+    }
+    table->count = 0;
+}
+
+static void DDLogRouteTableInsertRoute(DDLogRouteTable *table, DDLogRoute route) {
+    __auto_type slot = DDLogRouteTableSlot(table, route.context, route.flag);
+    while (table->routes[slot].nodes != NULL) {
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+    table->routes[slot] = route;
+    table->count++;
+}
+
+// Takes a reference to the nodes. The context and flag must not be in the table yet.
+static void DDLogRouteTableAdd(DDLogRouteTable *table, NSInteger context, DDLogFlag flag, CFArrayRef nodes) {
+    if (table->count >= kDDLogRouteTableMaximumCount) {
+        // Contexts are usually few, but nothing keeps them from being made up on the fly.
+        DDLogRouteTableClear(table);
+    }
+
+    // Keep the load factor under 1/2.
+    if ((table->count + 1) * 2 > table->capacity) {
+        __auto_type oldRoutes = table->routes;
+        __auto_type oldCapacity = table->capacity;
+        table->capacity = MAX(oldCapacity * 2, (NSUInteger)kDDLogRouteTableMinimumCapacity);
+        table->routes = calloc(table->capacity, sizeof(DDLogRoute));
+        table->count = 0;
+        for (NSUInteger i = 0; i < oldCapacity; i++) {
+            if (oldRoutes[i].nodes != NULL) {
+                DDLogRouteTableInsertRoute(table, oldRoutes[i]);
+            }
+        }
+        free(oldRoutes);
+    }
+
+    DDLogRouteTableInsertRoute(table, (DDLogRoute){ context, flag, CFRetain(nodes) });
+}
+
+@interface DDLoggerNode : NSObject
+{
+    // Direct accessors to be used only for performance
+    @public
+    id <DDLogger> _logger;
+    DDLogLevel _level;
+    dispatch_queue_t _loggerQueue;
+    BOOL _implementsLogMessages;
+
+    // Set if the queue of the logger was moved to the worker pool, to move it back once the logger is removed.
+    BOOL _retargetedLoggerQueue;
+
+    // Synchronous log messages only wait for the durable loggers, when there are some.
+    BOOL _durable;
+
+    // Refine the level, see -[DDLog addLogger:withLevel:route:tagPredicate:]. Either may be nil.
+    DDLogRoutePredicate _route;
+    DDLogTagPredicate _tagPredicate;
+
+    // Only used with DDLog.maximumPendingMessagesPerLogger, under the window mutex.
+    // The blocks which don't fit in the window are parked, the logger queue picks them up as the blocks in flight finish.
+    pthread_mutex_t _windowMutex;
+    NSUInteger _inFlightCount;
+    NSMutableArray<dispatch_block_t> *_parkedBlocks;
+
+    // Only updated with DDLog.collectsStatistics, and only on the logger queue.
+    atomic_ulong _serviceTimeHistogram[kDDLogServiceTimeBucketCount];
+    atomic_ulong _deliveredMessageCount;
+    atomic_ullong _maximumServiceTime;
+    atomic_ulong _flushCount;
+    atomic_ullong _totalFlushDuration;
+    atomic_ullong _maximumFlushDuration;
+}
+
+@property (nonatomic, readonly) id <DDLogger> logger;
+@property (nonatomic, readonly) DDLogLevel level;
+@property (nonatomic, readonly) dispatch_queue_t loggerQueue;
+
++ (instancetype)nodeWithLogger:(id <DDLogger>)logger
+                   loggerQueue:(dispatch_queue_t)loggerQueue
+                         level:(DDLogLevel)level;
+
+// Must be called on the logger queue.
+// The logger is measured if collectsStatistics is set.
+- (void)lt_logMessage:(DDLogMessage *)logMessage collectingStatistics:(BOOL)collectsStatistics;
+- (void)lt_logMessages:(NSArray<DDLogMessage *> *)logMessages collectingStatistics:(BOOL)collectsStatistics;
+- (void)lt_flushCollectingStatistics:(BOOL)collectsStatistics;
+
+// May be called from any queue.
+- (DDLoggerStatistics *)statistics;
+
+// Dispatches the block to the logger queue if there's room in the window of the node, or parks it until there is.
+// Never waits for the logger. If a group is given, the block is added to it.
+- (void)lt_dispatchWithWindowSize:(NSUInteger)windowSize group:(nullable dispatch_group_t)group block:(dispatch_block_t)block;
+
+@end
+
+// A flush which isn't waited for forever.
+// The loggers may finish flushing after the flush is over, so they report to this shared state.
+@interface DDLogFlush : NSObject
+
+@property (nonatomic, readonly) dispatch_group_t group;
+@property (nonatomic, readonly) DDLogFlag discardedFlags;
+// The monotonic time the flush started at. Only the log messages created before are discarded.
+@property (nonatomic, readonly) uint64_t startNanoseconds;
+
+// The loggers are the ones the flush waits for until it reaches the logging queue.
+- (instancetype)initWithLoggers:(nullable NSArray<id<DDLogger>> *)loggers
+                 discardedFlags:(DDLogFlag)discardedFlags NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+// Called on the logging queue, once the log messages queued before the flush were handed over to the loggers.
+- (void)lt_didReachLoggingQueue;
+- (void)lt_willWaitForLogger:(id <DDLogger>)logger;
+
+// Called on the logger queue.
+- (void)loggerDidFlush:(id <DDLogger>)logger;
+
+// Returns the loggers which didn't flush yet, or nil if the flush was already finished.
+- (nullable NSArray<id<DDLogger>> *)finish;
+
+@end
+
+// The message formatted by a pure formatter, shared by the loggers using that formatter.
+typedef struct DDLogFormattedMessage {
+    struct DDLogFormattedMessage *next;
+    const void *formatter; // Retained, so that its address can't be reused while the message lives.
+    const void *string;    // Retained, NULL if the formatter filtered the message out.
+} DDLogFormattedMessage;
+
+static void DDLogFormattedMessagesFree(DDLogFormattedMessage *formattedMessage) {
+    while (formattedMessage) {
+        __auto_type next = formattedMessage->next;
+        CFRelease(formattedMessage->formatter);
+        if (formattedMessage->string) {
+            CFRelease(formattedMessage->string);
+        }
+        free(formattedMessage);
+        formattedMessage = next;
+    }
+}
+
+NS_INLINE DDLogFormattedMessage * DDLogFormattedMessageFind(DDLogFormattedMessage *first,
+                                                           DDLogFormattedMessage *last,
+                                                           const void *formatter) {
+    for (__auto_type formattedMessage = first; formattedMessage != last; formattedMessage = formattedMessage->next) {
+        if (formattedMessage->formatter == formatter) {
+            return formattedMessage;
+        }
+    }
+    return NULL;
+}
+
+@interface DDLogMessage ()
+{
+    @package
+    // Only set for messages taken from the pool of a DDLog with recyclesLogMessages.
+    // Every party holding the message (the DDLog itself, and each logger it is dispatched to) counts as a delivery.
+    // Once the last delivery is done, the message goes back to the pool.
+    DDLog *_recyclingLog;
+    atomic_uint _deliveryCount;
+
+    // Set when the formatting of the message is deferred, _message being the format.
+    // The message is rendered the first time it's asked for, and published in _deferredMessage (retained).
+    DDLogArguments *_arguments;
+    _Atomic(void *) _deferredMessage;
+
+    DDLogCallsite *_callsite;
+
+    // The retained NSData returned by messageUTF8Data, published once encoded.
+    _Atomic(void *) _messageUTF8Data;
+
+    // The messages formatted by pure formatters, newest first. Entries are only ever pushed.
+    _Atomic(DDLogFormattedMessage *) _formattedMessages;
+}
+
+- (void)setUpWithFormat:(NSString *)messageFormat
+              formatted:(NSString *)message
+                  level:(DDLogLevel)level
+                   flag:(DDLogFlag)flag
+                context:(NSInteger)context
+                   file:(NSString *)file
+               function:(NSString *)function
+                   line:(NSUInteger)line
+                    tag:(id)tag
+                options:(DDLogMessageOptions)options
+              timestamp:(NSDate *)timestamp
+               callsite:(DDLogCallsite *)callsite;
+
+// Lets go of everything the message references, while in the pool.
+- (void)prepareForReuse;
+
+@end
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface DDLog ()
+{
+    atomic_long _ingressMode;
+
+    // Allocated the first time DDLogIngressModeRingBuffer is enabled, and kept until dealloc.
+    _Atomic(DDLogRing *) _ring;
+
+    // Allocated the first time DDLogIngressModeShardedRingBuffer is enabled, and kept until dealloc.
+    _Atomic(DDLogShards *) _shards;
+
+    // The log blocks of the messages with one of the priority flags, drained ahead of the logging queue's backlog.
+    // Allocated the first time priority flags are set, and kept until dealloc.
+    atomic_ulong _priorityFlags;
+    _Atomic(DDLogRing *) _priorityLane;
+    BOOL _drainingPriorityLane; // Only used on the logging queue.
+    BOOL _drainingIngress; // Only used on the logging queue.
+    NSUInteger _scheduledRedrains; // The drains stopped at an unpublished slot, see DDLogRedrain. Only used on the logging queue.
+
+    // All logging statements of an instance are added to its queue to ensure FIFO operation.
+    // Separate instances have separate queues, so they don't contend with each other.
+    dispatch_queue_t _loggingQueue;
+
+    // Individual loggers are executed concurrently per log statement.
+    // Each logger has it's own associated queue, and a dispatch group is used for synchronization.
+    dispatch_group_t _loggingGroup;
+
+    // The loggers each context and flag are routed to. Only used on the logging queue.
+    DDLogRouteTable _routeTable;
+    BOOL _hasTagPredicates;
+
+    // Bounded queue.
+    // _queueSize counts the messages handed over to the logging queue which haven't been unqueued yet.
+    atomic_ulong _maximumQueueSize;
+    atomic_long _overflowPolicy;
+    atomic_ulong _overflowThresholdFlag;
+    atomic_ulong _queueSize;
+    atomic_ulong _droppedMessageCount;
+    atomic_ulong _unreportedDroppedMessageCount;
+    atomic_ulong _discardedMessageCount; // Shed by flushes, not because the queue was full.
+    atomic_ulong _evictionDebt;
+
+    atomic_ulong _maximumPendingMessagesPerLogger;
+    atomic_long _schedulerMode;
+
+    // Only updated on the logging queue.
+    atomic_ulong _durableLoggerCount;
+
+    // The OR of the levels of all loggers, read by the callers before creating log messages.
+    // Levels of loggers being added are included right away, so the mask only shrinks
+    // on the logging queue, and only while no logger is waiting to be added.
+    atomic_ulong _aggregateLevel;
+    pthread_mutex_t _aggregateLevelMutex;
+    NSUInteger _pendingLoggerAdditionCount;
+
+    // Recycled log messages (not retained by their _recyclingLog while in here).
+    // Allocated the first time recyclesLogMessages is enabled, and kept until dealloc.
+    atomic_bool _recyclesLogMessages;
+    _Atomic(DDLogRing *) _messagePool;
+
+    atomic_bool _defersMessageFormatting;
+
+    // Duplicate suppression.
+    // The table is allocated the first time a suppression mode is enabled, and kept until dealloc.
+    atomic_long _suppressionMode;
+    atomic_ullong _suppressionWindow; // Nanoseconds.
+    atomic_ulong _suppressedMessageCount;
+    _Atomic(DDLogSuppressionTable *) _suppressionTable;
+
+    // Sampling policies (retained), by context and flag.
+    // _hasSamplingRules lets the callers skip the lock as long as there's no policy.
+    atomic_bool _hasSamplingRules;
+    pthread_rwlock_t _samplingRulesLock;
+    DDLogSamplingRule *_samplingRules;
+    NSUInteger _samplingRuleCount;
+    atomic_ulong _sampledOutMessageCount;
+
+    // Statistics, only collected with collectsStatistics.
+    // The delivered counts are only updated on the logging queue.
+    atomic_bool _collectsStatistics;
+    DDLogStatisticsStripe _statisticsStripes[kDDLogStatisticsStripeCount];
+    atomic_ulong _deliveredCounts[kDDLogStatisticsFlagCount];
+    atomic_ullong _maximumQueueDepth;
+
+    // The flags of the asynchronous log messages to drop, while flushes shedding them are in progress.
+    // Only the messages created before the last of these flushes started are dropped, per flag.
+    // Overlapping flushes may shed the same flags, so the flushes in progress are kept (under the mutex).
+    atomic_ulong _discardedFlags;
+    atomic_ullong _discardedFlagDeadlines[sizeof(unsigned long) * CHAR_BIT];
+    pthread_mutex_t _discardedFlagsMutex;
+    NSMutableArray<DDLogFlush *> *_discardingFlushes;
+
+    // Threads blocked by DDLogOverflowPolicyBlock wait in line, using a ticket per thread.
+    pthread_mutex_t _queueSizeMutex;
+    pthread_cond_t _queueSizeCondition;
+    atomic_ulong _blockedThreadCount;
+    NSUInteger _nextTicket;
+    NSUInteger _servedTicket;
+}
+
+// An array used to manage all the individual loggers.
+// The array is only modified on the loggingQueue/loggingThread.
+@property (nonatomic, strong) NSMutableArray *_loggers;
+
+// A copy of the loggers, updated by the logging queue, for callers which can't wait for it.
+@property (atomic, copy) NSArray<id<DDLogger>> *loggersSnapshot;
+@property (atomic, copy) NSArray<DDLoggerNode *> *loggerNodesSnapshot;
+
+// Puts a log message, whose deliveries are all done, back into the pool.
+- (void)recycleLogMessage:(DDLogMessage *)logMessage;
+
+- (instancetype)initWithLoggingQueue:(dispatch_queue_t)loggingQueue;
+
+@end
+
+static void DDLogDrainRing(void *context);
+static void DDLogDrainShards(void *context);
+static void DDLogDrainPriorityLane(void *context);
+static void DDLogRedrain(void *context);
+
+enum {
+    kDDLogRedrainRing = 1 << 0,
+    kDDLogRedrainShards = 1 << 1,
+    kDDLogRedrainPriorityLane = 1 << 2,
+};
+
+// Must be called on the logging queue, before handing the message to any logger.
+// Loggers read the ivars directly, so whatever was left out at log time has to be filled in by now.
+// The deferred message is the exception, it's only rendered once a logger asks for it (see -[DDLogMessage message]).
+NS_INLINE void DDLogMessagePrepareForLoggers(DDLogMessage *logMessage) {
+    if (logMessage->_timestamp == nil) {
+        logMessage->_timestamp = DDLogDateFromNanoseconds(logMessage->_timestampNanoseconds);
+    }
+}
+
+NS_INLINE void DDLogMessageRetainDelivery(DDLogMessage *logMessage) {
+    if (logMessage->_recyclingLog) {
+        atomic_fetch_add_explicit(&logMessage->_deliveryCount, 1, memory_order_relaxed);
+    }
+}
+
+// The message must not be used by the caller anymore afterwards.
+static void DDLogMessageReleaseDelivery(DDLogMessage *logMessage) {
+    if (logMessage->_recyclingLog == nil
+        || atomic_fetch_sub_explicit(&logMessage->_deliveryCount, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    // The log may go away along with the last message referencing it.
+    __auto_type log = logMessage->_recyclingLog;
+    logMessage->_recyclingLog = nil;
+    [log recycleLogMessage:logMessage];
+}
+
+// Maps each logger to the instance it was last added to, both weakly.
+static pthread_mutex_t DDLogOwnerTableMutex = PTHREAD_MUTEX_INITIALIZER;
+static NSMapTable<id <DDLogger>, DDLog *> *DDLogOwnerTable;
+
+static void DDLogOwnerTableSetOwner(id <DDLogger> logger, DDLog *log) {
+    pthread_mutex_lock(&DDLogOwnerTableMutex);
+    if (DDLogOwnerTable == nil) {
+        DDLogOwnerTable = [[NSMapTable alloc] initWithKeyOptions:NSPointerFunctionsWeakMemory | NSPointerFunctionsObjectPointerPersonality
+                                                    valueOptions:NSPointerFunctionsWeakMemory
+                                                        capacity:4];
+    }
+    [DDLogOwnerTable setObject:log forKey:logger];
+    pthread_mutex_unlock(&DDLogOwnerTableMutex);
+}
+
+// Only removes the entry if the logger wasn't added to another instance since.
+static void DDLogOwnerTableRemoveOwner(id <DDLogger> logger, DDLog *log) {
+    pthread_mutex_lock(&DDLogOwnerTableMutex);
+    if ([DDLogOwnerTable objectForKey:logger] == log) {
+        [DDLogOwnerTable removeObjectForKey:logger];
+    }
+    pthread_mutex_unlock(&DDLogOwnerTableMutex);
+}
+
+static void DDLogOwnerTableRemoveLog(DDLog *log) {
+    pthread_mutex_lock(&DDLogOwnerTableMutex);
+    for (id <DDLogger> logger in [[DDLogOwnerTable keyEnumerator] allObjects]) {
+        if ([DDLogOwnerTable objectForKey:logger] == log) {
+            [DDLogOwnerTable removeObjectForKey:logger];
+        }
+    }
+    pthread_mutex_unlock(&DDLogOwnerTableMutex);
+}
+
+static DDLog * _Nullable DDLogOwnerTableOwner(id <DDLogger> logger) {
+    pthread_mutex_lock(&DDLogOwnerTableMutex);
+    DDLog *log = [DDLogOwnerTable objectForKey:logger];
+    pthread_mutex_unlock(&DDLogOwnerTableMutex);
+    return log;
+}
+
+@implementation DDLog
+
+// The logging queue of the shared instance.
+static dispatch_queue_t _globalLoggingQueue;
+
+// With DDLogSchedulerModeWorkerPool, the queues of the loggers target this concurrent queue.
+// Unlike serial queues, it runs on the non-overcommitting threads of GCD, which are bounded by the number of cores.
+static dispatch_queue_t _workerQueue;
+
+// Minor optimization for uniprocessor machines
+static NSUInteger _numProcessors;
+
+/**
+ *  Returns the singleton `DDLog`.
+ *  The instance is used by `DDLog` class methods.
+ *
+ *  @return The singleton `DDLog`.
+ */
++ (instancetype)sharedInstance {
+    static DDLog *sharedInstance = nil;
+
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedInstance = [[self alloc] initWithLoggingQueue:_globalLoggingQueue];
+    });
+
+    return sharedInstance;
+}
+
+/**
+ * The runtime sends initialize to each class in a program exactly one time just before the class,
+ * or any class that inherits from it, is sent its first message from within the program. (Thus the
+ * method may never be invoked if the class is not used.) The runtime sends the initialize message to
+ * classes in a thread-safe manner. Superclasses receive this message before their subclasses.
+ *
+ * This method may also be called directly, hence the safety mechanism.
+ **/
++ (void)initialize {
+    static dispatch_once_t DDLogOnceToken;
+
+    dispatch_once(&DDLogOnceToken, ^{
+        NSLogDebug(@"DDLog: Using grand central dispatch");
+
+        _globalLoggingQueue = dispatch_queue_create("cocoa.lumberjack", NULL);
+        _workerQueue = dispatch_queue_create("cocoa.lumberjack.workers", DISPATCH_QUEUE_CONCURRENT);
+
+        // Figure out how many processors are available.
+        // This may be used later for an optimization on uniprocessor machines.
+
+        _numProcessors = MAX([NSProcessInfo processInfo].processorCount, (NSUInteger) 1);
+
+        NSLogDebug(@"DDLog: numProcessors = %@", @(_numProcessors));
+    });
+}
+
+/**
+ *  The `DDLog` initializer.
+ *  Static variables are set only once.
+ *
+ *  @return An initialized `DDLog` instance, with its own logging queue.
+ */
+- (instancetype)init {
+    return [self initWithLoggingQueue:dispatch_queue_create("cocoa.lumberjack.instance", NULL)];
+}
+
+/**
+ *  Initializes a `DDLog` using the given (serial) logging queue.
+ *  The shared instance uses the global logging queue, every other instance gets a queue of its own.
+ */
+- (instancetype)initWithLoggingQueue:(dispatch_queue_t)loggingQueue {
+    self = [super init];
+
+    if (self) {
+        self._loggers = [[NSMutableArray alloc] initWithCapacity:4];
+
+        _loggingQueue = loggingQueue;
+        _loggingGroup = dispatch_group_create();
+
+        void *nonNullValue = GlobalLoggingQueueIdentityKey; // Whatever, just not null
+        dispatch_queue_set_specific(_loggingQueue, GlobalLoggingQueueIdentityKey, nonNullValue, NULL);
+
+        // Not retained, the queue goes away along with the instance (the shared one is never deallocated).
+        dispatch_queue_set_specific(_loggingQueue, LoggingQueueOwnerKey, (__bridge void *)self, NULL);
+
+        atomic_init(&_ingressMode, DDLogIngressModeDispatch);
+        atomic_init(&_ring, NULL);
+        atomic_init(&_shards, NULL);
+        atomic_init(&_priorityFlags, 0);
+        atomic_init(&_priorityLane, NULL);
+        atomic_init(&_durableLoggerCount, 0);
+
+        atomic_init(&_maximumQueueSize, 0);
+        atomic_init(&_overflowPolicy, DDLogOverflowPolicyBlock);
+        atomic_init(&_overflowThresholdFlag, DDLogFlagWarning);
+        atomic_init(&_queueSize, 0);
+        atomic_init(&_droppedMessageCount, 0);
+        atomic_init(&_discardedMessageCount, 0);
+        atomic_init(&_unreportedDroppedMessageCount, 0);
+        atomic_init(&_evictionDebt, 0);
+        atomic_init(&_maximumPendingMessagesPerLogger, 0);
+        atomic_init(&_schedulerMode, DDLogSchedulerModeQueuePerLogger);
+        atomic_init(&_aggregateLevel, 0);
+        pthread_mutex_init(&_aggregateLevelMutex, NULL);
+        _pendingLoggerAdditionCount = 0;
+        atomic_init(&_recyclesLogMessages, false);
+        atomic_init(&_messagePool, NULL);
+        atomic_init(&_defersMessageFormatting, false);
+        atomic_init(&_suppressionMode, DDLogSuppressionModeNone);
+        atomic_init(&_suppressionWindow, NSEC_PER_SEC);
+        atomic_init(&_suppressedMessageCount, 0);
+        atomic_init(&_suppressionTable, NULL);
+        atomic_init(&_hasSamplingRules, false);
+        pthread_rwlock_init(&_samplingRulesLock, NULL);
+        _samplingRules = NULL;
+        _samplingRuleCount = 0;
+        atomic_init(&_sampledOutMessageCount, 0);
+        atomic_init(&_collectsStatistics, false);
+        atomic_init(&_maximumQueueDepth, 0);
+        atomic_init(&_discardedFlags, 0);
+        for (NSUInteger i = 0; i < sizeof(_discardedFlagDeadlines) / sizeof(_discardedFlagDeadlines[0]); i++) {
+            atomic_init(&_discardedFlagDeadlines[i], 0);
+        }
+        _discardingFlushes = [NSMutableArray new];
+        pthread_mutex_init(&_discardedFlagsMutex, NULL);
+        atomic_init(&_blockedThreadCount, 0);
+        pthread_mutex_init(&_queueSizeMutex, NULL);
+        pthread_cond_init(&_queueSizeCondition, NULL);
+
+#if TARGET_OS_IOS
+        __auto_type notificationName = UIApplicationWillTerminateNotification;
+#else
+        NSString *notificationName = nil;
+
+        // On Command Line Tool apps AppKit may not be available
+#if !defined(DD_CLI) && __has_include(<AppKit/NSApplication.h>)
+        if (NSApp) {
+            notificationName = NSApplicationWillTerminateNotification;
+        }
+#endif
+
+        if (!notificationName) {
+            // If there is no NSApp -> we are running Command Line Tool app.
+            // In this case terminate notification wouldn't be fired, so we use workaround.
+            __weak __auto_type weakSelf = self;
+            atexit_b (^{
+                [weakSelf applicationWillTerminate:nil];
+            });
+        }
+
+#endif /* if TARGET_OS_IOS */
+
+        if (notificationName) {
+            [[NSNotificationCenter defaultCenter] addObserver:self
+                                                     selector:@selector(applicationWillTerminate:)
+                                                         name:notificationName
+                                                       object:nil];
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc {
+    // Every scheduled drain retains us, so the ring, the shards and the priority lane are empty at this point.
+    free(atomic_load_explicit(&_ring, memory_order_relaxed));
+    __auto_type shards = atomic_load_explicit(&_shards, memory_order_relaxed);
+    if (shards) {
+        DDLogShardsFree(shards);
+    }
+    free(atomic_load_explicit(&_priorityLane, memory_order_relaxed));
+    DDLogRouteTableClear(&_routeTable);
+    free(_routeTable.routes);
+
+    pthread_mutex_destroy(&_discardedFlagsMutex);
+    pthread_mutex_destroy(&_queueSizeMutex);
+    pthread_cond_destroy(&_queueSizeCondition);
+    pthread_mutex_destroy(&_aggregateLevelMutex);
+
+    __auto_type messagePool = atomic_load_explicit(&_messagePool, memory_order_relaxed);
+    if (messagePool) {
+        void *item;
+        while ((item = DDLogRingTryDequeue(messagePool)) != NULL) {
+            CFRelease(item);
+        }
+        free(messagePool);
+    }
+
+    __auto_type suppressionTable = atomic_load_explicit(&_suppressionTable, memory_order_relaxed);
+    if (suppressionTable) {
+        DDLogSuppressionTableFree(suppressionTable);
+    }
+
+    for (NSUInteger i = 0; i < _samplingRuleCount; i++) {
+        CFRelease(_samplingRules[i].policy);
+    }
+    free(_samplingRules);
+    pthread_rwlock_destroy(&_samplingRulesLock);
+}
+
+/**
+ * Provides access to the logging queue of the shared instance.
+ **/
++ (dispatch_queue_t)loggingQueue {
+    return _globalLoggingQueue;
+}
+
+- (dispatch_queue_t)loggingQueue {
+    return _loggingQueue;
+}
+
++ (DDLog *)logOwningLogger:(id <DDLogger>)logger {
+    return DDLogOwnerTableOwner(logger);
+}
+
+- (DDLogIngressMode)ingressMode {
+    return (DDLogIngressMode)atomic_load_explicit(&_ingressMode, memory_order_relaxed);
+}
+
+- (void)setIngressMode:(DDLogIngressMode)ingressMode {
+    if (ingressMode == DDLogIngressModeRingBuffer && atomic_load_explicit(&_ring, memory_order_acquire) == NULL) {
+        DDLogRing *expected = NULL;
+        __auto_type ring = DDLogRingCreate(kDDLogRingCapacity);
+        if (ring == NULL) {
+            NSLogDebug(@"DDLog: Unable to allocate the ring buffer, staying in dispatch mode");
+            return;
+        }
+        if (!atomic_compare_exchange_strong_explicit(&_ring, &expected, ring, memory_order_release, memory_order_acquire)) {
+            // Somebody else was faster.
+            free(ring);
+        }
+    }
+
+    if (ingressMode == DDLogIngressModeShardedRingBuffer && atomic_load_explicit(&_shards, memory_order_acquire) == NULL) {
+        // One shard per core, as long as that's a power of 2.
+        __auto_type shardCount = MIN((NSUInteger)1 << (63 - __builtin_clzll(_numProcessors)), (NSUInteger)kDDLogMaximumShardCount);
+        DDLogShards *expected = NULL;
+        __auto_type shards = DDLogShardsCreate(shardCount);
+        if (shards == NULL) {
+            NSLogDebug(@"DDLog: Unable to allocate the shards, staying in dispatch mode");
+            return;
+        }
+        if (!atomic_compare_exchange_strong_explicit(&_shards, &expected, shards, memory_order_release, memory_order_acquire)) {
+            // Somebody else was faster.
+            DDLogShardsFree(shards);
+        }
+    }
+
+    atomic_store_explicit(&_ingressMode, ingressMode, memory_order_relaxed);
+}
+
+- (DDLogFlag)priorityFlags {
+    return (DDLogFlag)atomic_load_explicit(&_priorityFlags, memory_order_relaxed);
+}
+
+- (void)setPriorityFlags:(DDLogFlag)priorityFlags {
+    if (priorityFlags != 0 && atomic_load_explicit(&_priorityLane, memory_order_acquire) == NULL) {
+        DDLogRing *expected = NULL;
+        __auto_type priorityLane = DDLogRingCreate(kDDLogPriorityLaneCapacity);
+        if (priorityLane == NULL) {
+            NSLogDebug(@"DDLog: Unable to allocate the priority lane, staying without one");
+            return;
+        }
+        if (!atomic_compare_exchange_strong_explicit(&_priorityLane, &expected, priorityLane, memory_order_release, memory_order_acquire)) {
+            // Somebody else was faster.
+            free(priorityLane);
+        }
+    }
+
+    atomic_store_explicit(&_priorityFlags, priorityFlags, memory_order_relaxed);
+}
+
+- (NSUInteger)maximumQueueSize {
+    return atomic_load_explicit(&_maximumQueueSize, memory_order_relaxed);
+}
+
+- (void)setMaximumQueueSize:(NSUInteger)maximumQueueSize {
+    atomic_store(&_maximumQueueSize, maximumQueueSize);
+
+    // Blocked threads may fit in now.
+    pthread_mutex_lock(&_queueSizeMutex);
+    pthread_cond_broadcast(&_queueSizeCondition);
+    pthread_mutex_unlock(&_queueSizeMutex);
+}
+
+- (DDLogOverflowPolicy)overflowPolicy {
+    return (DDLogOverflowPolicy)atomic_load_explicit(&_overflowPolicy, memory_order_relaxed);
+}
+
+- (void)setOverflowPolicy:(DDLogOverflowPolicy)overflowPolicy {
+    atomic_store_explicit(&_overflowPolicy, overflowPolicy, memory_order_relaxed);
+}
+
+- (DDLogFlag)overflowThresholdFlag {
+    return (DDLogFlag)atomic_load_explicit(&_overflowThresholdFlag, memory_order_relaxed);
+}
+
+- (void)setOverflowThresholdFlag:(DDLogFlag)overflowThresholdFlag {
+    atomic_store_explicit(&_overflowThresholdFlag, overflowThresholdFlag, memory_order_relaxed);
+}
+
+- (NSUInteger)droppedMessageCount {
+    return atomic_load_explicit(&_droppedMessageCount, memory_order_relaxed);
+}
+
+- (NSUInteger)discardedMessageCount {
+    return atomic_load_explicit(&_discardedMessageCount, memory_order_relaxed);
+}
+
+- (NSUInteger)maximumPendingMessagesPerLogger {
+    return atomic_load_explicit(&_maximumPendingMessagesPerLogger, memory_order_relaxed);
+}
+
+- (void)setMaximumPendingMessagesPerLogger:(NSUInteger)maximumPendingMessagesPerLogger {
+    atomic_store_explicit(&_maximumPendingMessagesPerLogger, maximumPendingMessagesPerLogger, memory_order_relaxed);
+}
+
+- (DDLogSchedulerMode)schedulerMode {
+    return (DDLogSchedulerMode)atomic_load_explicit(&_schedulerMode, memory_order_relaxed);
+}
+
+- (void)setSchedulerMode:(DDLogSchedulerMode)schedulerMode {
+    atomic_store_explicit(&_schedulerMode, schedulerMode, memory_order_relaxed);
+}
+
+- (DDLogLevel)aggregateLevel {
+    return (DDLogLevel)atomic_load_explicit(&_aggregateLevel, memory_order_relaxed);
+}
+
+- (BOOL)recyclesLogMessages {
+    return atomic_load_explicit(&_recyclesLogMessages, memory_order_relaxed);
+}
+
+- (void)setRecyclesLogMessages:(BOOL)recyclesLogMessages {
+    if (recyclesLogMessages && atomic_load_explicit(&_messagePool, memory_order_acquire) == NULL) {
+        DDLogRing *expected = NULL;
+        __auto_type messagePool = DDLogRingCreate(kDDLogMessagePoolCapacity);
+        if (messagePool == NULL) {
+            NSLogDebug(@"DDLog: Unable to allocate the message pool, not recycling log messages");
+            return;
+        }
+        if (!atomic_compare_exchange_strong_explicit(&_messagePool, &expected, messagePool, memory_order_release, memory_order_acquire)) {
+            // Somebody else was faster.
+            free(messagePool);
+        }
+    }
+
+    atomic_store_explicit(&_recyclesLogMessages, recyclesLogMessages, memory_order_relaxed);
+}
+
+- (BOOL)defersMessageFormatting {
+    return atomic_load_explicit(&_defersMessageFormatting, memory_order_relaxed);
+}
+
+- (void)setDefersMessageFormatting:(BOOL)defersMessageFormatting {
+    atomic_store_explicit(&_defersMessageFormatting, defersMessageFormatting, memory_order_relaxed);
+}
+
+- (DDLogSuppressionMode)suppressionMode {
+    return (DDLogSuppressionMode)atomic_load_explicit(&_suppressionMode, memory_order_relaxed);
+}
+
+- (void)setSuppressionMode:(DDLogSuppressionMode)suppressionMode {
+    if (suppressionMode != DDLogSuppressionModeNone && atomic_load_explicit(&_suppressionTable, memory_order_acquire) == NULL) {
+        DDLogSuppressionTable *expected = NULL;
+        __auto_type suppressionTable = DDLogSuppressionTableCreate();
+        if (suppressionTable == NULL) {
+            NSLogDebug(@"DDLog: Unable to allocate the suppression table, not suppressing log messages");
+            return;
+        }
+        if (!atomic_compare_exchange_strong_explicit(&_suppressionTable, &expected, suppressionTable, memory_order_release, memory_order_acquire)) {
+            // Somebody else was faster.
+            DDLogSuppressionTableFree(suppressionTable);
+        }
+    }
+
+    atomic_store_explicit(&_suppressionMode, suppressionMode, memory_order_release);
+}
+
+- (NSTimeInterval)suppressionWindow {
+    return (NSTimeInterval)atomic_load_explicit(&_suppressionWindow, memory_order_relaxed) / NSEC_PER_SEC;
+}
+
+- (void)setSuppressionWindow:(NSTimeInterval)suppressionWindow {
+    atomic_store_explicit(&_suppressionWindow, (uint64_t)(MAX(suppressionWindow, 0) * NSEC_PER_SEC), memory_order_relaxed);
+}
+
+- (NSUInteger)suppressedMessageCount {
+    return atomic_load_explicit(&_suppressedMessageCount, memory_order_relaxed);
+}
+
+- (void)setSamplingPolicy:(DDLogSamplingPolicy *)policy forContext:(NSInteger)context flags:(DDLogFlag)flags {
+    pthread_rwlock_wrlock(&_samplingRulesLock);
+
+    // One rule per flag, so that a flag can be given another policy later on.
+    for (NSUInteger bit = 1; bit != 0 && bit <= flags; bit <<= 1) {
+        if ((flags & bit) == 0) {
+            continue;
+        }
+
+        __auto_type flag = (DDLogFlag)bit;
+        NSUInteger index = 0;
+        while (index < _samplingRuleCount && (_samplingRules[index].context != context || _samplingRules[index].flag != flag)) {
+            index++;
+        }
+
+        if (index < _samplingRuleCount) {
+            CFRelease(_samplingRules[index].policy);
+            if (policy) {
+                _samplingRules[index].policy = CFBridgingRetain(policy);
+            } else {
+                _samplingRules[index] = _samplingRules[--_samplingRuleCount];
+            }
+        } else if (policy) {
+            DDLogSamplingRule *rules = realloc(_samplingRules, (_samplingRuleCount + 1) * sizeof(DDLogSamplingRule));
+            if (rules == NULL) {
+                NSLogDebug(@"DDLog: Unable to allocate the sampling rules, not sampling log messages");
+                break;
+            }
+            _samplingRules = rules;
+            _samplingRules[_samplingRuleCount++] = (DDLogSamplingRule){ context, flag, CFBridgingRetain(policy) };
+        }
+    }
+
+    atomic_store_explicit(&_hasSamplingRules, _samplingRuleCount > 0, memory_order_release);
+    pthread_rwlock_unlock(&_samplingRulesLock);
+}
+
+- (DDLogSamplingPolicy *)samplingPolicyForContext:(NSInteger)context flag:(DDLogFlag)flag {
+    DDLogSamplingPolicy *policy = nil;
+
+    pthread_rwlock_rdlock(&_samplingRulesLock);
+    for (NSUInteger i = 0; i < _samplingRuleCount; i++) {
+        if (_samplingRules[i].context == context && (_samplingRules[i].flag & flag) != 0) {
+            policy = (__bridge DDLogSamplingPolicy *)_samplingRules[i].policy;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&_samplingRulesLock);
+
+    return policy;
+}
+
+- (NSUInteger)sampledOutMessageCount {
+    return atomic_load_explicit(&_sampledOutMessageCount, memory_order_relaxed);
+}
+
+- (BOOL)collectsStatistics {
+    return atomic_load_explicit(&_collectsStatistics, memory_order_relaxed);
+}
+
+- (void)setCollectsStatistics:(BOOL)collectsStatistics {
+    atomic_store_explicit(&_collectsStatistics, collectsStatistics, memory_order_relaxed);
+}
+
+- (DDLogStatistics *)statistics {
+    __auto_type statistics = [DDLogStatistics new];
+
+    for (NSUInteger i = 0; i < kDDLogStatisticsFlagCount; i++) {
+        for (NSUInteger stripe = 0; stripe < kDDLogStatisticsStripeCount; stripe++) {
+            statistics->_enqueuedCounts[i] += atomic_load_explicit(&_statisticsStripes[stripe].enqueuedCounts[i], memory_order_relaxed);
+        }
+        statistics->_deliveredCounts[i] = atomic_load_explicit(&_deliveredCounts[i], memory_order_relaxed);
+    }
+    statistics->_queueDepth = atomic_load_explicit(&_queueSize, memory_order_relaxed);
+    statistics->_maximumQueueDepth = (NSUInteger)atomic_load_explicit(&_maximumQueueDepth, memory_order_relaxed);
+    statistics->_droppedMessageCount = self.droppedMessageCount;
+    statistics->_discardedMessageCount = self.discardedMessageCount;
+    statistics->_suppressedMessageCount = self.suppressedMessageCount;
+    statistics->_sampledOutMessageCount = self.sampledOutMessageCount;
+
+    // The nodes publish their statistics through atomics, so they're read without waiting for the logging queue.
+    __auto_type loggerNodes = self.loggerNodesSnapshot;
+    __auto_type loggerStatistics = [NSMutableArray<DDLoggerStatistics *> arrayWithCapacity:loggerNodes.count];
+    for (DDLoggerNode *loggerNode in loggerNodes) {
+        [loggerStatistics addObject:[loggerNode statistics]];
+    }
+    statistics->_loggerStatistics = [loggerStatistics copy];
+
+    return statistics;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Notifications
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)applicationWillTerminate:(NSNotification * __attribute__((unused)))notification {
+    [self flushLog];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Logger Management
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
++ (void)addLogger:(id <DDLogger>)logger {
+    [self.sharedInstance addLogger:logger];
+}
+
+- (void)addLogger:(id <DDLogger>)logger {
+    [self addLogger:logger withLevel:DDLogLevelAll]; // DDLogLevelAll has all bits set
+}
+
++ (void)addLogger:(id <DDLogger>)logger withLevel:(DDLogLevel)level {
+    [self.sharedInstance addLogger:logger withLevel:level];
+}
+
+- (void)addLogger:(id <DDLogger>)logger withLevel:(DDLogLevel)level {
+    [self addLogger:logger withLevel:level route:nil tagPredicate:nil];
+}
+
++ (void)addLogger:(id <DDLogger>)logger
+        withLevel:(DDLogLevel)level
+            route:(DDLogRoutePredicate)route
+     tagPredicate:(DDLogTagPredicate)tagPredicate {
+    [self.sharedInstance addLogger:logger withLevel:level route:route tagPredicate:tagPredicate];
+}
+
+- (void)addLogger:(id <DDLogger>)logger
+        withLevel:(DDLogLevel)level
+            route:(DDLogRoutePredicate)route
+     tagPredicate:(DDLogTagPredicate)tagPredicate {
+    if (!logger) {
+        return;
+    }
+
+    route = [route copy];
+    tagPredicate = [tagPredicate copy];
+
+    // The accessors of the logger go through the logging queue of its owner, starting with this call.
+    DDLogOwnerTableSetOwner(logger, self);
+
+    // Log messages queued after this call must reach the logger, so don't wait for the logging queue.
+    pthread_mutex_lock(&_aggregateLevelMutex);
+    _pendingLoggerAdditionCount++;
+    atomic_fetch_or_explicit(&_aggregateLevel, (unsigned long)level, memory_order_relaxed);
+    pthread_mutex_unlock(&_aggregateLevelMutex);
+
+    dispatch_async(_loggingQueue, ^{ @autoreleasepool {
+        [self lt_addLogger:logger level:level route:route tagPredicate:tagPredicate];
+        [self lt_updateAggregateLevelAfterAddition:YES];
+    } });
+}
+
++ (void)removeLogger:(id <DDLogger>)logger {
+    [self.sharedInstance removeLogger:logger];
+}
+
+- (void)removeLogger:(id <DDLogger>)logger {
+    if (!logger) {
+        return;
+    }
+
+    DDLogOwnerTableRemoveOwner(logger, self);
+    dispatch_async(_loggingQueue, ^{ @autoreleasepool {
+        [self lt_removeLogger:logger];
+    } });
+}
+
++ (void)removeAllLoggers {
+    [self.sharedInstance removeAllLoggers];
+}
+
+- (void)removeAllLoggers {
+    DDLogOwnerTableRemoveLog(self);
+    dispatch_async(_loggingQueue, ^{ @autoreleasepool {
+        [self lt_removeAllLoggers];
+    } });
+}
+
++ (NSArray<id<DDLogger>> *)allLoggers {
+    return [self.sharedInstance allLoggers];
+}
+
+- (NSArray<id<DDLogger>> *)allLoggers {
+    __block NSArray *theLoggers;
+
+    dispatch_sync(_loggingQueue, ^{ @autoreleasepool {
+        theLoggers = [self lt_allLoggers];
+    } });
+
+    return theLoggers;
+}
+
++ (NSArray<DDLoggerInformation *> *)allLoggersWithLevel {
+    return [self.sharedInstance allLoggersWithLevel];
+}
+
+- (NSArray<DDLoggerInformation *> *)allLoggersWithLevel {
+    __block NSArray *theLoggersWithLevel;
+
+    dispatch_sync(_loggingQueue, ^{ @autoreleasepool {
+        theLoggersWithLevel = [self lt_allLoggersWithLevel];
+    } });
+
+    return theLoggersWithLevel;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark - Master Logging
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)queueLogMessage:(DDLogMessage *)logMessage asynchronously:(BOOL)asyncFlag {
+    // We have a tricky situation here...
+    //
+    // In the common case, when the queueSize is below the maximumQueueSize,
+    // we want to simply enqueue the logMessage. And we want to do this as fast as possible,
+    // which means we don't want to block and we don't want to use any locks.
+    //
+    // However, if the queueSize gets too big, we want to block.
+    // But we have very strict requirements as to when we block, and how long we block.
+    //
+    // The following example should help illustrate our requirements:
+    //
+    // Imagine that the maximum queue size is configured to be 5,
+    // and that there are already 5 log messages queued.
+    // Let us call these 5 queued log messages A, B, C, D, and E. (A is next to be executed)
+    //
+    // Now if our thread issues a log statement (let us call the log message F),
+    // it should block before the message is added to the queue.
+    // Furthermore, it should be unblocked immediately after A has been unqueued.
+    //
+    // The requirements are strict in this manner so that we block only as long as necessary,
+    // and so that blocked threads are unblocked in the order in which they were blocked.
+    //
+    // Returning to our previous example, let us assume that log messages A through E are still queued.
+    // Our aforementioned thread is blocked attempting to queue log message F.
+    // Now assume we have another separate thread that attempts to issue log message G.
+    // It should block until log messages A and B have been unqueued.
+    //
+    // Instead of blocking, the overflowPolicy may also drop messages (but never synchronous ones).
+
+    if (![self reserveQueueSlotForLogMessage:logMessage asynchronously:asyncFlag]) {
+        DDLogMessageReleaseDelivery(logMessage);
+        return;
+    }
+
+    if (atomic_load_explicit(&_collectsStatistics, memory_order_relaxed)) {
+        __auto_type stripe = &_statisticsStripes[DDLogStatisticsCurrentStripe()];
+        atomic_fetch_add_explicit(&stripe->enqueuedCounts[DDLogStatisticsFlagIndex(logMessage->_flag)], 1, memory_order_relaxed);
+        DDLogAtomicMaximum(&_maximumQueueDepth, atomic_load_explicit(&_queueSize, memory_order_relaxed));
+    }
+
+    // Only our own logging queue may run the log block inline, the one of another instance must dispatch to ours.
+    __auto_type onLoggingQueue = dispatch_get_specific(LoggingQueueOwnerKey) == (__bridge void *)self;
+
+    // When there are durable loggers, a synchronous message only waits for them.
+    // The group is entered until the durable loggers got their block, each of them then entering it until they're done.
+    dispatch_group_t durableGroup = nil;
+    if (!asyncFlag && !onLoggingQueue && atomic_load_explicit(&_durableLoggerCount, memory_order_relaxed) > 0) {
+        durableGroup = dispatch_group_create();
+        dispatch_group_enter(durableGroup);
+    }
+
+    __auto_type logBlock = ^{
+        // We're now sure we won't overflow the queue.
+        // It is time to queue our log message.
+        @autoreleasepool {
+            [self lt_processLogMessage:logMessage asynchronously:asyncFlag durableGroup:durableGroup];
+        }
+    };
+
+    if ((logMessage->_flag & (DDLogFlag)atomic_load_explicit(&_priorityFlags, memory_order_relaxed)) != 0
+        && !onLoggingQueue
+        && [self enqueueLogBlockInPriorityLane:logBlock asynchronously:(asyncFlag || durableGroup != nil)]) {
+        if (durableGroup) {
+            dispatch_group_wait(durableGroup, DISPATCH_TIME_FOREVER);
+        }
+        return;
+    }
+
+    if (asyncFlag) {
+        switch ((DDLogIngressMode)atomic_load_explicit(&_ingressMode, memory_order_relaxed)) {
+            case DDLogIngressModeDispatch:
+                break;
+            case DDLogIngressModeRingBuffer:
+                if ([self enqueueLogMessageInRing:logMessage]) {
+                    return;
+                }
+                break;
+            case DDLogIngressModeShardedRingBuffer:
+                if ([self enqueueLogMessageInShard:logMessage]) {
+                    return;
+                }
+                break;
+        }
+        dispatch_async(_loggingQueue, logBlock);
+    } else if (onLoggingQueue) {
+        // We've logged an error message while on the logging queue...
+        logBlock();
+    } else if (durableGroup) {
+        dispatch_async(_loggingQueue, logBlock);
+        dispatch_group_wait(durableGroup, DISPATCH_TIME_FOREVER);
+    } else {
+        dispatch_sync(_loggingQueue, logBlock);
+    }
+}
+
+- (BOOL)reserveQueueSlotForLogMessage:(DDLogMessage *)logMessage asynchronously:(BOOL)asyncFlag {
+    __auto_type maximumQueueSize = (NSUInteger)atomic_load_explicit(&_maximumQueueSize, memory_order_relaxed);
+    if (maximumQueueSize == 0) {
+        atomic_fetch_add_explicit(&_queueSize, 1, memory_order_relaxed);
+        return YES;
+    }
+
+    // Fast path: there's room, and nobody is waiting in line for it.
+    if (atomic_load(&_blockedThreadCount) == 0) {
+        __auto_type queueSize = (NSUInteger)atomic_load_explicit(&_queueSize, memory_order_relaxed);
+        while (queueSize < maximumQueueSize) {
+            if (atomic_compare_exchange_weak_explicit(&_queueSize, &queueSize, queueSize + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                return YES;
+            }
+        }
+    }
+
+    // The queue is full.
+    __auto_type policy = (DDLogOverflowPolicy)atomic_load_explicit(&_overflowPolicy, memory_order_relaxed);
+
+    if (asyncFlag) {
+        switch (policy) {
+            case DDLogOverflowPolicyDropNewest:
+                [self didDropLogMessages:1];
+                return NO;
+
+            case DDLogOverflowPolicyDropOldest:
+                // We can't take messages out of the logging queue, so we leave a note for the logging queue instead.
+                // It then skips as many asynchronous messages as we evicted.
+                // The queue can still grow to twice its size this way, after that we drop the new message.
+                if (atomic_fetch_add_explicit(&_queueSize, 1, memory_order_relaxed) < maximumQueueSize * 2) {
+                    atomic_fetch_add_explicit(&_evictionDebt, 1, memory_order_relaxed);
+                    return YES;
+                }
+                atomic_fetch_sub_explicit(&_queueSize, 1, memory_order_relaxed);
+                [self didDropLogMessages:1];
+                return NO;
+
+            case DDLogOverflowPolicyDropBelowFlag:
+                if (logMessage->_flag > (DDLogFlag)atomic_load_explicit(&_overflowThresholdFlag, memory_order_relaxed)) {
+                    [self didDropLogMessages:1];
+                    return NO;
+                }
+                break;
+
+            case DDLogOverflowPolicyBlock:
+                break;
+        }
+    }
+
+    // Never block the logging queue or a logger, they are the ones making room.
+    // Synchronous messages are never dropped, and only block with the policies that block anyway.
+    if (DDLogDeliveryDepth > 0
+        || dispatch_get_specific(GlobalLoggingQueueIdentityKey)
+        || (!asyncFlag && policy != DDLogOverflowPolicyBlock && policy != DDLogOverflowPolicyDropBelowFlag)) {
+        atomic_fetch_add_explicit(&_queueSize, 1, memory_order_relaxed);
+        return YES;
+    }
+
+    pthread_mutex_lock(&_queueSizeMutex);
+
+    __auto_type ticket = _nextTicket++;
+    atomic_fetch_add(&_blockedThreadCount, 1);
+
+    for (;;) {
+        if (ticket == _servedTicket) {
+            maximumQueueSize = (NSUInteger)atomic_load(&_maximumQueueSize);
+            __auto_type queueSize = (NSUInteger)atomic_load(&_queueSize);
+            __auto_type reserved = NO;
+
+            while (!reserved && (maximumQueueSize == 0 || queueSize < maximumQueueSize)) {
+                reserved = atomic_compare_exchange_weak(&_queueSize, &queueSize, queueSize + 1);
+            }
+
+            if (reserved) {
+                break;
+            }
+        }
+
+        pthread_cond_wait(&_queueSizeCondition, &_queueSizeMutex);
+    }
+
+    // Let the next one in line check.
+    _servedTicket++;
+    atomic_fetch_sub(&_blockedThreadCount, 1);
+    pthread_cond_broadcast(&_queueSizeCondition);
+
+    pthread_mutex_unlock(&_queueSizeMutex);
+
+    return YES;
+}
+
+- (DDLogMessage *)dequeueRecycledLogMessage {
+    __auto_type messagePool = atomic_load_explicit(&_messagePool, memory_order_acquire);
+    __auto_type item = messagePool ? DDLogRingTryDequeue(messagePool) : NULL;
+    if (item) {
+        return CFBridgingRelease(item);
+    }
+    return [[DDLogMessage alloc] init];
+}
+
+- (void)recycleLogMessage:(DDLogMessage *)logMessage {
+    __auto_type messagePool = atomic_load_explicit(&_messagePool, memory_order_acquire);
+    if (!atomic_load_explicit(&_recyclesLogMessages, memory_order_relaxed) || messagePool == NULL) {
+        return;
+    }
+
+    [logMessage prepareForReuse];
+
+    // If the pool is full, the message is simply deallocated.
+    __auto_type item = (void *)CFBridgingRetain(logMessage);
+    if (!DDLogRingTryEnqueue(messagePool, item)) {
+        CFRelease(item);
+    }
+}
+
+- (void)didDropLogMessages:(NSUInteger)count {
+    atomic_fetch_add_explicit(&_droppedMessageCount, count, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_unreportedDroppedMessageCount, count, memory_order_relaxed);
+}
+
+// Called on the logging thread, before the log message is created.
+// Returns NO if the log message is sampled out.
+- (BOOL)sampleLogMessageWithFlag:(DDLogFlag)flag context:(NSInteger)context file:(const char *)file line:(NSUInteger)line {
+    __auto_type policy = [self samplingPolicyForContext:context flag:flag];
+    if (policy == nil || [policy sampleLogMessageWithFile:file line:line]) {
+        return YES;
+    }
+
+    atomic_fetch_add_explicit(&_sampledOutMessageCount, 1, memory_order_relaxed);
+    return NO;
+}
+
+// Called on the logging thread, before the log message is queued.
+// Returns YES if the log message is a duplicate to count instead of logging it.
+- (BOOL)suppressLogMessageWithMode:(DDLogSuppressionMode)mode
+                             level:(DDLogLevel)level
+                              flag:(DDLogFlag)flag
+                           context:(NSInteger)context
+                              file:(NSString *)file
+                          function:(NSString *)function
+                              line:(NSUInteger)line
+                           message:(NSString *)message {
+    __auto_type table = atomic_load_explicit(&_suppressionTable, memory_order_acquire);
+    if (table == NULL) {
+        return NO;
+    }
+    if (mode != DDLogSuppressionModeMessage) {
+        message = nil;
+    }
+
+    __auto_type index = DDLogSuppressionSlotIndex(mode, context, file, line, message);
+    __auto_type slot = &table->slots[index];
+    __auto_type window = atomic_load_explicit(&_suppressionWindow, memory_order_relaxed);
+    __auto_type now = DDLogMonotonicNanoseconds();
+
+    DDLogMessage *summary = nil;
+    uint64_t windowStart = 0;
+    BOOL suppressed = NO;
+    BOOL firstSuppressed = NO;
+
+    pthread_mutex_lock(&slot->mutex);
+    if (now - slot->windowStart < window && DDLogSuppressionSlotMatches(slot, flag, context, file, line, message)) {
+        suppressed = YES;
+        firstSuppressed = slot->suppressedCount++ == 0;
+        windowStart = slot->windowStart;
+    } else {
+        // Whatever the slot suppressed so far is summarized before this message.
+        summary = DDLogSuppressionSlotTakeSummary(slot);
+        DDLogSuppressionSlotReset(slot, now, level, flag, context, file, function, line, message);
+    }
+    pthread_mutex_unlock(&slot->mutex);
+
+    if (summary) {
+        [self queueLogMessage:summary asynchronously:YES];
+    }
+
+    if (suppressed) {
+        atomic_fetch_add_explicit(&_suppressedMessageCount, 1, memory_order_relaxed);
+
+        if (firstSuppressed) {
+            // Unless a new window started in the slot by then, the summary is logged when the window closes.
+            __weak __auto_type weakSelf = self;
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(windowStart + window - now)),
+                           dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+                [weakSelf logSuppressionSummaryAtIndex:index windowStart:windowStart];
+            });
+        }
+    }
+
+    return suppressed;
+}
+
+- (void)logSuppressionSummaryAtIndex:(NSUInteger)index windowStart:(uint64_t)windowStart {
+    __auto_type slot = &atomic_load_explicit(&_suppressionTable, memory_order_acquire)->slots[index];
+
+    pthread_mutex_lock(&slot->mutex);
+    __auto_type summary = slot->windowStart == windowStart ? DDLogSuppressionSlotTakeSummary(slot) : nil;
+    pthread_mutex_unlock(&slot->mutex);
+
+    if (summary) {
+        [self queueLogMessage:summary asynchronously:YES];
+    }
+}
+
+// Logs the summaries of the windows which are still open.
+- (void)logSuppressionSummaries {
+    __auto_type table = atomic_load_explicit(&_suppressionTable, memory_order_acquire);
+    if (table == NULL) {
+        return;
+    }
+
+    for (NSUInteger i = 0; i < kDDLogSuppressionSlotCount; i++) {
+        __auto_type slot = &table->slots[i];
+
+        pthread_mutex_lock(&slot->mutex);
+        __auto_type summary = DDLogSuppressionSlotTakeSummary(slot);
+        pthread_mutex_unlock(&slot->mutex);
+
+        if (summary) {
+            [self queueLogMessage:summary asynchronously:YES];
+        }
+    }
+}
+
+- (BOOL)enqueueLogMessageInRing:(DDLogMessage *)logMessage {
+    // Ordering:
+    //
+    // As long as the ring isn't empty, there's a drain either scheduled or running on the logging queue,
+    // and the drain doesn't return before pendingCount dropped to zero, unless it scheduled itself again (lt_scheduleRedrain:).
+    //
+    // That alone isn't enough: another thread may have moved pendingCount from 0 to 1 without having scheduled the drain yet.
+    // So whatever else a thread dispatches to the logging queue later on (other asynchronous messages when the ring is full,
+    // synchronous messages, flushes) first drains every slot reserved so far (lt_drainIngress),
+    // and everything the thread pushed into the ring is processed before.
+
+    __auto_type ring = atomic_load_explicit(&_ring, memory_order_acquire);
+    __auto_type item = (void *)CFBridgingRetain(logMessage);
+
+    if (!DDLogRingTryEnqueue(ring, item)) {
+        CFRelease(item);
+        return NO;
+    }
 
-    return theLoggers;
-}
+    if (atomic_fetch_add_explicit(&ring->pendingCount, 1, memory_order_release) == 0) {
+        // The ring went from empty to non-empty, wake up the drain.
+        // The drain keeps us alive until it's done.
+        dispatch_async_f(_loggingQueue, (void *)CFBridgingRetain(self), DDLogDrainRing);
+    }
 
-+ (NSArray<DDLoggerInformation *> *)allLoggersWithLevel {
-    return [self.sharedInstance allLoggersWithLevel];
+    return YES;
 }
 
-- (NSArray<DDLoggerInformation *> *)allLoggersWithLevel {
-    __block NSArray *theLoggersWithLevel;
+// Returns NO if the priority lane is full. Otherwise, a synchronous log block has run once this returns.
+- (BOOL)enqueueLogBlockInPriorityLane:(dispatch_block_t)logBlock asynchronously:(BOOL)asyncFlag {
+    // Same ordering as enqueueLogMessageInRing:, the drain doesn't return before the pendingCount of the lane dropped to zero.
+    // On top of that, every block run by the logging queue drains the lane before doing its own work.
 
-    dispatch_sync(_loggingQueue, ^{ @autoreleasepool {
-        theLoggersWithLevel = [self lt_allLoggersWithLevel];
-    } });
+    __auto_type priorityLane = atomic_load_explicit(&_priorityLane, memory_order_acquire);
+    if (priorityLane == NULL) {
+        return NO;
+    }
 
-    return theLoggersWithLevel;
+    dispatch_semaphore_t done = asyncFlag ? nil : dispatch_semaphore_create(0);
+    dispatch_block_t block = asyncFlag ? logBlock : ^{
+        logBlock();
+        dispatch_semaphore_signal(done);
+    };
+    __auto_type item = (void *)CFBridgingRetain(block);
+
+    if (!DDLogRingTryEnqueue(priorityLane, item)) {
+        CFRelease(item);
+        return NO;
+    }
+
+    if (atomic_fetch_add_explicit(&priorityLane->pendingCount, 1, memory_order_release) == 0) {
+        // The lane went from empty to non-empty, wake up the drain.
+        // The drain keeps us alive until it's done.
+        dispatch_async_f(_loggingQueue, (void *)CFBridgingRetain(self), DDLogDrainPriorityLane);
+    }
+
+    if (done) {
+        dispatch_semaphore_wait(done, DISPATCH_TIME_FOREVER);
+    }
+
+    return YES;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark - Master Logging
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+- (BOOL)enqueueLogMessageInShard:(DDLogMessage *)logMessage {
+    // Same ordering as enqueueLogMessageInRing:, as the drain doesn't return before the pendingCount of every shard dropped to zero.
 
-- (void)queueLogMessage:(DDLogMessage *)logMessage asynchronously:(BOOL)asyncFlag {
-    // We have a tricky situation here...
-    //
-    // In the common case, when the queueSize is below the maximumQueueSize,
-    // we want to simply enqueue the logMessage. And we want to do this as fast as possible,
-    // which means we don't want to block and we don't want to use any locks.
-    //
-    // However, if the queueSize gets too big, we want to block.
-    // But we have very strict requirements as to when we block, and how long we block.
-    //
-    // The following example should help illustrate our requirements:
-    //
-    // Imagine that the maximum queue size is configured to be 5,
-    // and that there are already 5 log messages queued.
-    // Let us call these 5 queued log messages A, B, C, D, and E. (A is next to be executed)
-    //
-    // Now if our thread issues a log statement (let us call the log message F),
-    // it should block before the message is added to the queue.
-    // Furthermore, it should be unblocked immediately after A has been unqueued.
-    //
-    // The requirements are strict in this manner so that we block only as long as necessary,
-    // and so that blocked threads are unblocked in the order in which they were blocked.
-    //
-    // Returning to our previous example, let us assume that log messages A through E are still queued.
-    // Our aforementioned thread is blocked attempting to queue log message F.
-    // Now assume we have another separate thread that attempts to issue log message G.
-    // It should block until log messages A and B have been unqueued.
+    __auto_type shards = atomic_load_explicit(&_shards, memory_order_acquire);
+    __auto_type ring = shards->rings[DDLogCurrentThreadIndex() & shards->mask];
+    __auto_type item = (void *)CFBridgingRetain(logMessage);
 
-    __auto_type logBlock = ^{
-        // We're now sure we won't overflow the queue.
-        // It is time to queue our log message.
-        @autoreleasepool {
-            [self lt_log:logMessage];
-        }
-    };
+    if (!DDLogRingTryEnqueue(ring, item)) {
+        CFRelease(item);
+        return NO;
+    }
 
-    if (asyncFlag) {
-        dispatch_async(_loggingQueue, logBlock);
-    } else if (dispatch_get_specific(GlobalLoggingQueueIdentityKey)) {
-        // We've logged an error message while on the logging queue...
-        logBlock();
-    } else {
-        dispatch_sync(_loggingQueue, logBlock);
+    if (atomic_fetch_add_explicit(&ring->pendingCount, 1, memory_order_release) == 0) {
+        // The shard went from empty to non-empty, wake up the drain.
+        // The drain keeps us alive until it's done.
+        dispatch_async_f(_loggingQueue, (void *)CFBridgingRetain(self), DDLogDrainShards);
     }
+
+    return YES;
 }
 
 + (void)log:(BOOL)asynchronous
@@ -421,25 +2756,142 @@ static NSUInteger _numProcessors;
         tag:(id)tag
      format:(NSString *)format
        args:(va_list)args {
+    [self log:asynchronous level:level flag:flag context:context file:file function:function line:line callsite:NULL tag:tag format:format args:args];
+}
+
++ (void)log:(BOOL)asynchronous
+      level:(DDLogLevel)level
+       flag:(DDLogFlag)flag
+    context:(NSInteger)context
+   callsite:(DDLogCallsite *)callsite
+        tag:(id)tag
+     format:(NSString *)format, ... {
+    va_list args;
+
+    if (format) {
+        va_start(args, format);
+
+        [self.sharedInstance log:asynchronous level:level flag:flag context:context callsite:callsite tag:tag format:format args:args];
+
+        va_end(args);
+    }
+}
+
+- (void)log:(BOOL)asynchronous
+      level:(DDLogLevel)level
+       flag:(DDLogFlag)flag
+    context:(NSInteger)context
+   callsite:(DDLogCallsite *)callsite
+        tag:(id)tag
+     format:(NSString *)format, ... {
+    va_list args;
+
     if (format) {
-        // Null checks are handled by -initWithMessage:
+        va_start(args, format);
+
+        [self log:asynchronous level:level flag:flag context:context callsite:callsite tag:tag format:format args:args];
+
+        va_end(args);
+    }
+}
+
+- (void)log:(BOOL)asynchronous
+      level:(DDLogLevel)level
+       flag:(DDLogFlag)flag
+    context:(NSInteger)context
+   callsite:(DDLogCallsite *)callsite
+        tag:(id)tag
+     format:(NSString *)format
+       args:(va_list)args {
+    [self log:asynchronous level:level flag:flag context:context file:callsite->file function:callsite->function line:callsite->line callsite:callsite tag:tag format:format args:args];
+}
+
+- (void)log:(BOOL)asynchronous
+      level:(DDLogLevel)level
+       flag:(DDLogFlag)flag
+    context:(NSInteger)context
+       file:(const char *)file
+   function:(const char *)function
+       line:(NSUInteger)line
+   callsite:(DDLogCallsite *)callsite
+        tag:(id)tag
+     format:(NSString *)format
+       args:(va_list)args {
+    // Don't bother formatting a message none of the loggers would log.
+    if (!format || !(flag & (DDLogFlag)atomic_load_explicit(&_aggregateLevel, memory_order_relaxed))) {
+        return;
+    }
+
+    if (atomic_load_explicit(&_hasSamplingRules, memory_order_acquire)
+        && ![self sampleLogMessageWithFlag:flag context:context file:file line:line]) {
+        return;
+    }
+
+    __auto_type suppressionMode = (DDLogSuppressionMode)atomic_load_explicit(&_suppressionMode, memory_order_acquire);
+
+    // Without a callsite, the file and function are usually literals anyway, so we box them once per thread.
+    NSString *fileString = nil;
+    NSString *functionString = nil;
+    if (callsite == NULL) {
+        __auto_type threadCache = DDLogGetThreadCache();
+        fileString = threadCache ? DDLogInternCString(threadCache->files, kDDLogInternedStringCount, file) : @(file);
+        functionString = threadCache ? DDLogInternCString(threadCache->functions, kDDLogInternedStringCount, function) : @(function);
+    } else if (suppressionMode != DDLogSuppressionModeNone) {
+        DDLogCallsitePrepare(callsite);
+        fileString = (__bridge NSString *)__atomic_load_n(&callsite->_file, __ATOMIC_ACQUIRE);
+        functionString = (__bridge NSString *)__atomic_load_n(&callsite->_function, __ATOMIC_ACQUIRE);
+    }
+
+    // Duplicates of the same callsite don't even need to be formatted.
+    if (suppressionMode == DDLogSuppressionModeCallsite
+        && [self suppressLogMessageWithMode:suppressionMode level:level flag:flag context:context file:fileString function:functionString line:line message:nil]) {
+        return;
+    }
+
+    // Duplicates by message are found by comparing the formatted messages, so they can't be deferred.
+    NSString *messageFormat = [format copy];
+    __auto_type arguments = atomic_load_explicit(&_defersMessageFormatting, memory_order_relaxed)
+                            && suppressionMode != DDLogSuppressionModeMessage
+                          ? DDLogArgumentsCreate(messageFormat, args)
+                          : NULL;
+    // A deferred message is rendered by the logging queue, the format stands in for it until then.
+    NSString *message = arguments ? messageFormat : [[NSString alloc] initWithFormat:messageFormat arguments:args];
+
+    if (suppressionMode == DDLogSuppressionModeMessage
+        && [self suppressLogMessageWithMode:suppressionMode level:level flag:flag context:context file:fileString function:functionString line:line message:message]) {
+        if (arguments) {
+            DDLogArgumentsFree(arguments);
+        }
+        return;
+    }
+
+    __auto_type recycles = (BOOL)atomic_load_explicit(&_recyclesLogMessages, memory_order_relaxed);
+    __auto_type logMessage = recycles ? [self dequeueRecycledLogMessage] : [[DDLogMessage alloc] init];
+
+    // Null checks are handled by -setUpWithFormat:
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wnullable-to-nonnull-conversion"
-        __auto_type logMessage = [[DDLogMessage alloc] initWithFormat:format
-                                                                 args:args
-                                                                level:level
-                                                                 flag:flag
-                                                              context:context
-                                                                 file:@(file)
-                                                             function:@(function)
-                                                                 line:line
-                                                                  tag:tag
-                                                              options:(DDLogMessageOptions)0
-                                                            timestamp:nil];
+    [logMessage setUpWithFormat:messageFormat
+                      formatted:message
+                          level:level
+                           flag:flag
+                        context:context
+                           file:fileString
+                       function:functionString
+                           line:line
+                            tag:tag
+                        options:DDLogMessageDontCopyMessage // we already did the copying.
+                      timestamp:nil
+                       callsite:callsite];
 #pragma clang diagnostic pop
+    logMessage->_arguments = arguments;
 
-        [self queueLogMessage:logMessage asynchronously:asynchronous];
+    if (recycles) {
+        logMessage->_recyclingLog = self;
+        atomic_store_explicit(&logMessage->_deliveryCount, 1, memory_order_relaxed);
     }
+
+    [self queueLogMessage:logMessage asynchronously:asynchronous];
 }
 
 + (void)log:(BOOL)asynchronous message:(DDLogMessage *)logMessage {
@@ -447,6 +2899,28 @@ static NSUInteger _numProcessors;
 }
 
 - (void)log:(BOOL)asynchronous message:(DDLogMessage *)logMessage {
+    if (!(logMessage->_flag & (DDLogFlag)atomic_load_explicit(&_aggregateLevel, memory_order_relaxed))) {
+        return;
+    }
+
+    if (atomic_load_explicit(&_hasSamplingRules, memory_order_acquire)
+        && ![self sampleLogMessageWithFlag:logMessage->_flag context:logMessage->_context file:logMessage->_file.UTF8String line:logMessage->_line]) {
+        return;
+    }
+
+    __auto_type suppressionMode = (DDLogSuppressionMode)atomic_load_explicit(&_suppressionMode, memory_order_acquire);
+    if (suppressionMode != DDLogSuppressionModeNone
+        && [self suppressLogMessageWithMode:suppressionMode
+                                      level:logMessage->_level
+                                       flag:logMessage->_flag
+                                    context:logMessage->_context
+                                       file:logMessage->_file
+                                   function:logMessage->_function
+                                       line:logMessage->_line
+                                    message:logMessage->_message]) {
+        return;
+    }
+
     [self queueLogMessage:logMessage asynchronously:asynchronous];
 }
 
@@ -456,6 +2930,7 @@ static NSUInteger _numProcessors;
 
 - (void)flushLog {
     DDLogAssertNotOnGlobalLoggingQueue();
+    [self logSuppressionSummaries];
     dispatch_sync(_loggingQueue, ^{
         @autoreleasepool {
             [self lt_flush];
@@ -463,9 +2938,334 @@ static NSUInteger _numProcessors;
     });
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-#pragma mark Registered Dynamic Logging
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+NS_INLINE dispatch_time_t DDLogDeadline(NSTimeInterval timeout) {
+    if (!(timeout < (NSTimeInterval)INT64_MAX / NSEC_PER_SEC)) {
+        return DISPATCH_TIME_FOREVER;
+    }
+    return dispatch_time(DISPATCH_TIME_NOW, (int64_t)(MAX(timeout, 0) * NSEC_PER_SEC));
+}
+
++ (NSArray<id<DDLogger>> *)flushLogWithTimeout:(NSTimeInterval)timeout {
+    return [self.sharedInstance flushLogWithTimeout:timeout];
+}
+
+- (NSArray<id<DDLogger>> *)flushLogWithTimeout:(NSTimeInterval)timeout {
+    return [self flushLogWithTimeout:timeout discardingFlags:0];
+}
+
+- (NSArray<id<DDLogger>> *)flushLogWithTimeout:(NSTimeInterval)timeout discardingFlags:(DDLogFlag)discardedFlags {
+    DDLogAssertNotOnGlobalLoggingQueue();
+
+    __auto_type flush = [self startFlushDiscardingFlags:discardedFlags];
+    dispatch_group_wait(flush.group, DDLogDeadline(timeout));
+    return [self finishFlush:flush] ?: @[];
+}
+
++ (void)flushLogWithCompletion:(dispatch_block_t)completion {
+    [self.sharedInstance flushLogWithCompletion:completion];
+}
+
+- (void)flushLogWithCompletion:(dispatch_block_t)completion {
+    [self flushLogWithTimeout:INFINITY discardingFlags:0 completion:^(NSArray<id<DDLogger>> * __unused unflushedLoggers) {
+        completion();
+    }];
+}
+
+- (void)flushLogWithTimeout:(NSTimeInterval)timeout
+            discardingFlags:(DDLogFlag)discardedFlags
+                 completion:(void (^)(NSArray<id<DDLogger>> *unflushedLoggers))completion {
+    __auto_type flush = [self startFlushDiscardingFlags:discardedFlags];
+    __auto_type completionQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+
+    // Whichever comes first: all loggers flushed, or the deadline.
+    __auto_type finishBlock = ^{
+        __auto_type unflushedLoggers = [self finishFlush:flush];
+        if (unflushedLoggers) {
+            completion(unflushedLoggers);
+        }
+    };
+
+    dispatch_group_notify(flush.group, completionQueue, finishBlock);
+
+    // The group releases the finish block once it ran, so that the flush (and the completion) doesn't outlive it
+    // until the deadline.
+    __auto_type deadline = DDLogDeadline(timeout);
+    if (deadline != DISPATCH_TIME_FOREVER) {
+        __weak dispatch_block_t weakFinishBlock = finishBlock;
+        dispatch_after(deadline, completionQueue, ^{
+            dispatch_block_t block = weakFinishBlock;
+            if (block) {
+                block();
+            }
+        });
+    }
+}
+
+- (DDLogFlush *)startFlushDiscardingFlags:(DDLogFlag)discardedFlags {
+    [self logSuppressionSummaries];
+
+    __auto_type flush = [[DDLogFlush alloc] initWithLoggers:self.loggersSnapshot discardedFlags:discardedFlags];
+    [self updateDiscardingFlush:flush discarding:YES];
+
+    // Unlike flushLog, the logging queue doesn't wait for the loggers, it only adds them to the group of the flush.
+    __auto_type group = flush.group;
+    dispatch_group_enter(group);
+    dispatch_async(_loggingQueue, ^{ @autoreleasepool {
+        [flush lt_didReachLoggingQueue];
+        [self lt_flushInGroup:group flush:flush];
+        dispatch_group_leave(group);
+    } });
+
+    return flush;
+}
+
+// Returns nil if the flush was already finished.
+- (NSArray<id<DDLogger>> *)finishFlush:(DDLogFlush *)flush {
+    __auto_type unflushedLoggers = [flush finish];
+    if (unflushedLoggers) {
+        [self updateDiscardingFlush:flush discarding:NO];
+    }
+    return unflushedLoggers;
+}
+
+// A flag stays discarded until the last flush shedding it is finished.
+- (void)updateDiscardingFlush:(DDLogFlush *)flush discarding:(BOOL)discarding {
+    if (flush.discardedFlags == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&_discardedFlagsMutex);
+    if (discarding) {
+        [_discardingFlushes addObject:flush];
+    } else {
+        [_discardingFlushes removeObjectIdenticalTo:flush];
+    }
+
+    // Each flag is discarded for the messages created before the latest flush shedding it.
+    unsigned long discardedFlags = 0;
+    uint64_t deadlines[sizeof(_discardedFlagDeadlines) / sizeof(_discardedFlagDeadlines[0])] = { 0 };
+    for (DDLogFlush *discardingFlush in _discardingFlushes) {
+        discardedFlags |= discardingFlush.discardedFlags;
+        for (NSUInteger bit = 0; bit < sizeof(deadlines) / sizeof(deadlines[0]); bit++) {
+            if ((discardingFlush.discardedFlags & (1ul << bit)) != 0) {
+                deadlines[bit] = MAX(deadlines[bit], discardingFlush.startNanoseconds);
+            }
+        }
+    }
+
+    // The deadlines are set before the flags are, and cleared after.
+    if (discarding) {
+        for (NSUInteger bit = 0; bit < sizeof(deadlines) / sizeof(deadlines[0]); bit++) {
+            atomic_store_explicit(&_discardedFlagDeadlines[bit], deadlines[bit], memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&_discardedFlags, discardedFlags, memory_order_release);
+    if (!discarding) {
+        for (NSUInteger bit = 0; bit < sizeof(deadlines) / sizeof(deadlines[0]); bit++) {
+            atomic_store_explicit(&_discardedFlagDeadlines[bit], deadlines[bit], memory_order_relaxed);
+        }
+    }
+    pthread_mutex_unlock(&_discardedFlagsMutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Registered Dynamic Logging
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The index of the classes implementing DDRegisteredDynamicLogging.
+// It's built on first use by probing every class, then kept up to date as images get loaded.
+// Classes created at runtime aren't part of any image, they're picked up by a rescan once the number of classes grew.
+// Classes are never deallocated, so neither the set nor the array retain anything.
+static pthread_mutex_t DDLogRegistryMutex = PTHREAD_MUTEX_INITIALIZER;
+static CFMutableSetRef DDLogRegisteredClassSet;
+static CFMutableSetRef DDLogUnregisteredClassSet; // The classes looked up and found not registered, until an image gets loaded.
+static NSUInteger DDLogRegistryImageGeneration; // Counts the images loaded, to tell whether a class was probed before one of them.
+static CFMutableArrayRef DDLogRegistryPendingImages; // The mach headers of the images loaded since the last lookup.
+static int DDLogRegistryScannedClassCount; // The number of classes of the runtime when all of them were last scanned.
+static atomic_bool DDLogRegistryIgnoresImages;
+
+// Only the classes flagged as registered are added.
+static void DDLogRegistryAddClasses(__unsafe_unretained Class *classes, const bool *registered, NSUInteger count) {
+    pthread_mutex_lock(&DDLogRegistryMutex);
+    for (NSUInteger i = 0; i < count; i++) {
+        if (registered[i]) {
+            CFSetAddValue(DDLogRegisteredClassSet, (__bridge const void *)classes[i]);
+        }
+    }
+    pthread_mutex_unlock(&DDLogRegistryMutex);
+}
+
+// The classes are probed serially, on the calling thread: +isRegisteredClass: only looks the methods up
+// on the metaclass, without messaging the class, so that no +initialize runs on behalf of the scan.
+// The mutex isn't held while probing, since method resolution may run arbitrary code.
+static void DDLogRegistryScanClasses(__unsafe_unretained Class *classes, NSUInteger count) {
+    if (count == 0) {
+        return;
+    }
+    bool *registered = calloc(count, sizeof(bool));
+    if (registered == NULL) {
+        return;
+    }
+
+    for (NSUInteger i = 0; i < count; i++) {
+        registered[i] = [DDLog isRegisteredClass:classes[i]];
+    }
+
+    DDLogRegistryAddClasses(classes, registered, count);
+    free(registered);
+}
+
+// Scans all the classes of the runtime, if there are more than at the last scan.
+// Classes are never removed, so the count only grows when classes are created at runtime (or images are loaded).
+static void DDLogRegistryScanAllClassesIfNeeded(void) {
+    __auto_type classCount = objc_getClassList(NULL, 0);
+    pthread_mutex_lock(&DDLogRegistryMutex);
+    __auto_type needsScan = classCount > DDLogRegistryScannedClassCount;
+    pthread_mutex_unlock(&DDLogRegistryMutex);
+    if (!needsScan) {
+        return;
+    }
+
+    unsigned int count = 0;
+    __auto_type classes = objc_copyClassList(&count);
+    if (classes == NULL) {
+        return;
+    }
+
+    // Only the classes the index doesn't know about yet are probed.
+    __unsafe_unretained Class *unknownClasses = (__unsafe_unretained Class *)calloc(MAX(count, 1), sizeof(Class));
+    NSUInteger unknownCount = 0;
+    if (unknownClasses) {
+        pthread_mutex_lock(&DDLogRegistryMutex);
+        for (unsigned int i = 0; i < count; i++) {
+            __auto_type value = (__bridge const void *)classes[i];
+            if (!CFSetContainsValue(DDLogRegisteredClassSet, value) && !CFSetContainsValue(DDLogUnregisteredClassSet, value)) {
+                unknownClasses[unknownCount++] = classes[i];
+            }
+        }
+        pthread_mutex_unlock(&DDLogRegistryMutex);
+
+        DDLogRegistryScanClasses(unknownClasses, unknownCount);
+        free(unknownClasses);
+    }
+    free(classes);
+
+    pthread_mutex_lock(&DDLogRegistryMutex);
+    DDLogRegistryScannedClassCount = MAX(DDLogRegistryScannedClassCount, (int)count);
+    pthread_mutex_unlock(&DDLogRegistryMutex);
+}
+
+#if DD_HAS_DYLD
+static void DDLogRegistryAddImage(const struct mach_header *header, intptr_t __unused slide) {
+    if (atomic_load_explicit(&DDLogRegistryIgnoresImages, memory_order_relaxed)) {
+        return;
+    }
+    // Calling into the Objective-C runtime from a dyld callback could deadlock, the image is scanned on the next lookup.
+    // Its categories may register classes which were looked up before, so these are looked up again.
+    pthread_mutex_lock(&DDLogRegistryMutex);
+    CFArrayAppendValue(DDLogRegistryPendingImages, header);
+    CFSetRemoveAllValues(DDLogUnregisteredClassSet);
+    DDLogRegistryImageGeneration++;
+    pthread_mutex_unlock(&DDLogRegistryMutex);
+}
+
+static void DDLogRegistryScanPendingImages(void) {
+    pthread_mutex_lock(&DDLogRegistryMutex);
+    __auto_type imageCount = CFArrayGetCount(DDLogRegistryPendingImages);
+    CFArrayRef images = imageCount > 0 ? CFArrayCreateCopy(kCFAllocatorDefault, DDLogRegistryPendingImages) : NULL;
+    CFArrayRemoveAllValues(DDLogRegistryPendingImages);
+    pthread_mutex_unlock(&DDLogRegistryMutex);
+
+    if (images == NULL) {
+        return;
+    }
+
+    for (CFIndex i = 0; i < imageCount; i++) {
+        Dl_info info;
+        if (dladdr(CFArrayGetValueAtIndex(images, i), &info) == 0 || info.dli_fname == NULL) {
+            continue;
+        }
+
+        unsigned int nameCount = 0;
+        __auto_type names = objc_copyClassNamesForImage(info.dli_fname, &nameCount);
+        if (names == NULL) {
+            continue;
+        }
+        __unsafe_unretained Class *classes = (__unsafe_unretained Class *)calloc(nameCount, sizeof(Class));
+        NSUInteger classCount = 0;
+        if (classes) {
+            for (unsigned int j = 0; j < nameCount; j++) {
+                Class class = objc_getClass(names[j]);
+                if (class) {
+                    classes[classCount++] = class;
+                }
+            }
+            DDLogRegistryScanClasses(classes, classCount);
+            free(classes);
+        }
+        free(names);
+    }
+    CFRelease(images);
+}
+#endif /* DD_HAS_DYLD */
+
+static void DDLogRegistryPrepare(void) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        DDLogRegisteredClassSet = CFSetCreateMutable(kCFAllocatorDefault, 0, NULL);
+        DDLogUnregisteredClassSet = CFSetCreateMutable(kCFAllocatorDefault, 0, NULL);
+        DDLogRegistryPendingImages = CFArrayCreateMutable(kCFAllocatorDefault, 0, NULL);
+
+#if DD_HAS_DYLD
+        // The images already loaded are reported right away, they're covered by the scan below.
+        atomic_store_explicit(&DDLogRegistryIgnoresImages, true, memory_order_relaxed);
+        _dyld_register_func_for_add_image(DDLogRegistryAddImage);
+        atomic_store_explicit(&DDLogRegistryIgnoresImages, false, memory_order_relaxed);
+#endif
+
+        unsigned int count = 0;
+        __auto_type classes = objc_copyClassList(&count);
+        if (classes) {
+            DDLogRegistryScanClasses((__unsafe_unretained Class *)classes, count);
+            free(classes);
+            pthread_mutex_lock(&DDLogRegistryMutex);
+            DDLogRegistryScannedClassCount = (int)count;
+            pthread_mutex_unlock(&DDLogRegistryMutex);
+        }
+    });
+
+#if DD_HAS_DYLD
+    DDLogRegistryScanPendingImages();
+#endif
+}
+
+// Classes created at runtime aren't part of any image, they're probed (and indexed) when looked up.
+// Classes which aren't registered are remembered too, so that looking them up again doesn't probe them again.
+static BOOL DDLogRegistryContainsClass(Class class) {
+    if (class == nil) {
+        return NO;
+    }
+    DDLogRegistryPrepare();
+
+    pthread_mutex_lock(&DDLogRegistryMutex);
+    __auto_type contained = CFSetContainsValue(DDLogRegisteredClassSet, (__bridge const void *)class);
+    __auto_type known = contained || CFSetContainsValue(DDLogUnregisteredClassSet, (__bridge const void *)class);
+    __auto_type imageGeneration = DDLogRegistryImageGeneration;
+    pthread_mutex_unlock(&DDLogRegistryMutex);
+    if (known) {
+        return contained;
+    }
+
+    __auto_type registered = [DDLog isRegisteredClass:class];
+    pthread_mutex_lock(&DDLogRegistryMutex);
+    if (registered) {
+        CFSetAddValue(DDLogRegisteredClassSet, (__bridge const void *)class);
+    } else if (imageGeneration == DDLogRegistryImageGeneration) {
+        CFSetAddValue(DDLogUnregisteredClassSet, (__bridge const void *)class);
+    }
+    pthread_mutex_unlock(&DDLogRegistryMutex);
+    return registered;
+}
 
 + (BOOL)isRegisteredClass:(Class)class {
     __auto_type getterSel = @selector(ddLogLevel);
@@ -527,49 +3327,24 @@ static NSUInteger _numProcessors;
 }
 
 + (NSArray *)registeredClasses {
-    // We're going to get the list of all registered classes.
-    // The Objective-C runtime library automatically registers all the classes defined in your source code.
-    //
-    // To do this we use the following method (documented in the Objective-C Runtime Reference):
-    //
-    // int objc_getClassList(Class *buffer, int bufferLen)
-    //
-    // We can pass (NULL, 0) to obtain the total number of
-    // registered class definitions without actually retrieving any class definitions.
-    // This allows us to allocate the minimum amount of memory needed for the application.
-
-    NSUInteger numClasses = 0;
-    Class *classes = NULL;
-
-    while (numClasses == 0) {
-        numClasses = (NSUInteger)MAX(objc_getClassList(NULL, 0), 0);
-
-        // numClasses now tells us how many classes we have (but it might change)
-        // So we can allocate our buffer, and get pointers to all the class definitions.
-        __auto_type bufferSize = numClasses;
-        classes = numClasses ? (Class *)calloc(bufferSize, sizeof(Class)) : NULL;
-        if (classes == NULL) {
-            return @[]; // no memory or classes?
-        }
-
-        numClasses = (NSUInteger)MAX(objc_getClassList(classes, (int)bufferSize),0);
-        if (numClasses > bufferSize || numClasses == 0) {
-            // apparently more classes added between calls (or a problem); try again
-            free(classes);
-            classes = NULL;
-            numClasses = 0;
-        }
+    DDLogRegistryPrepare();
+    DDLogRegistryScanAllClassesIfNeeded();
+
+    pthread_mutex_lock(&DDLogRegistryMutex);
+    __auto_type count = CFSetGetCount(DDLogRegisteredClassSet);
+    __auto_type classes = (const void **)calloc((size_t)MAX(count, 1), sizeof(void *));
+    if (classes == NULL) {
+        pthread_mutex_unlock(&DDLogRegistryMutex);
+        return @[];
     }
+    CFSetGetValues(DDLogRegisteredClassSet, classes);
+    pthread_mutex_unlock(&DDLogRegistryMutex);
 
-    // We can now loop through the classes, and test each one to see if it is a DDLogging class.
-    __auto_type result = [NSMutableArray arrayWithCapacity:numClasses];
-    for (NSUInteger i = 0; i < numClasses; i++) {
+    __auto_type result = [NSMutableArray arrayWithCapacity:(NSUInteger)count];
+    for (CFIndex i = 0; i < count; i++) {
         // Cannot use `__auto_type` here, since this will lead to crashes when deallocating!
-        Class class = classes[i];
-
-        if ([self isRegisteredClass:class]) {
-            [result addObject:class];
-        }
+        Class class = (__bridge Class)classes[i];
+        [result addObject:class];
     }
 
     free(classes);
@@ -588,7 +3363,7 @@ static NSUInteger _numProcessors;
 }
 
 + (DDLogLevel)levelForClass:(Class)aClass {
-    if ([self isRegisteredClass:aClass]) {
+    if (DDLogRegistryContainsClass(aClass)) {
         return [aClass ddLogLevel];
     }
     return (DDLogLevel)-1;
@@ -597,11 +3372,15 @@ static NSUInteger _numProcessors;
 + (DDLogLevel)levelForClassWithName:(NSString *)aClassName {
     Class clazz = NSClassFromString(aClassName);
     if (clazz == nil) return (DDLogLevel)-1;
+    if (!DDLogRegistryContainsClass(clazz)) {
+        // The class may have been created at runtime since the last scan, index any such class.
+        DDLogRegistryScanAllClassesIfNeeded();
+    }
     return [self levelForClass:clazz];
 }
 
 + (void)setLevel:(DDLogLevel)level forClass:(Class)aClass {
-    if ([self isRegisteredClass:aClass]) {
+    if (DDLogRegistryContainsClass(aClass)) {
         [aClass ddSetLogLevel:level];
     }
 }
@@ -612,16 +3391,47 @@ static NSUInteger _numProcessors;
     [self setLevel:level forClass:clazz];
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Named Log Levels
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
++ (void)setLevel:(DDLogLevel)level forName:(NSString *)name {
+    pthread_mutex_lock(&DDLogNameTableMutex);
+    DDLogNameTablePrepare();
+    DDLogNameLevels[[name copy]] = @(level);
+    DDLogNameTableUpdateLevels();
+    pthread_mutex_unlock(&DDLogNameTableMutex);
+}
+
++ (void)removeLevelForName:(NSString *)name {
+    pthread_mutex_lock(&DDLogNameTableMutex);
+    DDLogNameTablePrepare();
+    [DDLogNameLevels removeObjectForKey:name];
+    DDLogNameTableUpdateLevels();
+    pthread_mutex_unlock(&DDLogNameTableMutex);
+}
+
++ (DDLogLevel)levelForName:(NSString *)name {
+    pthread_mutex_lock(&DDLogNameTableMutex);
+    DDLogNameTablePrepare();
+    __auto_type level = DDLogNameEffectiveLevel(name);
+    pthread_mutex_unlock(&DDLogNameTableMutex);
+    return level;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark Logging Thread
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-- (void)lt_addLogger:(id <DDLogger>)logger level:(DDLogLevel)level {
+- (void)lt_addLogger:(id <DDLogger>)logger
+               level:(DDLogLevel)level
+               route:(DDLogRoutePredicate)route
+        tagPredicate:(DDLogTagPredicate)tagPredicate {
     // Add to loggers array.
     // Need to create loggerQueue if loggerNode doesn't provide one.
 
     for (DDLoggerNode *node in self._loggers) {
-        if (node->_logger == logger && node->_level == level) {
+        if (node->_logger == logger && node->_level == level && node->_route == route && node->_tagPredicate == tagPredicate) {
             // Exactly same logger already added, exit
             return;
         }
@@ -629,10 +3439,20 @@ static NSUInteger _numProcessors;
 
     DDLogAssertOnGlobalLoggingQueue();
 
+    __auto_type usesWorkerPool = atomic_load_explicit(&_schedulerMode, memory_order_relaxed) == DDLogSchedulerModeWorkerPool;
+    __auto_type retargetedLoggerQueue = NO;
+
     dispatch_queue_t loggerQueue = NULL;
     if ([logger respondsToSelector:@selector(loggerQueue)]) {
         // Logger may be providing its own queue
         loggerQueue = logger.loggerQueue;
+
+        // Only the internal queue of DDAbstractLogger (marked with the logger as key) is known to be safe to retarget.
+        // Queues of other loggers may already be targeted by other queues, which can't be retargeted.
+        if (usesWorkerPool && loggerQueue && dispatch_queue_get_specific(loggerQueue, (__bridge void *)logger) != NULL) {
+            dispatch_set_target_queue(loggerQueue, _workerQueue);
+            retargetedLoggerQueue = YES;
+        }
     }
 
     if (loggerQueue == nil) {
@@ -644,11 +3464,19 @@ static NSUInteger _numProcessors;
             loggerQueueName = logger.loggerName.UTF8String;
         }
 
-        loggerQueue = dispatch_queue_create(loggerQueueName, NULL);
+        loggerQueue = dispatch_queue_create_with_target(loggerQueueName, NULL, usesWorkerPool ? _workerQueue : NULL);
     }
 
     __auto_type loggerNode = [DDLoggerNode nodeWithLogger:logger loggerQueue:loggerQueue level:level];
+    loggerNode->_retargetedLoggerQueue = retargetedLoggerQueue;
+    loggerNode->_durable = [logger respondsToSelector:@selector(isDurable)] && logger.isDurable;
+    loggerNode->_route = route;
+    loggerNode->_tagPredicate = tagPredicate;
     [self._loggers addObject:loggerNode];
+    self.loggersSnapshot = [self lt_allLoggers];
+    self.loggerNodesSnapshot = self._loggers;
+    [self lt_updateDurableLoggerCount];
+    [self lt_updateRouteTable];
 
     if ([logger respondsToSelector:@selector(didAddLoggerInQueue:)]) {
         dispatch_async(loggerNode->_loggerQueue, ^{ @autoreleasepool {
@@ -686,9 +3514,15 @@ static NSUInteger _numProcessors;
             [logger willRemoveLogger];
         } });
     }
+    [self lt_restoreLoggerQueueOfNode:loggerNode];
 
     // Remove from loggers array
     [self._loggers removeObject:loggerNode];
+    self.loggersSnapshot = [self lt_allLoggers];
+    self.loggerNodesSnapshot = self._loggers;
+    [self lt_updateDurableLoggerCount];
+    [self lt_updateRouteTable];
+    [self lt_updateAggregateLevelAfterAddition:NO];
 }
 
 - (void)lt_removeAllLoggers {
@@ -701,10 +3535,113 @@ static NSUInteger _numProcessors;
                 [loggerNode->_logger willRemoveLogger];
             } });
         }
+        [self lt_restoreLoggerQueueOfNode:loggerNode];
     }
 
     // Remove all loggers from array
     [self._loggers removeAllObjects];
+    self.loggersSnapshot = @[];
+    self.loggerNodesSnapshot = @[];
+    [self lt_updateDurableLoggerCount];
+    [self lt_updateRouteTable];
+    [self lt_updateAggregateLevelAfterAddition:NO];
+}
+
+- (void)lt_updateDurableLoggerCount {
+    DDLogAssertOnGlobalLoggingQueue();
+
+    NSUInteger durableLoggerCount = 0;
+    for (DDLoggerNode *loggerNode in self._loggers) {
+        if (loggerNode->_durable) {
+            durableLoggerCount++;
+        }
+    }
+    atomic_store_explicit(&_durableLoggerCount, durableLoggerCount, memory_order_relaxed);
+}
+
+- (void)lt_updateRouteTable {
+    DDLogAssertOnGlobalLoggingQueue();
+
+    // The routes are compiled again as log messages come in.
+    DDLogRouteTableClear(&_routeTable);
+
+    _hasTagPredicates = NO;
+    for (DDLoggerNode *loggerNode in self._loggers) {
+        if (loggerNode->_tagPredicate) {
+            _hasTagPredicates = YES;
+            break;
+        }
+    }
+}
+
+// Returns the logger nodes the context and flag are routed to, in the order of the loggers.
+- (NSArray<DDLoggerNode *> *)lt_routeForContext:(NSInteger)context flag:(DDLogFlag)flag {
+    __auto_type nodes = DDLogRouteTableLookup(&_routeTable, context, flag);
+    if (nodes) {
+        return (__bridge NSArray<DDLoggerNode *> *)nodes;
+    }
+
+    __auto_type routedNodes = [NSMutableArray<DDLoggerNode *> arrayWithCapacity:self._loggers.count];
+    for (DDLoggerNode *loggerNode in self._loggers) {
+        if ((flag & (DDLogFlag)loggerNode->_level) && (!loggerNode->_route || loggerNode->_route(context, flag))) {
+            [routedNodes addObject:loggerNode];
+        }
+    }
+
+    NSArray<DDLoggerNode *> *route = [routedNodes copy];
+    DDLogRouteTableAdd(&_routeTable, context, flag, (__bridge CFArrayRef)route);
+    return route;
+}
+
+// Returns the logger nodes the log message is routed to, leaving out the ones whose tag predicate rejects it.
+- (NSArray<DDLoggerNode *> *)lt_destinationsOfLogMessage:(DDLogMessage *)logMessage {
+    __auto_type nodes = [self lt_routeForContext:logMessage->_context flag:logMessage->_flag];
+    if (!_hasTagPredicates) {
+        return nodes;
+    }
+
+    NSMutableArray<DDLoggerNode *> *destinations = nil;
+    for (NSUInteger i = 0; i < nodes.count; i++) {
+        __auto_type loggerNode = nodes[i];
+        __auto_type accepted = !loggerNode->_tagPredicate || loggerNode->_tagPredicate(logMessage->_representedObject);
+        if (!accepted && !destinations) {
+            destinations = [[nodes subarrayWithRange:NSMakeRange(0, i)] mutableCopy];
+        } else if (accepted && destinations) {
+            [destinations addObject:loggerNode];
+        }
+    }
+    return destinations ?: nodes;
+}
+
+- (void)lt_restoreLoggerQueueOfNode:(DDLoggerNode *)loggerNode {
+    if (!loggerNode->_retargetedLoggerQueue) {
+        return;
+    }
+
+    // The blocks already submitted to the queue still run on the worker pool.
+    // Passing NULL restores the default target of a serial queue.
+    dispatch_set_target_queue(loggerNode->_loggerQueue, NULL);
+}
+
+- (void)lt_updateAggregateLevelAfterAddition:(BOOL)addition {
+    DDLogAssertOnGlobalLoggingQueue();
+
+    __auto_type level = (NSUInteger)0;
+    for (DDLoggerNode *loggerNode in self._loggers) {
+        level |= loggerNode->_level;
+    }
+
+    pthread_mutex_lock(&_aggregateLevelMutex);
+    if (addition) {
+        _pendingLoggerAdditionCount--;
+    }
+    if (_pendingLoggerAdditionCount > 0) {
+        // The pending loggers aren't part of the loggers array yet.
+        atomic_fetch_or_explicit(&_aggregateLevel, (unsigned long)level, memory_order_relaxed);
+    } else {
+        atomic_store_explicit(&_aggregateLevel, (unsigned long)level, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&_aggregateLevelMutex);
 }
 
 - (NSArray *)lt_allLoggers {
@@ -735,12 +3672,150 @@ static NSUInteger _numProcessors;
     return [theLoggersWithLevel copy];
 }
 
-- (void)lt_log:(DDLogMessage *)logMessage {
+- (void)lt_processLogMessage:(DDLogMessage *)logMessage asynchronously:(BOOL)asyncFlag durableGroup:(dispatch_group_t)durableGroup {
+    DDLogAssertOnGlobalLoggingQueue();
+
+    // A log message taking the priority lane doesn't wait for the messages pushed into the ring before it.
+    [self lt_drainPriorityLane];
+    if (!_drainingPriorityLane) {
+        [self lt_drainIngress];
+    }
+
+    if ([self lt_unqueueLogMessage:logMessage asynchronously:asyncFlag]) {
+        [self lt_countDeliveredLogMessage:logMessage];
+        [self lt_log:logMessage waitForLoggers:!asyncFlag durableGroup:durableGroup];
+    } else if (durableGroup) {
+        dispatch_group_leave(durableGroup);
+    }
+    DDLogMessageReleaseDelivery(logMessage);
+
+    [self lt_logDroppedMessagesIfNeeded];
+}
+
+// Returns NO if the message was evicted by DDLogOverflowPolicyDropOldest, or shed by a flush, and must not be logged.
+- (BOOL)lt_unqueueLogMessage:(DDLogMessage *)logMessage asynchronously:(BOOL)asyncFlag {
+    DDLogAssertOnGlobalLoggingQueue();
+
+    // The message is now unqueued, so unblock the next waiting thread (if any).
+    atomic_fetch_sub(&_queueSize, 1);
+    if (atomic_load(&_blockedThreadCount) > 0) {
+        pthread_mutex_lock(&_queueSizeMutex);
+        pthread_cond_broadcast(&_queueSizeCondition);
+        pthread_mutex_unlock(&_queueSizeMutex);
+    }
+
+    // Pay back evicted messages (DDLogOverflowPolicyDropOldest), this one being the oldest one.
+    __auto_type evictionDebt = (NSUInteger)atomic_load_explicit(&_evictionDebt, memory_order_relaxed);
+    __auto_type evicted = NO;
+    while (asyncFlag && !evicted && evictionDebt > 0) {
+        evicted = atomic_compare_exchange_weak_explicit(&_evictionDebt, &evictionDebt, evictionDebt - 1,
+                                                        memory_order_relaxed, memory_order_relaxed);
+    }
+
+    // Flushes with a deadline may shed the messages they don't care about, logged before they started.
+    __auto_type discarded = asyncFlag && !evicted && [self lt_isDiscardedLogMessage:logMessage];
+
+    if (evicted) {
+        [self didDropLogMessages:1];
+    } else if (discarded) {
+        atomic_fetch_add_explicit(&_discardedMessageCount, 1, memory_order_relaxed);
+    }
+
+    return !evicted && !discarded;
+}
+
+- (BOOL)lt_isDiscardedLogMessage:(DDLogMessage *)logMessage {
+    __auto_type flags = (unsigned long)logMessage->_flag & atomic_load_explicit(&_discardedFlags, memory_order_acquire);
+    while (flags != 0) {
+        __auto_type bit = (NSUInteger)__builtin_ctzl(flags);
+        if (logMessage->_monotonicTimestampNanoseconds < atomic_load_explicit(&_discardedFlagDeadlines[bit], memory_order_relaxed)) {
+            return YES;
+        }
+        flags &= flags - 1;
+    }
+    return NO;
+}
+
+- (void)lt_countDeliveredLogMessage:(DDLogMessage *)logMessage {
+    DDLogAssertOnGlobalLoggingQueue();
+
+    if (atomic_load_explicit(&_collectsStatistics, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&_deliveredCounts[DDLogStatisticsFlagIndex(logMessage->_flag)], 1, memory_order_relaxed);
+    }
+}
+
+- (void)lt_logDroppedMessagesIfNeeded {
+    DDLogAssertOnGlobalLoggingQueue();
+
+    // Once the pressure is gone, tell how many messages went missing.
+    if (atomic_load_explicit(&_unreportedDroppedMessageCount, memory_order_relaxed) > 0
+        && atomic_load_explicit(&_queueSize, memory_order_relaxed) <= atomic_load_explicit(&_maximumQueueSize, memory_order_relaxed) / 2) {
+        __auto_type droppedCount = (NSUInteger)atomic_exchange_explicit(&_unreportedDroppedMessageCount, 0, memory_order_relaxed);
+        if (droppedCount > 0) {
+            __auto_type message = [NSString stringWithFormat:@"%lu log messages dropped because the logging queue was full",
+                                   (unsigned long)droppedCount];
+            [self lt_log:[[DDLogMessage alloc] initWithMessage:message
+                                                         level:DDLogLevelAll
+                                                          flag:DDLogFlagWarning
+                                                       context:0
+                                                          file:@(__FILE__)
+                                                      function:@(__PRETTY_FUNCTION__)
+                                                          line:__LINE__
+                                                           tag:nil
+                                                       options:(DDLogMessageOptions)0
+                                                     timestamp:nil]
+                  waitForLoggers:NO];
+        }
+    }
+}
+
+- (void)lt_log:(DDLogMessage *)logMessage waitForLoggers:(BOOL)waitForLoggers {
+    [self lt_log:logMessage waitForLoggers:waitForLoggers durableGroup:nil];
+}
+
+// The durable group is entered by the caller, and left once the durable loggers got their block.
+- (void)lt_log:(DDLogMessage *)logMessage waitForLoggers:(BOOL)waitForLoggers durableGroup:(dispatch_group_t)durableGroup {
     DDLogAssertOnGlobalLoggingQueue();
 
-    // Execute the given log message on each of our loggers.
+    // Execute the given log message on each of the loggers it is routed to.
+    // The loggers that shouldn't write this message based on the log level and their route are already left out.
+
+    __auto_type destinations = [self lt_destinationsOfLogMessage:logMessage];
+    __auto_type collectsStatistics = (BOOL)atomic_load_explicit(&_collectsStatistics, memory_order_relaxed);
+    __auto_type windowSize = (NSUInteger)atomic_load_explicit(&_maximumPendingMessagesPerLogger, memory_order_relaxed);
+    if (windowSize > 0) {
+        // Each logger runs independently, within its own queue.
+        // Its window keeps it from piling up a large queue of pending log messages,
+        // so we only have to wait for the loggers of synchronous log messages.
+
+        for (DDLoggerNode *loggerNode in destinations) {
+            DDLogMessagePrepareForLoggers(logMessage);
+
+            DDLogMessageRetainDelivery(logMessage);
+            __auto_type durable = durableGroup != nil && loggerNode->_durable;
+            if (durable) {
+                dispatch_group_enter(durableGroup);
+            }
+            [loggerNode lt_dispatchWithWindowSize:windowSize
+                                            group:waitForLoggers ? _loggingGroup : nil
+                                            block:^{ @autoreleasepool {
+                DDLogDeliveryDepth++;
+                [loggerNode lt_logMessage:logMessage collectingStatistics:collectsStatistics];
+                DDLogDeliveryDepth--;
+                if (durable) {
+                    dispatch_group_leave(durableGroup);
+                }
+                DDLogMessageReleaseDelivery(logMessage);
+            } }];
+        }
 
-    if (_numProcessors > 1) {
+        if (durableGroup) {
+            dispatch_group_leave(durableGroup);
+        }
+        if (waitForLoggers) {
+            dispatch_group_wait(_loggingGroup, DISPATCH_TIME_FOREVER);
+        }
+    } else if (_numProcessors > 1) {
         // Execute each logger concurrently, each within its own queue.
         // All blocks are added to same group.
         // After each block has been queued, wait on group.
@@ -748,69 +3823,433 @@ static NSUInteger _numProcessors;
         // The waiting ensures that a slow logger doesn't end up with a large queue of pending log messages.
         // This would defeat the purpose of the efforts we made earlier to restrict the max queue size.
 
-        for (DDLoggerNode *loggerNode in self._loggers) {
-            // skip the loggers that shouldn't write this message based on the log level
+        for (DDLoggerNode *loggerNode in destinations) {
+            DDLogMessagePrepareForLoggers(logMessage);
 
-            if (!(logMessage->_flag & (DDLogFlag)(loggerNode->_level))) {
-                continue;
+            DDLogMessageRetainDelivery(logMessage);
+            __auto_type durable = durableGroup != nil && loggerNode->_durable;
+            if (durable) {
+                dispatch_group_enter(durableGroup);
             }
-
             dispatch_group_async(_loggingGroup, loggerNode->_loggerQueue, ^{ @autoreleasepool {
-                [loggerNode->_logger logMessage:logMessage];
+                DDLogDeliveryDepth++;
+                [loggerNode lt_logMessage:logMessage collectingStatistics:collectsStatistics];
+                DDLogDeliveryDepth--;
+                if (durable) {
+                    dispatch_group_leave(durableGroup);
+                }
+                DDLogMessageReleaseDelivery(logMessage);
+            } });
+        }
+
+        // The caller of a synchronous message may go on once the durable loggers are done, we still wait for all of them.
+        if (durableGroup) {
+            dispatch_group_leave(durableGroup);
+        }
+        dispatch_group_wait(_loggingGroup, DISPATCH_TIME_FOREVER);
+    } else {
+        // Execute each logger serially, each within its own queue.
+
+        for (DDLoggerNode *loggerNode in destinations) {
+            DDLogMessagePrepareForLoggers(logMessage);
+
+#if DD_DEBUG
+            // we must assure that we aren not on loggerNode->_loggerQueue.
+            if (loggerNode->_loggerQueue == NULL) {
+              // tell that we can't dispatch logger node on queue that is NULL.
+              NSLogDebug(@"DDLog: current node has loggerQueue == NULL");
+            }
+            else {
+              dispatch_async(loggerNode->_loggerQueue, ^{
+                if (dispatch_get_specific(GlobalLoggingQueueIdentityKey)) {
+                  // tell that we somehow on logging queue?
+                  NSLogDebug(@"DDLog: current node has loggerQueue == globalLoggingQueue");
+                }
+              });
+            }
+#endif
+            // next, we must check that node is OK.
+            dispatch_sync(loggerNode->_loggerQueue, ^{ @autoreleasepool {
+                DDLogDeliveryDepth++;
+                [loggerNode lt_logMessage:logMessage collectingStatistics:collectsStatistics];
+                DDLogDeliveryDepth--;
             } });
         }
 
-        dispatch_group_wait(_loggingGroup, DISPATCH_TIME_FOREVER);
-    } else {
-        // Execute each logger serially, each within its own queue.
+        // Every logger is done already.
+        if (durableGroup) {
+            dispatch_group_leave(durableGroup);
+        }
+    }
+}
+
+- (void)lt_logBatch:(NSArray<DDLogMessage *> *)logMessages {
+    DDLogAssertOnGlobalLoggingQueue();
+
+    // Same as lt_log:, but every logger gets all the messages of the batch within a single block.
+
+    if (logMessages.count <= 1) {
+        if (logMessages.count == 1) {
+            [self lt_log:logMessages[0] waitForLoggers:NO];
+        }
+        return;
+    }
+
+    // Sort the messages of the batch by logger, keeping their order.
+    __auto_type messagesByNode = [NSMapTable<DDLoggerNode *, NSMutableArray<DDLogMessage *> *> strongToStrongObjectsMapTable];
+    for (DDLogMessage *logMessage in logMessages) {
+        for (DDLoggerNode *loggerNode in [self lt_destinationsOfLogMessage:logMessage]) {
+            __auto_type nodeMessages = [messagesByNode objectForKey:loggerNode];
+            if (!nodeMessages) {
+                nodeMessages = [NSMutableArray arrayWithCapacity:logMessages.count];
+                [messagesByNode setObject:nodeMessages forKey:loggerNode];
+            }
+            [nodeMessages addObject:logMessage];
+        }
+    }
+
+    __auto_type collectsStatistics = (BOOL)atomic_load_explicit(&_collectsStatistics, memory_order_relaxed);
+    __auto_type windowSize = (NSUInteger)atomic_load_explicit(&_maximumPendingMessagesPerLogger, memory_order_relaxed);
+    for (DDLoggerNode *loggerNode in self._loggers) {
+        NSArray<DDLogMessage *> *nodeMessages = [messagesByNode objectForKey:loggerNode];
+        if (nodeMessages.count == 0) {
+            continue;
+        }
+
+        for (DDLogMessage *logMessage in nodeMessages) {
+            DDLogMessagePrepareForLoggers(logMessage);
+            DDLogMessageRetainDelivery(logMessage);
+        }
+
+        __auto_type logBlock = ^{ @autoreleasepool {
+            DDLogDeliveryDepth++;
+            [loggerNode lt_logMessages:nodeMessages collectingStatistics:collectsStatistics];
+            DDLogDeliveryDepth--;
+            for (DDLogMessage *logMessage in nodeMessages) {
+                DDLogMessageReleaseDelivery(logMessage);
+            }
+        } };
+
+        if (windowSize > 0) {
+            // A batch only takes a single place in the window.
+            [loggerNode lt_dispatchWithWindowSize:windowSize group:nil block:logBlock];
+        } else if (_numProcessors > 1) {
+            dispatch_group_async(_loggingGroup, loggerNode->_loggerQueue, logBlock);
+        } else {
+            dispatch_sync(loggerNode->_loggerQueue, logBlock);
+        }
+    }
+
+    if (windowSize == 0 && _numProcessors > 1) {
+        dispatch_group_wait(_loggingGroup, DISPATCH_TIME_FOREVER);
+    }
+}
+
+- (void)lt_drainRing {
+    DDLogAssertOnGlobalLoggingQueue();
+
+    __auto_type ring = atomic_load_explicit(&_ring, memory_order_acquire);
+    void *batch[kDDLogRingBatchSize];
+
+    _drainingIngress = YES;
+    __auto_type stalled = NO;
+    __auto_type pendingCount = (intptr_t)atomic_load_explicit(&ring->pendingCount, memory_order_acquire);
+    while (pendingCount > 0 && !stalled) {
+        __auto_type batchCount = MIN((NSUInteger)pendingCount, kDDLogRingBatchSize);
+
+        NSUInteger count = 0;
+        while (count < batchCount && (batch[count] = DDLogRingDequeueIfPublished(ring)) != NULL) {
+            count++;
+        }
+        stalled = count < batchCount;
+
+        if (count > 0) {
+            [self lt_logItems:batch count:count];
+        }
+
+        // Only stop once the producers didn't push anything in the meantime.
+        // Otherwise, nobody would wake us up for those messages.
+        pendingCount = (intptr_t)atomic_fetch_sub_explicit(&ring->pendingCount, count, memory_order_acq_rel) - (intptr_t)count;
+    }
+    _drainingIngress = NO;
+
+    if (stalled && pendingCount > 0) {
+        [self lt_scheduleRedrain:kDDLogRedrainRing];
+    }
+}
+
+// Pops every slot reserved so far from the ring and the shards, before the logging queue does anything else.
+// Their producers may not have scheduled the drain yet, see enqueueLogMessageInRing:.
+- (void)lt_drainIngress {
+    DDLogAssertOnGlobalLoggingQueue();
+
+    // A drain logging the messages it popped already takes care of the slots reserved before them.
+    if (_drainingIngress) {
+        return;
+    }
+
+    __auto_type ring = atomic_load_explicit(&_ring, memory_order_acquire);
+    if (ring) {
+        _drainingIngress = YES;
+        void *batch[kDDLogRingBatchSize];
+        __auto_type reservedCount = DDLogRingReservedCount(ring);
+        while (reservedCount > 0) {
+            __auto_type batchCount = MIN(reservedCount, kDDLogRingBatchSize);
+
+            for (NSUInteger i = 0; i < batchCount; i++) {
+                batch[i] = DDLogRingDequeueReserved(ring);
+            }
+
+            [self lt_logItems:batch count:batchCount];
+
+            // May go below zero, until the producers of these messages increment it.
+            atomic_fetch_sub_explicit(&ring->pendingCount, batchCount, memory_order_acq_rel);
+            reservedCount -= batchCount;
+        }
+        _drainingIngress = NO;
+    }
+
+    if (atomic_load_explicit(&_shards, memory_order_acquire)) {
+        [self lt_drainShardsUpToReservedSlots:YES];
+    }
+}
+
+- (void)lt_drainShards {
+    [self lt_drainShardsUpToReservedSlots:NO];
+}
+
+// Drains the shards until their pendingCount dropped to zero,
+// or only the slots reserved when called (whether they're accounted for in pendingCount or not), see lt_drainIngress.
+- (void)lt_drainShardsUpToReservedSlots:(BOOL)upToReservedSlots {
+    DDLogAssertOnGlobalLoggingQueue();
+
+    __auto_type shards = atomic_load_explicit(&_shards, memory_order_acquire);
+    __auto_type shardCount = shards->mask + 1;
+    void *batches[kDDLogMaximumShardCount][kDDLogRingBatchSize];
+    NSUInteger batchCounts[kDDLogMaximumShardCount];
+    void *mergedBatch[kDDLogMaximumShardCount * kDDLogRingBatchSize];
+
+    NSUInteger reservedCounts[kDDLogMaximumShardCount] = { 0 };
+    if (upToReservedSlots) {
+        for (NSUInteger i = 0; i < shardCount; i++) {
+            reservedCounts[i] = DDLogRingReservedCount(shards->rings[i]);
+        }
+    }
+
+    _drainingIngress = YES;
+    __auto_type pending = YES;
+    __auto_type stalled = NO;
+    while (pending && !stalled) {
+        NSUInteger totalCount = 0;
+        for (NSUInteger i = 0; i < shardCount; i++) {
+            __auto_type ring = shards->rings[i];
+            __auto_type pendingCount = upToReservedSlots
+                ? (intptr_t)reservedCounts[i]
+                : (intptr_t)atomic_load_explicit(&ring->pendingCount, memory_order_acquire);
+            __auto_type batchCount = pendingCount > 0 ? MIN((NSUInteger)pendingCount, kDDLogRingBatchSize) : 0;
+            batchCounts[i] = 0;
+            while (batchCounts[i] < batchCount) {
+                __auto_type item = upToReservedSlots ? DDLogRingDequeueReserved(ring) : DDLogRingDequeueIfPublished(ring);
+                if (item == NULL) {
+                    stalled = YES;
+                    break;
+                }
+                batches[i][batchCounts[i]++] = item;
+            }
+            totalCount += batchCounts[i];
+        }
+
+        // Merge the batches, each of them being in order already.
+        NSUInteger heads[kDDLogMaximumShardCount] = { 0 };
+        for (NSUInteger n = 0; n < totalCount; n++) {
+            __auto_type earliestShard = (NSUInteger)NSNotFound;
+            __auto_type earliestTimestamp = UINT64_MAX;
+            for (NSUInteger i = 0; i < shardCount; i++) {
+                if (heads[i] == batchCounts[i]) {
+                    continue;
+                }
+                __auto_type timestamp = ((__bridge DDLogMessage *)batches[i][heads[i]])->_monotonicTimestampNanoseconds;
+                if (earliestShard == NSNotFound || timestamp < earliestTimestamp) {
+                    earliestShard = i;
+                    earliestTimestamp = timestamp;
+                }
+            }
+            mergedBatch[n] = batches[earliestShard][heads[earliestShard]++];
+        }
+
+        if (totalCount > 0) {
+            [self lt_logItems:mergedBatch count:totalCount];
+        }
+
+        // Only stop once the producers didn't push anything in the meantime, in any shard.
+        // Otherwise, nobody would wake us up for those messages.
+        pending = NO;
+        for (NSUInteger i = 0; i < shardCount; i++) {
+            __auto_type ring = shards->rings[i];
+            __auto_type pendingCount = batchCounts[i] > 0
+                ? (intptr_t)atomic_fetch_sub_explicit(&ring->pendingCount, batchCounts[i], memory_order_acq_rel) - (intptr_t)batchCounts[i]
+                : (intptr_t)atomic_load_explicit(&ring->pendingCount, memory_order_acquire);
+            if (upToReservedSlots) {
+                reservedCounts[i] -= batchCounts[i];
+                pendingCount = (intptr_t)reservedCounts[i];
+            }
+            pending = pending || pendingCount > 0;
+        }
+    }
+    _drainingIngress = NO;
+
+    if (stalled && pending) {
+        [self lt_scheduleRedrain:kDDLogRedrainShards];
+    }
+}
+
+// Runs the log blocks waiting in the priority lane, unless they're the ones calling us.
+- (void)lt_drainPriorityLane {
+    DDLogAssertOnGlobalLoggingQueue();
+
+    __auto_type priorityLane = atomic_load_explicit(&_priorityLane, memory_order_acquire);
+    if (priorityLane == NULL || _drainingPriorityLane) {
+        return;
+    }
+
+    _drainingPriorityLane = YES;
+    __auto_type pendingCount = (NSUInteger)atomic_load_explicit(&priorityLane->pendingCount, memory_order_acquire);
+    while (pendingCount > 0) {
+        __auto_type item = DDLogRingDequeueIfPublished(priorityLane);
+        if (item == NULL) {
+            [self lt_scheduleRedrain:kDDLogRedrainPriorityLane];
+            break;
+        }
+        dispatch_block_t block = CFBridgingRelease(item);
+        block();
+
+        // Only stop once the producers didn't push anything in the meantime.
+        // Otherwise, nobody would wake us up for those messages.
+        pendingCount = (NSUInteger)atomic_fetch_sub_explicit(&priorityLane->pendingCount, 1, memory_order_acq_rel) - 1;
+    }
+    _drainingPriorityLane = NO;
+}
+
+// Drains again a moment later, once a drain stopped at a slot which wasn't published yet.
+// The drains stopped in the meantime share the same schedule.
+- (void)lt_scheduleRedrain:(NSUInteger)redrain {
+    DDLogAssertOnGlobalLoggingQueue();
+
+    __auto_type scheduled = _scheduledRedrains != 0;
+    _scheduledRedrains |= redrain;
+    if (!scheduled) {
+        // The redrain keeps us alive until it's done.
+        dispatch_after_f(dispatch_time(DISPATCH_TIME_NOW, kDDLogRedrainDelay), _loggingQueue, (void *)CFBridgingRetain(self), DDLogRedrain);
+    }
+}
 
-        for (DDLoggerNode *loggerNode in self._loggers) {
-            // skip the loggers that shouldn't write this message based on the log level
+- (void)lt_redrain {
+    DDLogAssertOnGlobalLoggingQueue();
 
-            if (!(logMessage->_flag & (DDLogFlag)(loggerNode->_level))) {
-                continue;
-            }
+    __auto_type redrains = _scheduledRedrains;
+    _scheduledRedrains = 0;
+    if (redrains & kDDLogRedrainPriorityLane) {
+        [self lt_drainPriorityLane];
+    }
+    if (redrains & kDDLogRedrainRing) {
+        [self lt_drainRing];
+    }
+    if (redrains & kDDLogRedrainShards) {
+        [self lt_drainShards];
+    }
+}
 
-#if DD_DEBUG
-            // we must assure that we aren not on loggerNode->_loggerQueue.
-            if (loggerNode->_loggerQueue == NULL) {
-              // tell that we can't dispatch logger node on queue that is NULL.
-              NSLogDebug(@"DDLog: current node has loggerQueue == NULL");
-            }
-            else {
-              dispatch_async(loggerNode->_loggerQueue, ^{
-                if (dispatch_get_specific(GlobalLoggingQueueIdentityKey)) {
-                  // tell that we somehow on logging queue?
-                  NSLogDebug(@"DDLog: current node has loggerQueue == globalLoggingQueue");
-                }
-              });
+// Logs the messages popped from the ring or the shards, and balances their retain.
+// The priority lane goes first, so that it only waits for one batch of the ring, not for the whole ring.
+- (void)lt_logItems:(void **)items count:(NSUInteger)count {
+    [self lt_drainPriorityLane];
+
+    @autoreleasepool {
+        __auto_type logMessages = [NSMutableArray<DDLogMessage *> arrayWithCapacity:count];
+        for (NSUInteger i = 0; i < count; i++) {
+            DDLogMessage *logMessage = CFBridgingRelease(items[i]);
+            if ([self lt_unqueueLogMessage:logMessage asynchronously:YES]) {
+                [self lt_countDeliveredLogMessage:logMessage];
+                [logMessages addObject:logMessage];
+            } else {
+                DDLogMessageReleaseDelivery(logMessage);
             }
-#endif
-            // next, we must check that node is OK.
-            dispatch_sync(loggerNode->_loggerQueue, ^{ @autoreleasepool {
-                [loggerNode->_logger logMessage:logMessage];
-            } });
         }
+
+        [self lt_logBatch:logMessages];
+        for (DDLogMessage *logMessage in logMessages) {
+            DDLogMessageReleaseDelivery(logMessage);
+        }
+        [self lt_logDroppedMessagesIfNeeded];
     }
 }
 
 - (void)lt_flush {
+    DDLogAssertOnGlobalLoggingQueue();
+
+    [self lt_flushInGroup:_loggingGroup flush:nil];
+    dispatch_group_wait(_loggingGroup, DISPATCH_TIME_FOREVER);
+}
+
+// Adds the flush of each logger to the group, without waiting for them.
+- (void)lt_flushInGroup:(dispatch_group_t)group flush:(DDLogFlush *)flush {
     // All log statements issued before the flush method was invoked have now been executed.
     //
     // Now we need to propagate the flush request to any loggers that implement the flush method.
     // This is designed for loggers that buffer IO.
+    //
+    // With maximumPendingMessagesPerLogger, loggers may still have pending log messages, some of them parked.
+    // As the logger queues are serial, waiting for a block going through the window of each of them is enough.
 
     DDLogAssertOnGlobalLoggingQueue();
 
+    [self lt_drainIngress];
+
+    __auto_type collectsStatistics = (BOOL)atomic_load_explicit(&_collectsStatistics, memory_order_relaxed);
+    __auto_type windowSize = (NSUInteger)atomic_load_explicit(&_maximumPendingMessagesPerLogger, memory_order_relaxed);
     for (DDLoggerNode *loggerNode in self._loggers) {
-        if ([loggerNode->_logger respondsToSelector:@selector(flush)]) {
-            dispatch_group_async(_loggingGroup, loggerNode->_loggerQueue, ^{ @autoreleasepool {
-                [loggerNode->_logger flush];
-            } });
+        __auto_type flushes = [loggerNode->_logger respondsToSelector:@selector(flush)];
+        if (!flushes && windowSize == 0) {
+            continue;
+        }
+
+        [flush lt_willWaitForLogger:loggerNode->_logger];
+        __auto_type flushBlock = ^{ @autoreleasepool {
+            if (flushes) {
+                [loggerNode lt_flushCollectingStatistics:collectsStatistics];
+            }
+            [flush loggerDidFlush:loggerNode->_logger];
+        } };
+        if (windowSize > 0) {
+            [loggerNode lt_dispatchWithWindowSize:windowSize group:group block:flushBlock];
+        } else {
+            dispatch_group_async(group, loggerNode->_loggerQueue, flushBlock);
         }
     }
+}
 
-    dispatch_group_wait(_loggingGroup, DISPATCH_TIME_FOREVER);
+static void DDLogDrainRing(void *context) {
+    // Balances the retain taken when the drain was scheduled.
+    DDLog *log = CFBridgingRelease(context);
+    [log lt_drainRing];
+}
+
+static void DDLogDrainShards(void *context) {
+    // Balances the retain taken when the drain was scheduled.
+    DDLog *log = CFBridgingRelease(context);
+    [log lt_drainShards];
+}
+
+static void DDLogDrainPriorityLane(void *context) {
+    // Balances the retain taken when the drain was scheduled.
+    DDLog *log = CFBridgingRelease(context);
+    [log lt_drainPriorityLane];
+}
+
+static void DDLogRedrain(void *context) {
+    // Balances the retain taken when the redrain was scheduled.
+    DDLog *log = CFBridgingRelease(context);
+    [log lt_redrain];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -897,6 +4336,10 @@ NSString * __nullable DDExtractFileNameWithoutExtension(const char *filePath, BO
         }
 
         _level = level;
+        _implementsLogMessages = [logger respondsToSelector:@selector(logMessages:)];
+
+        pthread_mutex_init(&_windowMutex, NULL);
+        _parkedBlocks = [NSMutableArray new];
     }
     return self;
 }
@@ -905,7 +4348,119 @@ NSString * __nullable DDExtractFileNameWithoutExtension(const char *filePath, BO
     return [[self alloc] initWithLogger:logger loggerQueue:loggerQueue level:level];
 }
 
+- (void)lt_logMessage:(DDLogMessage *)logMessage collectingStatistics:(BOOL)collectsStatistics {
+    if (!collectsStatistics) {
+        [_logger logMessage:logMessage];
+        return;
+    }
+
+    __auto_type start = DDLogMonotonicNanoseconds();
+    [_logger logMessage:logMessage];
+    [self lt_countServiceTime:DDLogMonotonicNanoseconds() - start messageCount:1];
+}
+
+- (void)lt_logMessages:(NSArray<DDLogMessage *> *)logMessages collectingStatistics:(BOOL)collectsStatistics {
+    if (_implementsLogMessages && logMessages.count > 1) {
+        __auto_type start = collectsStatistics ? DDLogMonotonicNanoseconds() : 0;
+        [_logger logMessages:logMessages];
+        if (collectsStatistics) {
+            [self lt_countServiceTime:DDLogMonotonicNanoseconds() - start messageCount:logMessages.count];
+        }
+        return;
+    }
+
+    for (DDLogMessage *logMessage in logMessages) {
+        @autoreleasepool {
+            [self lt_logMessage:logMessage collectingStatistics:collectsStatistics];
+        }
+    }
+}
+
+// A batch counts as as many messages taking the same share of the time.
+- (void)lt_countServiceTime:(uint64_t)serviceTime messageCount:(NSUInteger)messageCount {
+    __auto_type messageServiceTime = serviceTime / messageCount;
+    atomic_fetch_add_explicit(&_serviceTimeHistogram[DDLogServiceTimeBucket(messageServiceTime)], messageCount, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_deliveredMessageCount, messageCount, memory_order_relaxed);
+    DDLogAtomicMaximum(&_maximumServiceTime, messageServiceTime);
+}
+
+- (void)lt_flushCollectingStatistics:(BOOL)collectsStatistics {
+    __auto_type start = collectsStatistics ? DDLogMonotonicNanoseconds() : 0;
+    [_logger flush];
+    if (collectsStatistics) {
+        __auto_type duration = DDLogMonotonicNanoseconds() - start;
+        atomic_fetch_add_explicit(&_flushCount, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&_totalFlushDuration, duration, memory_order_relaxed);
+        DDLogAtomicMaximum(&_maximumFlushDuration, duration);
+    }
+}
+
+- (DDLoggerStatistics *)statistics {
+    NSUInteger histogram[kDDLogServiceTimeBucketCount];
+    for (NSUInteger i = 0; i < kDDLogServiceTimeBucketCount; i++) {
+        histogram[i] = atomic_load_explicit(&_serviceTimeHistogram[i], memory_order_relaxed);
+    }
+    __auto_type maximumServiceTime = (uint64_t)atomic_load_explicit(&_maximumServiceTime, memory_order_relaxed);
+
+    __auto_type additionalStatistics = [_logger respondsToSelector:@selector(statistics)] ? [_logger statistics] : @{};
+
+    return [[DDLoggerStatistics alloc] initWithLogger:_logger
+                                deliveredMessageCount:atomic_load_explicit(&_deliveredMessageCount, memory_order_relaxed)
+                                    medianServiceTime:DDLogServiceTimePercentile(histogram, 0.5, maximumServiceTime)
+                     ninetyNinthPercentileServiceTime:DDLogServiceTimePercentile(histogram, 0.99, maximumServiceTime)
+                                   maximumServiceTime:(NSTimeInterval)maximumServiceTime / NSEC_PER_SEC
+                                           flushCount:atomic_load_explicit(&_flushCount, memory_order_relaxed)
+                                   totalFlushDuration:(NSTimeInterval)atomic_load_explicit(&_totalFlushDuration, memory_order_relaxed) / NSEC_PER_SEC
+                                 maximumFlushDuration:(NSTimeInterval)atomic_load_explicit(&_maximumFlushDuration, memory_order_relaxed) / NSEC_PER_SEC
+                                 additionalStatistics:additionalStatistics ?: @{}];
+}
+
+- (void)lt_dispatchWithWindowSize:(NSUInteger)windowSize group:(dispatch_group_t)group block:(dispatch_block_t)block {
+    // A parked block is only dispatched later on, so it enters the group right away.
+    if (group) {
+        dispatch_group_enter(group);
+    }
+    dispatch_block_t windowBlock = ^{
+        block();
+        if (group) {
+            dispatch_group_leave(group);
+        }
+        [self windowBlockDidFinish];
+    };
+
+    // Once blocks are parked, the window stays full until they're all dispatched, so the order is kept.
+    pthread_mutex_lock(&_windowMutex);
+    __auto_type fits = _inFlightCount < windowSize;
+    if (fits) {
+        _inFlightCount++;
+    } else {
+        [_parkedBlocks addObject:windowBlock];
+    }
+    pthread_mutex_unlock(&_windowMutex);
+
+    if (fits) {
+        dispatch_async(_loggerQueue, windowBlock);
+    }
+}
+
+// Called on the logger queue. The place of the finished block goes to the oldest parked block, if any.
+- (void)windowBlockDidFinish {
+    pthread_mutex_lock(&_windowMutex);
+    dispatch_block_t parkedBlock = _parkedBlocks.firstObject;
+    if (parkedBlock) {
+        [_parkedBlocks removeObjectAtIndex:0];
+    } else {
+        _inFlightCount--;
+    }
+    pthread_mutex_unlock(&_windowMutex);
+
+    if (parkedBlock) {
+        dispatch_async(_loggerQueue, parkedBlock);
+    }
+}
+
 - (void)dealloc {
+    pthread_mutex_destroy(&_windowMutex);
 #if !OS_OBJECT_USE_OBJC
     if (_loggerQueue) {
         dispatch_release(_loggerQueue);
@@ -915,6 +4470,54 @@ NSString * __nullable DDExtractFileNameWithoutExtension(const char *filePath, BO
 
 @end
 
+@implementation DDLogFlush {
+    NSMutableArray<id<DDLogger>> *_pendingLoggers;
+    BOOL _finished;
+}
+
+- (instancetype)initWithLoggers:(NSArray<id<DDLogger>> *)loggers discardedFlags:(DDLogFlag)discardedFlags {
+    if ((self = [super init])) {
+        _group = dispatch_group_create();
+        _discardedFlags = discardedFlags;
+        _startNanoseconds = DDLogMonotonicNanoseconds();
+        _pendingLoggers = loggers ? [loggers mutableCopy] : [NSMutableArray new];
+    }
+    return self;
+}
+
+- (void)lt_didReachLoggingQueue {
+    @synchronized (self) {
+        [_pendingLoggers removeAllObjects];
+    }
+}
+
+- (void)lt_willWaitForLogger:(id <DDLogger>)logger {
+    @synchronized (self) {
+        [_pendingLoggers addObject:logger];
+    }
+}
+
+- (void)loggerDidFlush:(id <DDLogger>)logger {
+    @synchronized (self) {
+        __auto_type index = [_pendingLoggers indexOfObjectIdenticalTo:logger];
+        if (index != NSNotFound) {
+            [_pendingLoggers removeObjectAtIndex:index];
+        }
+    }
+}
+
+- (NSArray<id<DDLogger>> *)finish {
+    @synchronized (self) {
+        if (_finished) {
+            return nil;
+        }
+        _finished = YES;
+        return [_pendingLoggers copy];
+    }
+}
+
+@end
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -937,55 +4540,164 @@ NSString * __nullable DDExtractFileNameWithoutExtension(const char *filePath, BO
                            tag:(id)tag
                        options:(DDLogMessageOptions)options
                      timestamp:(NSDate *)timestamp {
+    if ((self = [super init])) {
+        [self setUpWithFormat:messageFormat
+                    formatted:message
+                        level:level
+                         flag:flag
+                      context:context
+                         file:file
+                     function:function
+                         line:line
+                          tag:tag
+                      options:options
+                    timestamp:timestamp
+                     callsite:NULL];
+        // Messages created outside of DDLog may be given to loggers and formatters directly.
+        _timestamp = self.timestamp;
+    }
+    return self;
+}
+
+- (instancetype)initWithFormat:(NSString *)messageFormat
+                     formatted:(NSString *)message
+                         level:(DDLogLevel)level
+                          flag:(DDLogFlag)flag
+                       context:(NSInteger)context
+                      callsite:(DDLogCallsite *)callsite
+                           tag:(id)tag
+                       options:(DDLogMessageOptions)options
+                     timestamp:(NSDate *)timestamp {
+    NSParameterAssert(callsite);
+
+    if ((self = [self init])) {
+        [self setUpWithFormat:messageFormat
+                    formatted:message
+                        level:level
+                         flag:flag
+                      context:context
+                         file:nil
+                     function:nil
+                         line:callsite->line
+                          tag:tag
+                      options:options
+                    timestamp:timestamp
+                     callsite:callsite];
+        _timestamp = self.timestamp;
+    }
+    return self;
+}
+
+- (void)setUpWithFormat:(NSString *)messageFormat
+              formatted:(NSString *)message
+                  level:(DDLogLevel)level
+                   flag:(DDLogFlag)flag
+                context:(NSInteger)context
+                   file:(NSString *)file
+               function:(NSString *)function
+                   line:(NSUInteger)line
+                    tag:(id)tag
+                options:(DDLogMessageOptions)options
+              timestamp:(NSDate *)timestamp
+               callsite:(DDLogCallsite *)callsite {
     NSParameterAssert(messageFormat);
     NSParameterAssert(message);
-    NSParameterAssert(file);
-
-    if ((self = [super init])) {
-        __auto_type copyMessage = (options & DDLogMessageDontCopyMessage) == 0;
-        _messageFormat = copyMessage ? [messageFormat copy] : messageFormat;
-        _message       = copyMessage ? [message copy] : message;
-        _level         = level;
-        _flag          = flag;
-        _context       = context;
+    NSParameterAssert(file || callsite);
 
+    __auto_type copyMessage = (options & DDLogMessageDontCopyMessage) == 0;
+    _messageFormat = copyMessage ? [messageFormat copy] : messageFormat;
+    _message       = copyMessage ? [message copy] : message;
+    _level         = level;
+    _flag          = flag;
+    _context       = context;
+
+    __auto_type threadCache = DDLogGetThreadCache();
+
+    _callsite = callsite;
+    if (callsite) {
+        DDLogCallsitePrepare(callsite);
+        _file = (__bridge NSString *)__atomic_load_n(&callsite->_file, __ATOMIC_ACQUIRE);
+        _function = (__bridge NSString *)__atomic_load_n(&callsite->_function, __ATOMIC_ACQUIRE);
+        _fileName = (__bridge NSString *)__atomic_load_n(&callsite->_fileName, __ATOMIC_ACQUIRE);
+    } else {
         __auto_type copyFile = (options & DDLogMessageCopyFile) != 0;
         _file = copyFile ? [file copy] : file;
 
         __auto_type copyFunction = (options & DDLogMessageCopyFunction) != 0;
         _function = copyFunction ? [function copy] : function;
 
-        _line         = line;
-        _representedObject = tag;
+        _fileName = DDLogFileName(threadCache, _file);
+    }
+
+    _line         = line;
+    _representedObject = tag;
 #if DD_LEGACY_MESSAGE_TAG
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
-        _tag = tag;
+    _tag = tag;
 #pragma clang diagnostic pop
 #endif
-        _options      = options;
-        _timestamp    = timestamp ?: [NSDate date];
+    _options      = options;
 
-        __uint64_t tid;
-        if (pthread_threadid_np(NULL, &tid) == 0) {
-            _threadID = [[NSString alloc] initWithFormat:@"%llu", tid];
-        } else {
-            _threadID = @"N/A";
-        }
-        _threadName   = NSThread.currentThread.name;
+    // The date object is only created when needed (see -timestamp), to keep it off the logging thread.
+    _timestamp    = timestamp;
+    _timestampNanoseconds = timestamp ? DDLogNanosecondsFromDate(timestamp) : DDLogWallClockNanoseconds();
+    _monotonicTimestampNanoseconds = DDLogMonotonicNanoseconds();
 
-        // Get the file name without extension
-        _fileName = [_file lastPathComponent];
-        __auto_type dotLocation = [_fileName rangeOfString:@"." options:NSBackwardsSearch].location;
-        if (dotLocation != NSNotFound) {
-            _fileName = [_fileName substringToIndex:dotLocation];
-        }
+    _threadID     = DDLogThreadID(threadCache);
+    _threadName   = DDLogThreadName(threadCache);
 
-        // Try to get the current queue's label
-        _queueLabel = @(dispatch_queue_get_label(DISPATCH_CURRENT_QUEUE_LABEL));
-        _qos = (NSUInteger) qos_class_self();
+    // Try to get the current queue's label
+    _queueLabel = DDLogQueueLabel(threadCache);
+    _qos = (NSUInteger) qos_class_self();
+}
+
+- (void)dealloc {
+    if (_arguments) {
+        DDLogArgumentsFree(_arguments);
     }
-    return self;
+    __auto_type deferredMessage = atomic_load_explicit(&_deferredMessage, memory_order_acquire);
+    if (deferredMessage) {
+        CFRelease(deferredMessage);
+    }
+    __auto_type messageUTF8Data = atomic_load_explicit(&_messageUTF8Data, memory_order_acquire);
+    if (messageUTF8Data) {
+        CFRelease(messageUTF8Data);
+    }
+    DDLogFormattedMessagesFree(atomic_load_explicit(&_formattedMessages, memory_order_acquire));
+}
+
+- (void)prepareForReuse {
+    if (_arguments) {
+        DDLogArgumentsFree(_arguments);
+        _arguments = NULL;
+    }
+    __auto_type deferredMessage = atomic_exchange_explicit(&_deferredMessage, NULL, memory_order_acq_rel);
+    if (deferredMessage) {
+        CFRelease(deferredMessage);
+    }
+    __auto_type messageUTF8Data = atomic_exchange_explicit(&_messageUTF8Data, NULL, memory_order_acq_rel);
+    if (messageUTF8Data) {
+        CFRelease(messageUTF8Data);
+    }
+    DDLogFormattedMessagesFree(atomic_exchange_explicit(&_formattedMessages, NULL, memory_order_acq_rel));
+    _callsite = NULL;
+    _message = nil;
+    _messageFormat = nil;
+    _file = nil;
+    _fileName = nil;
+    _function = nil;
+    _representedObject = nil;
+#if DD_LEGACY_MESSAGE_TAG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+    _tag = nil;
+#pragma clang diagnostic pop
+#endif
+    _timestamp = nil;
+    _threadID = nil;
+    _threadName = nil;
+    _queueLabel = nil;
 }
 
 - (instancetype)initWithFormat:(NSString *)messageFormat
@@ -1060,7 +4772,7 @@ NS_INLINE BOOL _nullable_strings_equal(NSString* _Nullable lhs, NSString* _Nulla
         return NO;
     } else {
         __auto_type otherMsg = (DDLogMessage *)other;
-        return [otherMsg->_message isEqualToString:_message]
+        return [otherMsg.message isEqualToString:self.message]
         && [otherMsg->_messageFormat isEqualToString:_messageFormat]
         && otherMsg->_level == _level
         && otherMsg->_flag == _flag
@@ -1069,7 +4781,7 @@ NS_INLINE BOOL _nullable_strings_equal(NSString* _Nullable lhs, NSString* _Nulla
         && _nullable_strings_equal(otherMsg->_function, _function)
         && otherMsg->_line == _line
         && (([otherMsg->_representedObject respondsToSelector:@selector(isEqual:)] && [otherMsg->_representedObject isEqual:_representedObject]) || otherMsg->_representedObject == _representedObject)
-        && [otherMsg->_timestamp isEqualToDate:_timestamp]
+        && otherMsg->_timestampNanoseconds == _timestampNanoseconds
         && [otherMsg->_threadID isEqualToString:_threadID] // If the thread ID is the same, the name will likely be the same as well.
         && [otherMsg->_queueLabel isEqualToString:_queueLabel]
         && otherMsg->_qos == _qos;
@@ -1079,7 +4791,7 @@ NS_INLINE BOOL _nullable_strings_equal(NSString* _Nullable lhs, NSString* _Nulla
 - (NSUInteger)hash {
     // Subclasses of NSObject should not call [super hash] here.
     // See https://stackoverflow.com/questions/36593038/confused-about-the-default-isequal-and-hash-implements
-    return _message.hash
+    return self.message.hash
     ^ _messageFormat.hash
     ^ _level
     ^ _flag
@@ -1088,7 +4800,7 @@ NS_INLINE BOOL _nullable_strings_equal(NSString* _Nullable lhs, NSString* _Nulla
     ^ _function.hash
     ^ _line
     ^ ([_representedObject respondsToSelector:@selector(hash)] ? [_representedObject hash] : (NSUInteger)_representedObject)
-    ^ _timestamp.hash
+    ^ (NSUInteger)_timestampNanoseconds
     ^ _threadID.hash
     ^ _queueLabel.hash
     ^ _qos;
@@ -1098,7 +4810,7 @@ NS_INLINE BOOL _nullable_strings_equal(NSString* _Nullable lhs, NSString* _Nulla
     DDLogMessage *newMessage = [DDLogMessage new];
 
     newMessage->_messageFormat = _messageFormat;
-    newMessage->_message = _message;
+    newMessage->_message = self.message;
     newMessage->_level = _level;
     newMessage->_flag = _flag;
     newMessage->_context = _context;
@@ -1115,14 +4827,117 @@ NS_INLINE BOOL _nullable_strings_equal(NSString* _Nullable lhs, NSString* _Nulla
 #endif
     newMessage->_options = _options;
     newMessage->_timestamp = _timestamp;
+    newMessage->_timestampNanoseconds = _timestampNanoseconds;
+    newMessage->_monotonicTimestampNanoseconds = _monotonicTimestampNanoseconds;
     newMessage->_threadID = _threadID;
     newMessage->_threadName = _threadName;
     newMessage->_queueLabel = _queueLabel;
     newMessage->_qos = _qos;
+    newMessage->_callsite = _callsite;
+
+    __auto_type messageUTF8Data = atomic_load_explicit(&_messageUTF8Data, memory_order_acquire);
+    if (messageUTF8Data) {
+        atomic_store_explicit(&newMessage->_messageUTF8Data, (void *)CFRetain(messageUTF8Data), memory_order_release);
+    }
 
     return newMessage;
 }
 
+- (NSString *)message {
+    if (_arguments == NULL) {
+        return _message;
+    }
+
+    __auto_type existing = atomic_load_explicit(&_deferredMessage, memory_order_acquire);
+    if (existing) {
+        return (__bridge NSString *)existing;
+    }
+
+    // Loggers may ask for it concurrently, only the first rendering is published.
+    __auto_type message = DDLogArgumentsRender(_arguments);
+    void *retained = (void *)CFBridgingRetain(message);
+    if (!atomic_compare_exchange_strong_explicit(&_deferredMessage, &existing, retained, memory_order_acq_rel, memory_order_acquire)) {
+        CFRelease(retained);
+        return (__bridge NSString *)existing;
+    }
+    return message;
+}
+
+- (NSData *)messageUTF8Data {
+    __auto_type existing = atomic_load_explicit(&_messageUTF8Data, memory_order_acquire);
+    if (existing) {
+        return (__bridge NSData *)existing;
+    }
+
+    // Loggers may ask for it concurrently, only the first encoding is published.
+    __auto_type message = self.message ?: @"";
+    __auto_type maxLength = [message lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+    char *bytes = malloc(maxLength + 1);
+    if (bytes == NULL) {
+        return [message dataUsingEncoding:NSUTF8StringEncoding] ?: [NSData data];
+    }
+    NSUInteger length = 0;
+    [message getBytes:bytes
+            maxLength:maxLength
+           usedLength:&length
+             encoding:NSUTF8StringEncoding
+              options:0
+                range:NSMakeRange(0, message.length)
+       remainingRange:NULL];
+    bytes[length] = '\0';
+
+    __auto_type data = [[NSData alloc] initWithBytesNoCopy:bytes length:length freeWhenDone:YES];
+    void *retained = (void *)CFBridgingRetain(data);
+    if (!atomic_compare_exchange_strong_explicit(&_messageUTF8Data, &existing, retained, memory_order_acq_rel, memory_order_acquire)) {
+        CFRelease(retained);
+        return (__bridge NSData *)existing;
+    }
+    return data;
+}
+
+- (NSString *)formattedMessageUsingFormatter:(id <DDLogFormatter>)formatter {
+    if (![formatter respondsToSelector:@selector(isPure)] || !formatter.isPure) {
+        return [formatter formatLogMessage:self];
+    }
+
+    __auto_type key = (__bridge const void *)formatter;
+    __auto_type head = atomic_load_explicit(&_formattedMessages, memory_order_acquire);
+    __auto_type found = DDLogFormattedMessageFind(head, NULL, key);
+    if (found) {
+        return (__bridge NSString *)found->string;
+    }
+
+    // Loggers may format concurrently, only the first result is kept.
+    __auto_type string = [formatter formatLogMessage:self];
+    DDLogFormattedMessage *formattedMessage = malloc(sizeof(DDLogFormattedMessage));
+    if (formattedMessage == NULL) {
+        return string;
+    }
+    formattedMessage->formatter = CFBridgingRetain(formatter);
+    formattedMessage->string = string ? CFBridgingRetain(string) : NULL;
+
+    __auto_type searched = head;
+    for (;;) {
+        formattedMessage->next = head;
+        if (atomic_compare_exchange_weak_explicit(&_formattedMessages, &head, formattedMessage, memory_order_acq_rel, memory_order_acquire)) {
+            return string;
+        }
+        // Only the entries pushed in the meantime need to be searched.
+        found = DDLogFormattedMessageFind(head, searched, key);
+        if (found) {
+            formattedMessage->next = NULL;
+            DDLogFormattedMessagesFree(formattedMessage);
+            return (__bridge NSString *)found->string;
+        }
+        searched = head;
+    }
+}
+
+- (NSDate *)timestamp {
+    // Not stored, as loggers may ask for it concurrently.
+    return _timestamp ?: DDLogDateFromNanoseconds(_timestampNanoseconds);
+}
+
 // ensure compatibility even when built with DD_LEGACY_MESSAGE_TAG to 0.
 - (id)tag {
     return _representedObject;
@@ -1219,6 +5034,7 @@ NS_INLINE BOOL _nullable_strings_equal(NSString* _Nullable lhs, NSString* _Nulla
     //               Operations are added to this queue from the global loggingQueue.
     //
     // globalLoggingQueue : The queue that all log messages go through before they arrive in our loggerQueue.
+    //                      This is the logging queue of the DDLog instance we were added to (owningLoggingQueue).
     //
     // All log statements go through the serial globalLoggingQueue before they arrive at our loggerQueue.
     // Thus this method also goes through the serial globalLoggingQueue to ensure intuitive operation.
@@ -1235,7 +5051,7 @@ NS_INLINE BOOL _nullable_strings_equal(NSString* _Nullable lhs, NSString* _Nulla
     DDAbstractLoggerAssertLockedPropertyAccess();
 
     __block id <DDLogFormatter> result;
-    dispatch_sync(DDLog.loggingQueue, ^{
+    dispatch_sync(self.owningLoggingQueue, ^{
         dispatch_sync(self->_loggerQueue, ^{
             result = self->_logFormatter;
         });
@@ -1267,7 +5083,7 @@ NS_INLINE BOOL _nullable_strings_equal(NSString* _Nullable lhs, NSString* _Nulla
         }
     };
 
-    dispatch_async(DDLog.loggingQueue, ^{
+    dispatch_async(self.owningLoggingQueue, ^{
         dispatch_async(self->_loggerQueue, block);
     });
 }
@@ -1280,6 +5096,10 @@ NS_INLINE BOOL _nullable_strings_equal(NSString* _Nullable lhs, NSString* _Nulla
     return NSStringFromClass([self class]);
 }
 
+- (dispatch_queue_t)owningLoggingQueue {
+    return [DDLog logOwningLogger:self].loggingQueue ?: DDLog.loggingQueue;
+}
+
 - (BOOL)isOnGlobalLoggingQueue {
     return (dispatch_get_specific(GlobalLoggingQueueIdentityKey) != NULL);
 }
@@ -1294,6 +5114,159 @@ NS_INLINE BOOL _nullable_strings_equal(NSString* _Nullable lhs, NSString* _Nulla
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+@implementation DDLogSamplingPolicy {
+    atomic_ulong _sampledInCount;
+    atomic_ulong _sampledOutCount;
+    atomic_ulong _messageCount;
+}
+
+- (instancetype)initWithMode:(DDLogSamplingMode)mode rate:(double)rate interval:(NSUInteger)interval {
+    if ((self = [super init])) {
+        _mode = mode;
+        _rate = MIN(MAX(rate, 0.0), 1.0);
+        _interval = MAX(interval, (NSUInteger)1);
+        atomic_init(&_sampledInCount, 0);
+        atomic_init(&_sampledOutCount, 0);
+        atomic_init(&_messageCount, 0);
+    }
+    return self;
+}
+
++ (instancetype)randomPolicyWithRate:(double)rate {
+    return [[self alloc] initWithMode:DDLogSamplingModeRandom rate:rate interval:0];
+}
+
++ (instancetype)everyNthPolicyWithInterval:(NSUInteger)interval {
+    NSParameterAssert(interval > 0);
+    return [[self alloc] initWithMode:DDLogSamplingModeEveryNth rate:1.0 / MAX(interval, (NSUInteger)1) interval:interval];
+}
+
++ (instancetype)callsitePolicyWithRate:(double)rate {
+    return [[self alloc] initWithMode:DDLogSamplingModeCallsite rate:rate interval:0];
+}
+
+- (BOOL)sampleLogMessageWithFile:(const char *)file line:(NSUInteger)line {
+    BOOL sampled = YES;
+    switch (_mode) {
+        case DDLogSamplingModeRandom:
+            sampled = DDLogRandomUnit() < _rate;
+            break;
+        case DDLogSamplingModeEveryNth:
+            sampled = atomic_fetch_add_explicit(&_messageCount, 1, memory_order_relaxed) % _interval == 0;
+            break;
+        case DDLogSamplingModeCallsite:
+            sampled = DDLogCallsiteUnit(file, line) < _rate;
+            break;
+    }
+
+    atomic_fetch_add_explicit(sampled ? &_sampledInCount : &_sampledOutCount, 1, memory_order_relaxed);
+    return sampled;
+}
+
+- (NSUInteger)sampledInCount {
+    return atomic_load_explicit(&_sampledInCount, memory_order_relaxed);
+}
+
+- (NSUInteger)sampledOutCount {
+    return atomic_load_explicit(&_sampledOutCount, memory_order_relaxed);
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation DDLoggerStatistics
+
+- (instancetype)initWithLogger:(id <DDLogger>)logger
+         deliveredMessageCount:(NSUInteger)deliveredMessageCount
+             medianServiceTime:(NSTimeInterval)medianServiceTime
+ninetyNinthPercentileServiceTime:(NSTimeInterval)ninetyNinthPercentileServiceTime
+            maximumServiceTime:(NSTimeInterval)maximumServiceTime
+                    flushCount:(NSUInteger)flushCount
+            totalFlushDuration:(NSTimeInterval)totalFlushDuration
+          maximumFlushDuration:(NSTimeInterval)maximumFlushDuration
+          additionalStatistics:(NSDictionary<NSString *, NSNumber *> *)additionalStatistics {
+    if ((self = [super init])) {
+        _logger = logger;
+        _deliveredMessageCount = deliveredMessageCount;
+        _medianServiceTime = medianServiceTime;
+        _ninetyNinthPercentileServiceTime = ninetyNinthPercentileServiceTime;
+        _maximumServiceTime = maximumServiceTime;
+        _flushCount = flushCount;
+        _totalFlushDuration = totalFlushDuration;
+        _maximumFlushDuration = maximumFlushDuration;
+        _additionalStatistics = [additionalStatistics copy];
+    }
+    return self;
+}
+
+@end
+
+NS_INLINE NSUInteger DDLogStatisticsSumForFlag(const NSUInteger *counts, DDLogFlag flag) {
+    NSUInteger sum = 0;
+    for (NSUInteger i = 0; i < kDDLogStatisticsFlagCount; i++) {
+        __auto_type bucketFlags = i < kDDLogStatisticsFlagCount - 1 ? (NSUInteger)1 << i : ~(((NSUInteger)1 << i) - 1);
+        if (flag & bucketFlags) {
+            sum += counts[i];
+        }
+    }
+    return sum;
+}
+
+@implementation DDLogStatistics
+
+- (NSUInteger)enqueuedMessageCountForFlag:(DDLogFlag)flag {
+    return DDLogStatisticsSumForFlag(_enqueuedCounts, flag);
+}
+
+- (NSUInteger)deliveredMessageCountForFlag:(DDLogFlag)flag {
+    return DDLogStatisticsSumForFlag(_deliveredCounts, flag);
+}
+
+- (NSUInteger)enqueuedMessageCount {
+    return DDLogStatisticsSumForFlag(_enqueuedCounts, (DDLogFlag)NSUIntegerMax);
+}
+
+- (NSUInteger)deliveredMessageCount {
+    return DDLogStatisticsSumForFlag(_deliveredCounts, (DDLogFlag)NSUIntegerMax);
+}
+
+- (NSUInteger)queueDepth {
+    return _queueDepth;
+}
+
+- (NSUInteger)maximumQueueDepth {
+    return _maximumQueueDepth;
+}
+
+- (NSUInteger)droppedMessageCount {
+    return _droppedMessageCount;
+}
+
+- (NSUInteger)discardedMessageCount {
+    return _discardedMessageCount;
+}
+
+- (NSUInteger)suppressedMessageCount {
+    return _suppressedMessageCount;
+}
+
+- (NSUInteger)sampledOutMessageCount {
+    return _sampledOutMessageCount;
+}
+
+- (NSArray<DDLoggerStatistics *> *)loggerStatistics {
+    return _loggerStatistics ?: @[];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 @interface DDLoggerInformation()
 {
     // Direct accessors to be used only for performance
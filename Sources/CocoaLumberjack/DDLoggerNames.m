@@ -19,3 +19,4 @@ DDLoggerName const DDLoggerNameASL    = @"cocoa.lumberjack.aslLogger";
 DDLoggerName const DDLoggerNameTTY    = @"cocoa.lumberjack.ttyLogger";
 DDLoggerName const DDLoggerNameOS     = @"cocoa.lumberjack.osLogger";
 DDLoggerName const DDLoggerNameFile   = @"cocoa.lumberjack.fileLogger";
+DDLoggerName const DDLoggerNameFlightRecorder = @"cocoa.lumberjack.flightRecorderLogger";
@@ -148,10 +148,12 @@ static DDOSLogger *sharedInstance;
 #endif
 
     if (@available(iOS 10.0, macOS 10.12, tvOS 10.0, watchOS 3.0, *)) {
-        __auto_type message = _logFormatter ? [_logFormatter formatLogMessage:logMessage] : logMessage->_message;
+        __auto_type message = _logFormatter ? [logMessage formattedMessageUsingFormatter:_logFormatter] : logMessage.message;
         if (message != nil) {
             __auto_type logType = [self.logLevelMapper osLogTypeForLogFlag:logMessage->_flag];
-            os_log_with_type(self.logger, logType, "%{public}s", message.UTF8String);
+            // An unformatted message was already encoded, possibly by another logger.
+            __auto_type cString = message == logMessage.message ? (const char *)logMessage.messageUTF8Data.bytes : message.UTF8String;
+            os_log_with_type(self.logger, logType, "%{public}s", cString);
         }
     }
 }
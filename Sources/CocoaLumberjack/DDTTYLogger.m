@@ -904,7 +904,7 @@ static DDTTYLogger *sharedInstance;
 
     DDAbstractLoggerAssertLockedPropertyAccess();
     __block BOOL result;
-    dispatch_sync(DDLog.loggingQueue, ^{
+    dispatch_sync(self.owningLoggingQueue, ^{
         dispatch_sync(self.loggerQueue, ^{
             result = self->_colorsEnabled;
         });
@@ -935,7 +935,7 @@ static DDTTYLogger *sharedInstance;
     // Great strides have been take to ensure this is safe to do. Plus it's MUCH faster.
 
     DDAbstractLoggerAssertLockedPropertyAccess();
-    dispatch_async(DDLog.loggingQueue, ^{
+    dispatch_async(self.owningLoggingQueue, ^{
         dispatch_async(self.loggerQueue, block);
     });
 }
@@ -980,7 +980,7 @@ static DDTTYLogger *sharedInstance;
         block();
     } else {
         DDAbstractLoggerAssertNotOnGlobalLoggingQueue();
-        dispatch_async(DDLog.loggingQueue, ^{
+        dispatch_async(self.owningLoggingQueue, ^{
             dispatch_async(self.loggerQueue, block);
         });
     }
@@ -1009,7 +1009,7 @@ static DDTTYLogger *sharedInstance;
         block();
     } else {
         DDAbstractLoggerAssertNotOnGlobalLoggingQueue();
-        dispatch_async(DDLog.loggingQueue, ^{
+        dispatch_async(self.owningLoggingQueue, ^{
             dispatch_async(self.loggerQueue, block);
         });
     }
@@ -1045,7 +1045,7 @@ static DDTTYLogger *sharedInstance;
         block();
     } else {
         DDAbstractLoggerAssertNotOnGlobalLoggingQueue();
-        dispatch_async(DDLog.loggingQueue, ^{
+        dispatch_async(self.owningLoggingQueue, ^{
             dispatch_async(self.loggerQueue, block);
         });
     }
@@ -1067,7 +1067,7 @@ static DDTTYLogger *sharedInstance;
         block();
     } else {
         DDAbstractLoggerAssertNotOnGlobalLoggingQueue();
-        dispatch_async(DDLog.loggingQueue, ^{
+        dispatch_async(self.owningLoggingQueue, ^{
             dispatch_async(self.loggerQueue, block);
         });
     }
@@ -1087,7 +1087,7 @@ static DDTTYLogger *sharedInstance;
         block();
     } else {
         DDAbstractLoggerAssertNotOnGlobalLoggingQueue();
-        dispatch_async(DDLog.loggingQueue, ^{
+        dispatch_async(self.owningLoggingQueue, ^{
             dispatch_async(self.loggerQueue, block);
         });
     }
@@ -1107,7 +1107,7 @@ static DDTTYLogger *sharedInstance;
         block();
     } else {
         DDAbstractLoggerAssertNotOnGlobalLoggingQueue();
-        dispatch_async(DDLog.loggingQueue, ^{
+        dispatch_async(self.owningLoggingQueue, ^{
             dispatch_async(self.loggerQueue, block);
         });
     }
@@ -1128,19 +1128,72 @@ static DDTTYLogger *sharedInstance;
         block();
     } else {
         DDAbstractLoggerAssertNotOnGlobalLoggingQueue();
-        dispatch_async(DDLog.loggingQueue, ^{
+        dispatch_async(self.owningLoggingQueue, ^{
             dispatch_async(self.loggerQueue, block);
         });
     }
 }
 
+// Writes the vectors to STDERR, or appends them to the buffer of a batch of log messages.
+static void DDTTYLoggerWriteVectors(struct iovec *vectors, int count, NSMutableData *buffer) {
+    if (buffer == nil) {
+        writev(STDERR_FILENO, vectors, count);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (vectors[i].iov_len > 0) {
+            [buffer appendBytes:vectors[i].iov_base length:vectors[i].iov_len];
+        }
+    }
+}
+
 - (void)logMessage:(DDLogMessage *)logMessage {
-    __auto_type logMsg = logMessage->_message;
+    [self lt_logMessage:logMessage toBuffer:nil];
+}
+
+- (void)logMessages:(NSArray<DDLogMessage *> *)logMessages {
+    // Subclasses customizing logMessage: must still see every log message.
+    if ([self methodForSelector:@selector(logMessage:)] != [DDTTYLogger instanceMethodForSelector:@selector(logMessage:)]) {
+        for (DDLogMessage *logMessage in logMessages) {
+            @autoreleasepool {
+                [self logMessage:logMessage];
+            }
+        }
+        return;
+    }
+
+    // Format the whole batch into a single buffer, and write it with a single call.
+    __auto_type buffer = [NSMutableData dataWithCapacity:logMessages.count * 128];
+
+    for (DDLogMessage *logMessage in logMessages) {
+        @autoreleasepool {
+            [self lt_logMessage:logMessage toBuffer:buffer];
+        }
+    }
+
+    __auto_type bytes = (const char *)buffer.bytes;
+    __auto_type remaining = buffer.length;
+    while (remaining > 0) {
+        __auto_type written = write(STDERR_FILENO, bytes, remaining);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        bytes += written;
+        remaining -= (NSUInteger)written;
+    }
+}
+
+- (void)lt_logMessage:(DDLogMessage *)logMessage toBuffer:(nullable NSMutableData *)buffer {
+    __auto_type logMsg = logMessage.message;
     __auto_type isFormatted = NO;
 
     if (_logFormatter) {
-        logMsg = [_logFormatter formatLogMessage:logMessage];
-        isFormatted = logMsg != logMessage->_message;
+        logMsg = [logMessage formattedMessageUsingFormatter:_logFormatter];
+        isFormatted = logMsg != logMessage.message;
     }
 
     if (logMsg) {
@@ -1177,28 +1230,39 @@ static DDTTYLogger *sharedInstance;
 
         // Convert log message to C string.
         //
-        // We use the stack instead of the heap for speed if possible.
+        // The message itself is encoded only once, and shared with the other loggers.
+        // Otherwise, we use the stack instead of the heap for speed if possible.
         // But we're extra cautious to avoid a stack overflow.
 
-        __auto_type msgLen = [logMsg lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
-        const __auto_type useStack = msgLen < (1024 * 4);
-
+        NSData *msgData = nil;
+        NSUInteger msgLen;
         char *msg;
-        if (useStack) {
-            msg = (char *)alloca(msgLen + 1);
+        __auto_type useHeap = NO;
+
+        if (logMsg == logMessage.message) {
+            msgData = logMessage.messageUTF8Data;
+            msg = (char *)msgData.bytes;
+            msgLen = msgData.length;
         } else {
-            msg = (char *)calloc(msgLen + 1, sizeof(char));
-        }
-        if (msg == NULL) {
-            return;
-        }
+            msgLen = [logMsg lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+            useHeap = msgLen >= (1024 * 4);
+
+            if (useHeap) {
+                msg = (char *)calloc(msgLen + 1, sizeof(char));
+            } else {
+                msg = (char *)alloca(msgLen + 1);
+            }
+            if (msg == NULL) {
+                return;
+            }
 
-        BOOL logMsgEnc = [logMsg getCString:msg maxLength:(msgLen + 1) encoding:NSUTF8StringEncoding];
-        if (!logMsgEnc) {
-            if (!useStack) {
-                free(msg);
+            BOOL logMsgEnc = [logMsg getCString:msg maxLength:(msgLen + 1) encoding:NSUTF8StringEncoding];
+            if (!logMsgEnc) {
+                if (useHeap) {
+                    free(msg);
+                }
+                return;
             }
-            return;
         }
 
         // Write the log message to STDERR
@@ -1232,7 +1296,7 @@ static DDTTYLogger *sharedInstance;
                 iovecLen = 5;
             }
 
-            writev(STDERR_FILENO, v, (int)iovecLen);
+            DDTTYLoggerWriteVectors(v, (int)iovecLen, buffer);
         } else {
             // The log message is unformatted, so apply standard NSLog style formatting.
 
@@ -1242,14 +1306,11 @@ static DDTTYLogger *sharedInstance;
 
             // Calculate timestamp.
             // The technique below is faster than using NSDateFormatter.
-            if (logMessage->_timestamp) {
-                __auto_type epoch = [logMessage->_timestamp timeIntervalSince1970];
-                double integral;
-                __auto_type fract = modf(epoch, &integral);
+            if (logMessage->_timestampNanoseconds > 0) {
                 struct tm tm;
-                __auto_type time = (time_t)integral;
+                __auto_type time = (time_t)(logMessage->_timestampNanoseconds / NSEC_PER_SEC);
                 (void)localtime_r(&time, &tm);
-                __auto_type milliseconds = (long)(fract * 1000.0);
+                __auto_type milliseconds = (long)((logMessage->_timestampNanoseconds % NSEC_PER_SEC) / NSEC_PER_MSEC);
 
                 len = snprintf(ts, 24, "%04d-%02d-%02d %02d:%02d:%02d:%03ld", // yyyy-MM-dd HH:mm:ss:SSS
                                tm.tm_year + 1900,
@@ -1329,10 +1390,10 @@ static DDTTYLogger *sharedInstance;
             v[11].iov_base = "\n";
             v[11].iov_len = (msg[msgLen] == '\n') ? 0 : 1;
 
-            writev(STDERR_FILENO, v, 13);
+            DDTTYLoggerWriteVectors(v, 13, buffer);
         }
 
-        if (!useStack) {
+        if (useHeap) {
             free(msg);
         }
     }
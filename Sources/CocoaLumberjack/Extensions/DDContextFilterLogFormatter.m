@@ -68,7 +68,7 @@
 
 - (NSString *)formatLogMessage:(DDLogMessage *)logMessage {
     if ([self isOnAllowlist:logMessage->_context]) {
-        return logMessage->_message;
+        return logMessage.message;
     } else {
         return nil;
     }
@@ -111,7 +111,7 @@
     if ([self isOnDenylist:logMessage->_context]) {
         return nil;
     } else {
-        return logMessage->_message;
+        return logMessage.message;
     }
 }
 
@@ -199,7 +199,7 @@ static DDQualityOfServiceName _qos_name(NSUInteger qos) {
     __auto_type timestamp = [self stringFromDate:logMessage->_timestamp];
     __auto_type queueThreadLabel = [self queueThreadLabelForLogMessage:logMessage];
 
-    return [NSString stringWithFormat:@"%@ [%@ (QOS:%@)] %@", timestamp, queueThreadLabel, _qos_name(logMessage->_qos), logMessage->_message];
+    return [NSString stringWithFormat:@"%@ [%@ (QOS:%@)] %@", timestamp, queueThreadLabel, _qos_name(logMessage->_qos), logMessage.message];
 }
 
 @end
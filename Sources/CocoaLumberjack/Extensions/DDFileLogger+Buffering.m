@@ -133,6 +133,18 @@ static NSUInteger DDGetDefaultBufferSizeBytes(void) {
     }];
 }
 
+- (void)logMessages:(NSArray<DDLogMessage *> *)logMessages {
+    // The batch still needs to go through the buffer.
+    for (DDLogMessage *logMessage in logMessages) {
+        [self logMessage:logMessage];
+    }
+}
+
+- (BOOL)isDurable {
+    // The buffered log messages are lost if the process crashes, unlike the ones the file logger writes.
+    return NO;
+}
+
 - (void)flush {
     // This method is public.
     // We need to execute the rolling on our logging thread/queue.
@@ -151,7 +163,9 @@ static NSUInteger DDGetDefaultBufferSizeBytes(void) {
         block();
     } else {
         NSAssert(![self.fileLogger isOnGlobalLoggingQueue], @"Core architecture requirement failure");
-        dispatch_sync(DDLog.loggingQueue, ^{
+        // The proxy is what was added to the log, not the file logger.
+        __auto_type loggingQueue = [DDLog logOwningLogger:(id <DDLogger>)self].loggingQueue ?: DDLog.loggingQueue;
+        dispatch_sync(loggingQueue, ^{
             dispatch_sync(self.fileLogger.loggerQueue, block);
         });
     }
@@ -45,7 +45,7 @@
 #pragma mark Processing
 
 - (NSString *)formatLogMessage:(DDLogMessage *)logMessage {
-    __block __auto_type line = logMessage->_message;
+    __block __auto_type line = logMessage.message;
 
     dispatch_sync(_queue, ^{
         for (id<DDLogFormatter> formatter in self->_formatters) {
@@ -61,6 +61,21 @@
     return line;
 }
 
+- (BOOL)isPure {
+    __block __auto_type pure = YES;
+
+    dispatch_sync(_queue, ^{
+        for (id<DDLogFormatter> formatter in self->_formatters) {
+            if (![formatter respondsToSelector:@selector(isPure)] || !formatter.isPure) {
+                pure = NO;
+                break;
+            }
+        }
+    });
+
+    return pure;
+}
+
 - (DDLogMessage *)logMessageForLine:(NSString *)line originalMessage:(DDLogMessage *)message {
     DDLogMessage *newMessage = [message copy];
     newMessage->_message = line;
@@ -87,6 +87,7 @@ FOUNDATION_EXPORT const unsigned char CocoaLumberjackVersionString[];
 #import <CocoaLumberjack/DDASLLogger.h>
 #import <CocoaLumberjack/DDFileLogger.h>
 #import <CocoaLumberjack/DDOSLogger.h>
+#import <CocoaLumberjack/DDFlightRecorderLogger.h>
 
 // Extensions
 #import <CocoaLumberjack/DDContextFilterLogFormatter.h>
@@ -42,6 +42,9 @@ NS_ASSUME_NONNULL_BEGIN
  * You can define multiple logging context's for use in your application.
  * For example, logically separate parts of your app each have a different logging context.
  * Also 3rd party frameworks that make use of Lumberjack generally use their own dedicated logging context.
+ *
+ * The formatter only filters once the log message reached the logger.
+ * Adding the logger with a route (`+[DDLog addLogger:withLevel:route:tagPredicate:]`) keeps the messages from reaching it at all.
  **/
 @interface DDContextAllowlistFilterLogFormatter : NSObject <DDLogFormatter>
 
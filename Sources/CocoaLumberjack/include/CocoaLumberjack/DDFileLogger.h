@@ -43,6 +43,18 @@ extern NSTimeInterval     const kDDDefaultLogRollingFrequency;
 extern NSUInteger         const kDDDefaultLogMaxNumLogFiles;
 extern unsigned long long const kDDDefaultLogFilesDiskQuota;
 
+// Keys of the statistics of a file logger (see `-[DDLogger statistics]`).
+//
+// RollCount            -> number of times the log file was rolled
+// FlushCount           -> number of times the log file was synchronized to disk by a flush
+// TotalFlushDuration   -> time spent synchronizing the log file to disk by flushes, in seconds
+// MaximumFlushDuration -> longest flush, in seconds
+
+extern NSString * const DDFileLoggerStatisticsRollCountKey;
+extern NSString * const DDFileLoggerStatisticsFlushCountKey;
+extern NSString * const DDFileLoggerStatisticsTotalFlushDurationKey;
+extern NSString * const DDFileLoggerStatisticsMaximumFlushDurationKey;
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark -
@@ -418,11 +430,13 @@ extern unsigned long long const kDDDefaultLogFilesDiskQuota;
 
 /**
  *  Called when the logger is about to write message. Call super before your implementation.
+ *  Overriding it makes the logger write batches of messages one message at a time.
  */
 - (void)willLogMessage:(DDLogFileInfo *)logFileInfo NS_REQUIRES_SUPER;
 
 /**
  *  Called when the logger wrote message. Call super after your implementation.
+ *  Overriding it makes the logger write batches of messages one message at a time.
  */
 - (void)didLogMessage:(DDLogFileInfo *)logFileInfo NS_REQUIRES_SUPER;
 
@@ -0,0 +1,80 @@
+// Software License Agreement (BSD License)
+//
+// Copyright (c) 2010-2026, Deusty, LLC
+// All rights reserved.
+//
+// Redistribution and use of this software in source and binary forms,
+// with or without modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+//
+// * Neither the name of Deusty nor the names of its contributors may be used
+//   to endorse or promote products derived from this software without specific
+//   prior written permission of Deusty, LLC.
+
+#import <Foundation/Foundation.h>
+
+// Disable legacy macros
+#ifndef DD_LEGACY_MACROS
+    #define DD_LEGACY_MACROS 0
+#endif
+
+#import <CocoaLumberjack/DDLog.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// The error domain of the errors returned by ``DDFlightRecorderLogger``.
+FOUNDATION_EXPORT NSErrorDomain const DDFlightRecorderLoggerErrorDomain;
+
+/// The error codes of ``DDFlightRecorderLoggerErrorDomain``.
+typedef NS_ERROR_ENUM(DDFlightRecorderLoggerErrorDomain, DDFlightRecorderLoggerError) {
+    /// The file isn't a flight recorder file, or it is damaged beyond repair.
+    DDFlightRecorderLoggerErrorInvalidFile = 1,
+};
+
+/// A logger keeping the most recent log messages in a memory mapped file, used as a circular buffer.
+///
+/// Logging a message only copies it into the mapped memory, there are no writes to the file.
+/// The kernel writes the pages back on its own, and keeps them even if the process crashes,
+/// so the log messages preceding a crash can be recovered on the next launch
+/// (using ``recoverLogMessagesFromFileAtPath:error:``) and handed to another logger, or uploaded.
+///
+/// The file may not survive a crash of the whole system (e.g. a power loss), only one of the process.
+/// Once the buffer is full, the oldest log messages are overwritten.
+DD_SENDABLE
+@interface DDFlightRecorderLogger : DDAbstractLogger <DDLogger>
+
+/// Maps the file at the given path, creating it if needed, and starts recording.
+/// Whatever the file contained before is discarded, so recover the log messages of the previous run first.
+/// - Parameters:
+///   - filePath: The path of the file.
+///   - capacity: The size of the circular buffer in bytes (the file is slightly larger). At least 4 KB.
+///   - error: Set if the file couldn't be created or mapped.
+- (nullable instancetype)initWithFilePath:(NSString *)filePath
+                                 capacity:(NSUInteger)capacity
+                                    error:(NSError **)error NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/// The path of the file the logger records to.
+@property (nonatomic, copy, readonly) NSString *filePath;
+
+/// The size of the circular buffer in bytes.
+@property (nonatomic, readonly) NSUInteger capacity;
+
+/// Decodes the log messages recorded in the given file, oldest first.
+///
+/// A record which was being written when the process died is left out.
+/// The log messages keep their original timestamp, level, flag, context, file, function and line.
+/// If a log formatter was set on the logger, their message is the formatted message.
+/// - Parameters:
+///   - filePath: The path of a file written by a flight recorder logger.
+///   - error: Set if the file couldn't be read or isn't a flight recorder file.
+/// - Returns: The log messages, or nil on error.
++ (nullable NSArray<DDLogMessage *> *)recoverLogMessagesFromFileAtPath:(NSString *)filePath
+                                                                 error:(NSError **)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
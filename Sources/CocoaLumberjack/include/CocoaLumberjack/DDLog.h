@@ -40,6 +40,7 @@
 
 @class DDLogMessage;
 @class DDLoggerInformation;
+@class DDLogStatistics;
 @protocol DDLogger;
 @protocol DDLogFormatter;
 
@@ -221,6 +222,270 @@ FOUNDATION_EXTERN NSString * __nullable DDExtractFileNameWithoutExtension(const
 #define DD_SENDABLE
 #endif
 
+/**
+ *  Describes how asynchronous log messages are handed over to the logging queue.
+ */
+typedef NS_ENUM(NSInteger, DDLogIngressMode){
+    /**
+     *  Every asynchronous log statement submits its own block to the logging queue.
+     *  This is the default.
+     */
+    DDLogIngressModeDispatch = 0,
+
+    /**
+     *  Asynchronous log statements are pushed into a bounded lock-free ring buffer.
+     *  A single drain on the logging queue pops the messages in batches.
+     *  The drain is only scheduled when the ring buffer goes from empty to non-empty,
+     *  so under load the cost for the logging thread is a couple of atomic operations.
+     *
+     *  If the ring buffer is full, messages fall back to the dispatch behavior (without losing ordering).
+     */
+    DDLogIngressModeRingBuffer,
+
+    /**
+     *  Like `DDLogIngressModeRingBuffer`, but with one ring buffer per core (up to 16), each thread sticking to one of them.
+     *  Threads logging concurrently then rarely contend with each other.
+     *
+     *  The drain merges the ring buffers by the monotonic timestamp of the messages, a batch at a time.
+     *  Messages logged from different threads at almost the same time may therefore be delivered slightly out of order.
+     */
+    DDLogIngressModeShardedRingBuffer,
+};
+
+/**
+ *  Describes what happens to a log message when the logging queue is full (see `DDLog.maximumQueueSize`).
+ *
+ *  Synchronous log messages are never dropped.
+ */
+typedef NS_ENUM(NSInteger, DDLogOverflowPolicy){
+    /**
+     *  The logging thread blocks until there's room in the queue.
+     *  Blocked threads are unblocked in the order in which they were blocked.
+     *  This is the default.
+     */
+    DDLogOverflowPolicyBlock = 0,
+
+    /**
+     *  The new log message is dropped.
+     */
+    DDLogOverflowPolicyDropNewest,
+
+    /**
+     *  The oldest queued asynchronous log message is dropped in favor of the new one.
+     *  If the logging queue can't keep up even with evicting messages
+     *  (the queue reached twice its maximum size), the new log message is dropped.
+     *
+     *  With this policy `DDLog.maximumQueueSize` is a soft bound: the evicted messages keep their place
+     *  in the queue until the logging queue skips them, so the queue may hold up to twice as many messages,
+     *  only `maximumQueueSize` of which are logged.
+     */
+    DDLogOverflowPolicyDropOldest,
+
+    /**
+     *  Log messages less severe than `DDLog.overflowThresholdFlag` are dropped,
+     *  the logging thread blocks for all other log messages.
+     */
+    DDLogOverflowPolicyDropBelowFlag,
+};
+
+/**
+ *  Describes on which queues the loggers run (see `DDLog.schedulerMode`).
+ */
+typedef NS_ENUM(NSInteger, DDLogSchedulerMode){
+    /**
+     *  Every logger runs on its own serial queue, which gets its own thread whenever it has work.
+     *  This is the default.
+     */
+    DDLogSchedulerModeQueuePerLogger = 0,
+
+    /**
+     *  The serial queues of the loggers all target a shared pool of worker threads,
+     *  sized to the number of cores of the device.
+     *  Each logger still processes its log messages one at a time and in order,
+     *  but an idle worker picks up whichever logger has log messages waiting,
+     *  so many loggers no longer mean many threads.
+     */
+    DDLogSchedulerModeWorkerPool,
+};
+
+/**
+ *  Describes which log messages `DDLog` considers duplicates of each other (see `DDLog.suppressionMode`).
+ */
+typedef NS_ENUM(NSInteger, DDLogSuppressionMode){
+    /**
+     *  No log message is suppressed. This is the default.
+     */
+    DDLogSuppressionModeNone = 0,
+
+    /**
+     *  Log messages logged from the same file and line, with the same context, are duplicates.
+     *  The duplicates aren't even formatted.
+     */
+    DDLogSuppressionModeCallsite,
+
+    /**
+     *  Log messages with the same flag, context and formatted message are duplicates.
+     *  Messages are then always formatted right away, even when `DDLog.defersMessageFormatting` is enabled.
+     */
+    DDLogSuppressionModeMessage,
+};
+
+/**
+ *  Describes a log statement.
+ *
+ *  The logging macros emit one static callsite per log statement,
+ *  so that the strings describing it are only created once, the first time it logs.
+ *  Log messages created from a callsite share these strings.
+ *
+ *  Only the `file`, `function` and `line` fields may be set (and the callsite must outlive all log messages referencing it).
+ *  The other fields are private, and must be initialized to `NULL`.
+ */
+typedef struct {
+    const char *file;
+    const char * _Nullable function;
+    NSUInteger line;
+    void * _Nullable _file;
+    void * _Nullable _function;
+    void * _Nullable _fileName;
+} DDLogCallsite;
+
+/**
+ *  Returns the callsite for the given location, creating it the first time.
+ *  The callsite is identified by the addresses of the given strings, which must live forever (e.g. string literals).
+ *  Used by the Swift logging functions, which can't emit static callsites.
+ *
+ *  @return the callsite, or `NULL` if there's no room for another callsite.
+ */
+FOUNDATION_EXPORT DDLogCallsite * _Nullable DDLogCallsiteForLocation(const char *file, const char * _Nullable function, NSUInteger line);
+
+/**
+ *  A name in the hierarchy of named log levels (see `+[DDLog setLevel:forName:]`), e.g. "net.http.retry".
+ *
+ *  Declare the name once per file (or per subsystem) with `DD_LOG_NAME`, and make its level the log level of the file,
+ *  before importing CocoaLumberjack:
+ *
+ *  ```
+ *  #define LOG_LEVEL_DEF DDLogLevelForName(&ddLogName)
+ *  #import <CocoaLumberjack/CocoaLumberjack.h>
+ *
+ *  DD_LOG_NAME(ddLogName, "net.http.retry");
+ *  ```
+ *
+ *  The `name` must live forever (e.g. a string literal). The other field is private, and must be initialized to `NULL`.
+ */
+typedef struct {
+    const char *name;
+    void * _Nullable _level;
+} DDLogName;
+
+#define DD_LOG_NAME(variable, aName) static DDLogName variable = { aName, NULL }
+
+/**
+ *  Looks the name up in the table of effective levels, the first time its level is asked for.
+ *  Use `DDLogLevelForName` instead.
+ *
+ *  @return the address of the effective level of the name in the table.
+ *  If the table is full, the level is looked up again on every call, and a warning is logged (once) with `NSLog`.
+ */
+FOUNDATION_EXPORT const NSUInteger *DDLogNameResolveLevel(DDLogName *name);
+
+/**
+ *  Returns the effective level of the name: the level set for the name itself, or else for its closest ancestor.
+ *  Once the name was looked up, this is a single relaxed atomic load.
+ */
+NS_INLINE DDLogLevel DDLogLevelForName(DDLogName *name) {
+    const NSUInteger *level = (const NSUInteger *)__atomic_load_n(&name->_level, __ATOMIC_ACQUIRE);
+    if (level == NULL) {
+        level = DDLogNameResolveLevel(name);
+    }
+    return (DDLogLevel)__atomic_load_n(level, __ATOMIC_RELAXED);
+}
+
+/**
+ *  Describes how a `DDLogSamplingPolicy` picks the log messages it keeps.
+ */
+typedef NS_ENUM(NSInteger, DDLogSamplingMode){
+    /**
+     *  Each log message is kept with a probability of `rate`.
+     */
+    DDLogSamplingModeRandom = 0,
+
+    /**
+     *  One log message out of every `interval` is kept, starting with the first one.
+     */
+    DDLogSamplingModeEveryNth,
+
+    /**
+     *  The log messages of a fixed share (`rate`) of the log statements are all kept, the others are all dropped.
+     *  Log statements are picked by hashing their file and line, so the same ones are kept from one run to the next.
+     */
+    DDLogSamplingModeCallsite,
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Keeps a sample of the log messages of a context and flag (see `-[DDLog setSamplingPolicy:forContext:flags:]`).
+ *
+ *  The policy counts the log messages it kept and dropped, so that numbers derived from the logs
+ *  can be scaled back up. A policy may be shared by several contexts and flags, it then counts all of their log messages.
+ */
+DD_SENDABLE
+@interface DDLogSamplingPolicy : NSObject
+
+/**
+ *  Keeps each log message with a probability of `rate` (between 0 and 1).
+ */
++ (instancetype)randomPolicyWithRate:(double)rate;
+
+/**
+ *  Keeps one log message out of every `interval` (which must not be 0).
+ */
++ (instancetype)everyNthPolicyWithInterval:(NSUInteger)interval;
+
+/**
+ *  Keeps all the log messages of a share of `rate` (between 0 and 1) of the log statements.
+ */
++ (instancetype)callsitePolicyWithRate:(double)rate;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, readonly) DDLogSamplingMode mode;
+/**
+ *  The share of log messages (or log statements) kept. `1 / interval` for `DDLogSamplingModeEveryNth`.
+ */
+@property (nonatomic, readonly) double rate;
+/**
+ *  Only meaningful for `DDLogSamplingModeEveryNth`.
+ */
+@property (nonatomic, readonly) NSUInteger interval;
+
+/**
+ *  The number of log messages kept so far.
+ */
+@property (atomic, readonly) NSUInteger sampledInCount;
+/**
+ *  The number of log messages dropped so far.
+ */
+@property (atomic, readonly) NSUInteger sampledOutCount;
+
+@end
+
+/**
+ *  Decides whether a logger gets the log messages with the given context and flag.
+ *  Called on the logging queue, and only once per context and flag: the result is kept in the routing table of the `DDLog`,
+ *  so it must not change over time.
+ */
+typedef BOOL (^DDLogRoutePredicate)(NSInteger context, DDLogFlag flag);
+
+/**
+ *  Decides whether a logger gets a log message with the given tag (its `representedObject`).
+ *  Unlike the route, it is called on the logging queue for every log message routed to the logger.
+ */
+typedef BOOL (^DDLogTagPredicate)(id _Nullable tag);
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark -
@@ -245,6 +510,206 @@ DD_SENDABLE
  **/
 @property (class, nonatomic, DISPATCH_QUEUE_REFERENCE_TYPE, readonly) dispatch_queue_t loggingQueue;
 
+/**
+ * The logging queue of this instance.
+ * The shared instance uses `DDLog.loggingQueue`, every other instance has a queue of its own,
+ * so separate instances don't serialize through one queue and can log in parallel.
+ **/
+@property (nonatomic, DISPATCH_QUEUE_REFERENCE_TYPE, readonly) dispatch_queue_t loggingQueue;
+
+/**
+ * Returns the instance the logger was last added to, or nil if it isn't added to any (anymore).
+ * Loggers use the logging queue of this instance to synchronize their properties.
+ * The owner changes as soon as `addLogger:` or `removeLogger:` returns, before the logging queue gets to it.
+ **/
++ (nullable DDLog *)logOwningLogger:(id <DDLogger>)logger;
+
+/**
+ * How asynchronous log messages reach the logging queue.
+ * Defaults to `DDLogIngressModeDispatch`. See `DDLogIngressMode` for details.
+ *
+ * The mode can be changed at any time.
+ * Messages logged from the same thread are always delivered in order, regardless of the mode.
+ **/
+@property (atomic, assign) DDLogIngressMode ingressMode;
+
+/**
+ * The flags of the log messages taking the priority lane to the logging queue, e.g. `DDLogFlagError`.
+ * Defaults to 0, which means there's no priority lane.
+ *
+ * Log messages taking the priority lane don't wait behind the backlog of the logging queue:
+ * they are logged as soon as the logging queue is done with the log message it's processing.
+ * A synchronous log message thus only waits for that, and for its loggers.
+ *
+ * Log messages with these flags may get ahead of log messages logged earlier from the same thread.
+ * Loggers needing them in order can sort them by `monotonicTimestampNanoseconds`.
+ **/
+@property (atomic, assign) DDLogFlag priorityFlags;
+
+/**
+ * The maximum number of log messages waiting on the logging queue.
+ * What happens when the queue is full is controlled by `overflowPolicy`.
+ * With `DDLogOverflowPolicyDropOldest`, the queue may grow to twice this size, see there.
+ *
+ * Defaults to 0, which means the queue is unbounded.
+ **/
+@property (atomic, assign) NSUInteger maximumQueueSize;
+
+/**
+ * What to do with log messages when the queue is full.
+ * Defaults to `DDLogOverflowPolicyBlock`.
+ **/
+@property (atomic, assign) DDLogOverflowPolicy overflowPolicy;
+
+/**
+ * Used by `DDLogOverflowPolicyDropBelowFlag`.
+ * Log messages with a less severe flag than this one (that is a greater value) are dropped when the queue is full.
+ * Defaults to `DDLogFlagWarning`.
+ **/
+@property (atomic, assign) DDLogFlag overflowThresholdFlag;
+
+/**
+ * The total number of log messages dropped because the queue was full.
+ *
+ * Once the queue drained to half of its maximum size, a warning stating how many messages were dropped is logged.
+ **/
+@property (atomic, readonly) NSUInteger droppedMessageCount;
+
+/**
+ * The total number of log messages shed by flushes discarding their flags
+ * (see `flushLogWithTimeout:discardingFlags:`). They aren't counted in `droppedMessageCount`.
+ **/
+@property (atomic, readonly) NSUInteger discardedMessageCount;
+
+/**
+ * By default, the logging queue hands every log message to all loggers concurrently,
+ * and waits for all of them to be done before processing the next message.
+ * So a single slow logger (e.g. a file logger on a stalled disk) throttles all other loggers.
+ *
+ * If set to a value greater than 0, each logger instead runs as an independent pipeline,
+ * with up to this many log messages (or batches, see `logMessages:`) in flight.
+ * The logging queue never waits for a logger: once the window of a logger is full, its log messages are
+ * kept aside (in memory, beyond `maximumQueueSize`) until the logger catches up, while the other loggers go on.
+ * Synchronous log messages still wait for the loggers receiving them.
+ * Log messages are still delivered in order to each logger.
+ *
+ * Defaults to 0.
+ **/
+@property (atomic, assign) NSUInteger maximumPendingMessagesPerLogger;
+
+/**
+ * On which queues the loggers added from now on run. See `DDLogSchedulerMode` for details.
+ * Defaults to `DDLogSchedulerModeQueuePerLogger`.
+ *
+ * With `DDLogSchedulerModeWorkerPool`, the queues created by `DDLog` and the internal queues of `DDAbstractLogger`
+ * are moved to the worker pool while the logger is added. Queues provided by other loggers are left alone.
+ **/
+@property (atomic, assign) DDLogSchedulerMode schedulerMode;
+
+/**
+ * The combination (bitwise OR) of the levels of all the loggers.
+ *
+ * Log messages whose flag isn't part of it are discarded right away, before being formatted or queued,
+ * as none of the loggers would log them.
+ **/
+@property (atomic, readonly) DDLogLevel aggregateLevel;
+
+/**
+ * If enabled, the log messages created by the `log:...` methods are taken from a pool,
+ * and go back to it once all the loggers are done with them, instead of being allocated for every log statement.
+ *
+ * IMPORTANT: Loggers (and formatters) must then not hold on to a log message after `logMessage:` returned.
+ * A logger which needs to keep a log message around (e.g. to process it later on) must `copy` it.
+ * Copies are never recycled.
+ *
+ * Log messages passed to `log:message:` are never recycled either.
+ *
+ * Defaults to NO.
+ **/
+@property (atomic, assign) BOOL recyclesLogMessages;
+
+/**
+ * If enabled, the `log:...` methods don't format the message on the calling thread.
+ * They only copy the arguments, and the message is formatted the first time a logger (or formatter)
+ * reads `DDLogMessage.message`, so not at all if no logger gets to it.
+ *
+ * C strings and strings are copied and numbers retained. Other objects passed to `%@` are still described
+ * on the calling thread, as they may be mutated or only be usable on that thread.
+ *
+ * Until then, the `_message` ivar of the log message is the format, so loggers must use the `message` property.
+ *
+ * Formats using positional arguments, `*` width or precision, `%n` or wide strings are still formatted right away,
+ * and so are all messages while `suppressionMode` is `DDLogSuppressionModeMessage`.
+ *
+ * Defaults to NO.
+ **/
+@property (atomic, assign) BOOL defersMessageFormatting;
+
+/**
+ * Suppresses log messages repeated in a short amount of time (e.g. by a retry loop).
+ *
+ * The first log message is logged, and starts a window of `suppressionWindow`.
+ * Duplicates logged within the window are only counted, on the calling thread.
+ * When the window closes, a single "Last message repeated N times" log message is logged
+ * (with the flag, context and location of the first log message) if duplicates were suppressed.
+ *
+ * Only recently logged messages are remembered, so interleaving many different log statements
+ * may let some duplicates through.
+ *
+ * Defaults to `DDLogSuppressionModeNone`.
+ **/
+@property (atomic, assign) DDLogSuppressionMode suppressionMode;
+
+/**
+ * The duration during which duplicates of a log message are suppressed (see `suppressionMode`).
+ *
+ * Defaults to 1 second.
+ **/
+@property (atomic, assign) NSTimeInterval suppressionWindow;
+
+/**
+ * The number of log messages suppressed as duplicates so far.
+ **/
+@property (atomic, readonly) NSUInteger suppressedMessageCount;
+
+/**
+ * Sets the policy sampling the log messages of the given context and flags,
+ * or removes it if `policy` is nil (all log messages are then kept).
+ *
+ * Log messages are sampled on the calling thread, before they are created or formatted.
+ * They are sampled before duplicates are suppressed (see `suppressionMode`).
+ *
+ *  @param policy  the sampling policy, or nil
+ *  @param context the context of the log messages to sample
+ *  @param flags   the flags of the log messages to sample (e.g. `DDLogFlagDebug | DDLogFlagVerbose`)
+ **/
+- (void)setSamplingPolicy:(nullable DDLogSamplingPolicy *)policy forContext:(NSInteger)context flags:(DDLogFlag)flags;
+
+/**
+ * Returns the policy sampling the log messages of the given context and flag, if any.
+ **/
+- (nullable DDLogSamplingPolicy *)samplingPolicyForContext:(NSInteger)context flag:(DDLogFlag)flag;
+
+/**
+ * The number of log messages dropped by all the sampling policies so far.
+ **/
+@property (atomic, readonly) NSUInteger sampledOutMessageCount;
+
+/**
+ * If enabled, the pipeline is measured: messages queued and delivered (by flag), queue depth,
+ * and how long each logger takes to log a message and to flush.
+ * Collection is lock-free, so that it can stay enabled in release builds.
+ *
+ * Defaults to NO.
+ **/
+@property (atomic, assign) BOOL collectsStatistics;
+
+/**
+ * A snapshot of the statistics collected since `collectsStatistics` was enabled.
+ * It never waits for the logging queue, so it may be taken from any thread, including loggers and formatters.
+ **/
+@property (nonatomic, readonly) DDLogStatistics *statistics;
+
 /**
  * Logging Primitive.
  *
@@ -364,6 +829,74 @@ DD_SENDABLE
 + (void)log:(BOOL)asynchronous
     message:(DDLogMessage *)logMessage NS_SWIFT_NAME(log(asynchronous:message:));
 
+/**
+ * Logging Primitive.
+ *
+ * Same as `log:level:flag:context:file:function:line:tag:format:...`, but the location is described by a callsite.
+ * This method is used by the macros.
+ *
+ *  @param asynchronous YES if the logging is done async, NO if you want to force sync
+ *  @param level        the log level
+ *  @param flag         the log flag
+ *  @param context      the context (if any is defined)
+ *  @param callsite     the callsite of the log statement
+ *  @param tag          potential tag
+ *  @param format       the log format
+ */
++ (void)log:(BOOL)asynchronous
+      level:(DDLogLevel)level
+       flag:(DDLogFlag)flag
+    context:(NSInteger)context
+   callsite:(DDLogCallsite *)callsite
+        tag:(nullable id)tag
+     format:(NSString *)format, ... NS_FORMAT_FUNCTION(7,8) NS_SWIFT_UNAVAILABLE("Use the Swift logging functions");
+
+/**
+ * Logging Primitive.
+ *
+ * Same as `log:level:flag:context:file:function:line:tag:format:...`, but the location is described by a callsite.
+ * This method is used by the macros.
+ *
+ *  @param asynchronous YES if the logging is done async, NO if you want to force sync
+ *  @param level        the log level
+ *  @param flag         the log flag
+ *  @param context      the context (if any is defined)
+ *  @param callsite     the callsite of the log statement
+ *  @param tag          potential tag
+ *  @param format       the log format
+ */
+- (void)log:(BOOL)asynchronous
+      level:(DDLogLevel)level
+       flag:(DDLogFlag)flag
+    context:(NSInteger)context
+   callsite:(DDLogCallsite *)callsite
+        tag:(nullable id)tag
+     format:(NSString *)format, ... NS_FORMAT_FUNCTION(7,8) NS_SWIFT_UNAVAILABLE("Use the Swift logging functions");
+
+/**
+ * Logging Primitive.
+ *
+ * This method can be used if you have a prepared va_list.
+ * Similar to `log:level:flag:context:callsite:tag:format:...`
+ *
+ *  @param asynchronous YES if the logging is done async, NO if you want to force sync
+ *  @param level        the log level
+ *  @param flag         the log flag
+ *  @param context      the context (if any is defined)
+ *  @param callsite     the callsite of the log statement
+ *  @param tag          potential tag
+ *  @param format       the log format
+ *  @param argList      the arguments list as a va_list
+ */
+- (void)log:(BOOL)asynchronous
+      level:(DDLogLevel)level
+       flag:(DDLogFlag)flag
+    context:(NSInteger)context
+   callsite:(DDLogCallsite *)callsite
+        tag:(nullable id)tag
+     format:(NSString *)format
+       args:(va_list)argList NS_SWIFT_UNAVAILABLE("Use the Swift logging functions");
+
 /**
  * Logging Primitive.
  *
@@ -387,6 +920,61 @@ DD_SENDABLE
  **/
 - (void)flushLog;
 
+/**
+ * Same as `flushLog`, but waits at most `timeout` seconds.
+ * Unlike `flushLog`, the logging queue is never blocked waiting for the loggers.
+ *
+ *  @param timeout the maximum time to wait, in seconds
+ *
+ *  @return the loggers which didn't finish flushing in time (all of them if the log messages queued before
+ *          couldn't even be handed over to the loggers in time), or an empty array
+ **/
++ (NSArray<id<DDLogger>> *)flushLogWithTimeout:(NSTimeInterval)timeout;
+
+/**
+ * Same as `flushLog`, but waits at most `timeout` seconds.
+ * See `+flushLogWithTimeout:`.
+ **/
+- (NSArray<id<DDLogger>> *)flushLogWithTimeout:(NSTimeInterval)timeout;
+
+/**
+ * Same as `flushLogWithTimeout:`, shedding queued asynchronous log messages to meet the deadline.
+ *
+ * While the flush is in progress, asynchronous log messages with any of the `discardedFlags` reaching
+ * the front of the logging queue are dropped (and counted in `discardedMessageCount`) instead of being logged,
+ * if they were logged before the flush started. The messages logged after are logged as usual.
+ *
+ *  @param timeout        the maximum time to wait, in seconds
+ *  @param discardedFlags the flags of the log messages to drop (e.g. `DDLogFlagDebug | DDLogFlagVerbose`)
+ *
+ *  @return the loggers which didn't finish flushing in time, or an empty array
+ **/
+- (NSArray<id<DDLogger>> *)flushLogWithTimeout:(NSTimeInterval)timeout discardingFlags:(DDLogFlag)discardedFlags;
+
+/**
+ * Flushes the logs like `flushLog`, without blocking the calling thread.
+ *
+ *  @param completion called on a global queue, once all loggers flushed
+ **/
++ (void)flushLogWithCompletion:(dispatch_block_t)completion;
+
+/**
+ * Flushes the logs like `flushLog`, without blocking the calling thread.
+ * See `+flushLogWithCompletion:`.
+ **/
+- (void)flushLogWithCompletion:(dispatch_block_t)completion;
+
+/**
+ * Flushes the logs like `flushLogWithTimeout:discardingFlags:`, without blocking the calling thread.
+ *
+ *  @param timeout        the time after which the completion is called, even if loggers are still flushing
+ *  @param discardedFlags the flags of the queued asynchronous log messages to drop while flushing, or 0
+ *  @param completion     called on a global queue with the loggers which didn't finish flushing in time
+ **/
+- (void)flushLogWithTimeout:(NSTimeInterval)timeout
+            discardingFlags:(DDLogFlag)discardedFlags
+                 completion:(void (^)(NSArray<id<DDLogger>> *unflushedLoggers))completion;
+
 /**
  * Loggers
  *
@@ -487,6 +1075,38 @@ DD_SENDABLE
  **/
 - (void)addLogger:(id <DDLogger>)logger withLevel:(DDLogLevel)level;
 
+/**
+ * Adds the logger to the system, only forwarding the log messages it is routed.
+ *
+ * The loggers a log message is forwarded to are looked up by its context and flag,
+ * in a routing table compiled from the levels and routes of the loggers.
+ * Unlike filtering in a formatter (e.g. `DDContextAllowlistFilterLogFormatter`),
+ * the message never reaches the queue of a logger it isn't routed to,
+ * and a message routed to no logger is never dispatched at all.
+ *
+ * For example, to only forward the log messages of a framework's context, without its verbose ones:
+ *
+ * `[DDLog addLogger:frameworkLogger withLevel:DDLogLevelDebug route:^BOOL(NSInteger context, DDLogFlag flag) { return context == SOME_FRAMEWORK_CONTEXT; } tagPredicate:nil];`
+ *
+ * @param logger       the logger
+ * @param level        a preemptive filter, same as for `addLogger:withLevel:`
+ * @param route        decides which contexts and flags are routed to the logger, nil for all of them
+ * @param tagPredicate further filters the routed log messages by their tag, nil for all of them
+ **/
++ (void)addLogger:(id <DDLogger>)logger
+        withLevel:(DDLogLevel)level
+            route:(nullable DDLogRoutePredicate)route
+     tagPredicate:(nullable DDLogTagPredicate)tagPredicate;
+
+/**
+ * Adds the logger to the system, only forwarding the log messages it is routed.
+ * See `+addLogger:withLevel:route:tagPredicate:`.
+ **/
+- (void)addLogger:(id <DDLogger>)logger
+        withLevel:(DDLogLevel)level
+            route:(nullable DDLogRoutePredicate)route
+     tagPredicate:(nullable DDLogTagPredicate)tagPredicate;
+
 /**
  *  Remove the logger from the system
  */
@@ -532,6 +1152,9 @@ DD_SENDABLE
  *
  * These methods allow you to obtain a list of classes that are using registered dynamic logging,
  * and also provides methods to get and set their log level during run time.
+ *
+ * The classes are indexed the first time one of these methods is used (which probes every class once),
+ * the images loaded afterwards are indexed as they get loaded.
  **/
 
 /**
@@ -574,6 +1197,40 @@ DD_SENDABLE
  */
 + (void)setLevel:(DDLogLevel)level forClassWithName:(NSString *)aClassName;
 
+/**
+ * Named Log Levels
+ *
+ * Names form a hierarchy, the components of a name being separated by dots: "net" is the parent of "net.http".
+ * The effective level of a name is the level set for the name itself, or else for its closest ancestor,
+ * or else for the root name (the empty string), which defaults to `DDLogLevelAll`.
+ *
+ * The effective levels of the names in use are kept in a flat table, updated when a level is set,
+ * so log statements read them with a single atomic load (see `DDLogName`).
+ * The table grows as needed, up to 65536 names. The levels of the names beyond are computed on every log statement.
+ **/
+
+/**
+ *  Sets the level of the name, and of all its descendants which don't have a level of their own.
+ *
+ *  @param level the new level
+ *  @param name  a name, e.g. "net.http", or the empty string for the root name
+ */
++ (void)setLevel:(DDLogLevel)level forName:(NSString *)name;
+
+/**
+ *  Removes the level of the name, which then inherits the level of its parent again.
+ *
+ *  @param name a name, e.g. "net.http", or the empty string for the root name
+ */
++ (void)removeLevelForName:(NSString *)name;
+
+/**
+ *  Returns the effective level of the name.
+ *
+ *  @param name a name, e.g. "net.http.retry"
+ */
++ (DDLogLevel)levelForName:(NSString *)name;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -604,6 +1261,22 @@ DD_SENDABLE
 
 @optional
 
+/**
+ * Batch version of `logMessage:`.
+ *
+ * When several log messages are processed at once (for example when they are drained from the ring buffer,
+ * see `DDLogIngressModeRingBuffer`), loggers implementing this method receive all of them (in order) with a single call,
+ * instead of one `logMessage:` call per message.
+ * This allows loggers to e.g. issue a single write for the whole batch.
+ *
+ * Loggers not implementing this method still get all messages of a batch in a single hop to their queue,
+ * via consecutive `logMessage:` calls.
+ * The built-in loggers implement it, but call `logMessage:` for every message of the batch when a subclass overrides it.
+ *
+ *  @param logMessages the messages (models), filtered by the level of the logger
+ */
+- (void)logMessages:(NSArray<DDLogMessage *> *)logMessages NS_SWIFT_NAME(log(messages:));
+
 /**
  * Since logging is asynchronous, adding and removing loggers is also asynchronous.
  * In other words, the loggers are added and removed at appropriate times with regards to log messages.
@@ -647,6 +1320,23 @@ DD_SENDABLE
  **/
 - (void)flush;
 
+/**
+ * Statistics specific to the logger (e.g. how many times a file logger rolled its file),
+ * reported in `DDLoggerStatistics.additionalStatistics`.
+ *
+ * This method may be called from any thread.
+ **/
+- (NSDictionary<NSString *, NSNumber *> *)statistics;
+
+/**
+ * Whether the logger persists the log messages (e.g. to a file or a database), so that they outlive a crash.
+ *
+ * When some loggers are durable, a synchronous log message only waits for the durable loggers to log it.
+ * The other loggers log it in the background, like an asynchronous log message.
+ * This is read once, when the logger is added.
+ **/
+@property (nonatomic, readonly, getter=isDurable) BOOL durable;
+
 /**
  * Each logger is executed concurrently with respect to the other loggers.
  * Thus, a dedicated dispatch queue is used for each logger.
@@ -717,6 +1407,16 @@ DD_SENDABLE
  */
 - (void)willRemoveFromLogger:(id <DDLogger>)logger;
 
+/**
+ * A formatter is pure if its output only depends on the log message,
+ * and not on the logger it's added to nor on when it's asked to format.
+ *
+ * The message formatted by a pure formatter is shared by all the loggers using that formatter instance,
+ * so it's only formatted once (see `-[DDLogMessage formattedMessageUsingFormatter:]`).
+ * A pure formatter may be called concurrently from several loggers, so it has to be thread-safe.
+ **/
+@property (nonatomic, readonly, getter=isPure) BOOL pure;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -805,6 +1505,8 @@ DD_SENDABLE
     id _representedObject;
     DDLogMessageOptions _options;
     NSDate * _timestamp;
+    uint64_t _timestampNanoseconds;
+    uint64_t _monotonicTimestampNanoseconds;
     NSString *_threadID;
     NSString *_threadName;
     NSString *_queueLabel;
@@ -913,6 +1615,33 @@ DD_SENDABLE
                       timestamp:(nullable NSDate *)timestamp
 __attribute__((deprecated("Use initializer taking unformatted message and args instead", "initWithFormat:formatted:level:flag:context:file:function:line:tag:options:timestamp:")));
 
+/**
+ *  Same as `initWithFormat:formatted:level:flag:context:file:function:line:tag:options:timestamp:`,
+ *  but the file, function and line are taken from the given callsite, sharing its strings.
+ *  The `DDLogMessageCopyFile` and `DDLogMessageCopyFunction` options are ignored.
+ *
+ *  @param messageFormat   the message format
+ *  @param message  the formatted message
+ *  @param level     the log level
+ *  @param flag      the log flag
+ *  @param context   the context (if any is defined)
+ *  @param callsite  the callsite of the log statement, which must outlive the log message
+ *  @param tag       potential tag
+ *  @param options   a bitmask of options
+ *  @param timestamp the log timestamp
+ *
+ *  @return a new instance of a log message model object
+ */
+- (instancetype)initWithFormat:(NSString *)messageFormat
+                     formatted:(NSString *)message
+                         level:(DDLogLevel)level
+                          flag:(DDLogFlag)flag
+                       context:(NSInteger)context
+                      callsite:(DDLogCallsite *)callsite
+                           tag:(nullable id)tag
+                       options:(DDLogMessageOptions)options
+                     timestamp:(nullable NSDate *)timestamp;
+
 /**
  * Read-only properties
  **/
@@ -921,6 +1650,11 @@ __attribute__((deprecated("Use initializer taking unformatted message and args i
  *  The log message.
  */
 @property (readonly, nonatomic) NSString *message;
+/**
+ *  The UTF-8 encoding of `message`, followed by a NUL byte which isn't part of its length.
+ *  It is encoded once, on first use, and shared by every logger the message is dispatched to.
+ */
+@property (readonly, nonatomic) NSData *messageUTF8Data;
 /**
  * The message format. When the deprecated initializer is used, this might be the same as `message`.
  */
@@ -937,11 +1671,39 @@ __attribute__((deprecated("Use initializer taking unformatted message and args i
 #endif
 @property (readonly, nonatomic, nullable) id representedObject;
 @property (readonly, nonatomic) DDLogMessageOptions options;
+/**
+ *  The log timestamp.
+ *
+ *  Messages logged through `DDLog` only capture `timestampNanoseconds`, the date object is created
+ *  on the logging queue before the message is handed to the loggers.
+ */
 @property (readonly, nonatomic) NSDate *timestamp;
+/**
+ *  The log timestamp, in nanoseconds since 1970, as read from the wall clock.
+ *  Formatters should prefer this over `timestamp` to compute the date components.
+ */
+@property (readonly, nonatomic) uint64_t timestampNanoseconds;
+/**
+ *  The time the message was created, in nanoseconds from an unspecified point.
+ *  Unlike `timestamp`, it is not affected by changes of the wall clock, which makes it suitable
+ *  to order messages and measure the time elapsed between them.
+ */
+@property (readonly, nonatomic) uint64_t monotonicTimestampNanoseconds;
 @property (readonly, nonatomic) NSString *threadID; // ID as it appears in NSLog calculated from the machThreadID
 @property (readonly, nonatomic, nullable) NSString *threadName;
 @property (readonly, nonatomic) NSString *queueLabel;
 @property (readonly, nonatomic) NSUInteger qos API_AVAILABLE(macos(10.10), ios(8.0));
+/**
+ *  The callsite the log message was created from, if any.
+ */
+@property (readonly, nonatomic, nullable) DDLogCallsite *callsite;
+
+/**
+ *  The message formatted by the given formatter, or nil if the formatter filters it out.
+ *  Loggers should use this rather than calling `formatLogMessage:` themselves:
+ *  if the formatter is pure, the message is only formatted once, and shared with the other loggers.
+ */
+- (nullable NSString *)formattedMessageUsingFormatter:(id <DDLogFormatter>)formatter;
 
 @end
 
@@ -976,6 +1738,13 @@ __attribute__((deprecated("Use initializer taking unformatted message and args i
 @property (nonatomic, strong, nullable) id <DDLogFormatter> logFormatter;
 @property (nonatomic, DISPATCH_QUEUE_REFERENCE_TYPE) dispatch_queue_t loggerQueue;
 
+/**
+ *  The logging queue of the `DDLog` the logger was added to (see `+[DDLog logOwningLogger:]`),
+ *  or `DDLog.loggingQueue` if it wasn't added to any.
+ *  Getters and setters of properties used by `logMessage:` go through this queue.
+ */
+@property (nonatomic, DISPATCH_QUEUE_REFERENCE_TYPE, readonly) dispatch_queue_t owningLoggingQueue;
+
 // For thread-safety assertions
 
 /**
@@ -1021,4 +1790,65 @@ DD_SENDABLE
 
 @end
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Statistics of a logger, part of a `DDLogStatistics` snapshot.
+ *  Service times are the time spent in `logMessage:` (or `logMessages:`, per message), they are approximated
+ *  by power of 2 buckets of nanoseconds, except for the maximum.
+ */
+DD_SENDABLE
+@interface DDLoggerStatistics : NSObject
+
+@property (nonatomic, readonly) id <DDLogger> logger;
+@property (nonatomic, readonly) NSUInteger deliveredMessageCount;
+@property (nonatomic, readonly) NSTimeInterval medianServiceTime;
+@property (nonatomic, readonly) NSTimeInterval ninetyNinthPercentileServiceTime;
+@property (nonatomic, readonly) NSTimeInterval maximumServiceTime;
+@property (nonatomic, readonly) NSUInteger flushCount;
+@property (nonatomic, readonly) NSTimeInterval totalFlushDuration;
+@property (nonatomic, readonly) NSTimeInterval maximumFlushDuration;
+/**
+ *  The statistics returned by the `statistics` method of the logger, if it implements it.
+ */
+@property (nonatomic, readonly) NSDictionary<NSString *, NSNumber *> *additionalStatistics;
+
+@end
+
+/**
+ *  A snapshot of the statistics of a `DDLog` (see `DDLog.collectsStatistics`).
+ */
+DD_SENDABLE
+@interface DDLogStatistics : NSObject
+
+/**
+ *  The number of log messages queued to the logging queue with any of the given flags.
+ */
+- (NSUInteger)enqueuedMessageCountForFlag:(DDLogFlag)flag;
+
+/**
+ *  The number of log messages with any of the given flags handed over to the loggers by the logging queue.
+ */
+- (NSUInteger)deliveredMessageCountForFlag:(DDLogFlag)flag;
+
+@property (nonatomic, readonly) NSUInteger enqueuedMessageCount;
+@property (nonatomic, readonly) NSUInteger deliveredMessageCount;
+/**
+ *  The number of log messages queued but not yet processed by the logging queue, when the snapshot was taken.
+ */
+@property (nonatomic, readonly) NSUInteger queueDepth;
+/**
+ *  The highest `queueDepth` observed.
+ */
+@property (nonatomic, readonly) NSUInteger maximumQueueDepth;
+@property (nonatomic, readonly) NSUInteger droppedMessageCount;
+@property (nonatomic, readonly) NSUInteger discardedMessageCount;
+@property (nonatomic, readonly) NSUInteger suppressedMessageCount;
+@property (nonatomic, readonly) NSUInteger sampledOutMessageCount;
+@property (nonatomic, copy, readonly) NSArray<DDLoggerStatistics *> *loggerStatistics;
+
+@end
+
 NS_ASSUME_NONNULL_END
@@ -31,8 +31,9 @@ public func _DDLogMessage(_ messageFormat: @autoclosure () -> DDLogMessageFormat
                           ddlog: DDLog) {
     // The `dynamicLogLevel` will always be checked here (instead of being passed in).
     // We cannot "mix" it with the `DDDefaultLogLevel`, because otherwise the compiler won't strip strings that are not logged.
+    // The `aggregateLevel` of the `ddlog` is checked last, to avoid creating a message none of its loggers would log.
 #if compiler(>=6.2)
-    if unsafe level.rawValue & flag.rawValue != 0 && dynamicLogLevel.rawValue & flag.rawValue != 0 {
+    if unsafe level.rawValue & flag.rawValue != 0 && dynamicLogLevel.rawValue & flag.rawValue != 0 && ddlog.aggregateLevel.rawValue & flag.rawValue != 0 {
         let logMessage = DDLogMessage(messageFormat(),
                                       level: level,
                                       flag: flag,
@@ -44,7 +45,7 @@ public func _DDLogMessage(_ messageFormat: @autoclosure () -> DDLogMessageFormat
         unsafe ddlog.log(asynchronous: asynchronous ?? asyncLoggingEnabled, message: logMessage)
     }
 #else
-    if level.rawValue & flag.rawValue != 0 && dynamicLogLevel.rawValue & flag.rawValue != 0 {
+    if level.rawValue & flag.rawValue != 0 && dynamicLogLevel.rawValue & flag.rawValue != 0 && ddlog.aggregateLevel.rawValue & flag.rawValue != 0 {
         let logMessage = DDLogMessage(messageFormat(),
                                       level: level,
                                       flag: flag,
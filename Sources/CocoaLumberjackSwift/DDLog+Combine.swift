@@ -59,7 +59,9 @@ extension DDLog {
         }
 
         func log(message logMessage: DDLogMessage) {
-            _ = subscriber?.receive(logMessage)
+            // The message may be recycled by the log once we return (see `DDLog.recyclesLogMessages`).
+            // swiftlint:disable:next force_cast
+            _ = subscriber?.receive(logMessage.copy() as! DDLogMessage)
         }
     }
 
@@ -385,6 +385,31 @@ extension DDLogMessage {
                             line: UInt = #line,
                             tag: Any? = nil,
                             timestamp: Date? = nil) {
+        // Share the strings of the callsite when possible, instead of creating them for every message.
+        if let callsite = Self._callsite(file: file, function: function, line: line) {
+#if compiler(>=6.2)
+            unsafe self.init(format: format.format,
+                             formatted: format.formatted,
+                             level: level,
+                             flag: flag,
+                             context: context,
+                             callsite: callsite,
+                             tag: tag,
+                             options: [.dontCopyMessage],
+                             timestamp: timestamp)
+#else
+            self.init(format: format.format,
+                      formatted: format.formatted,
+                      level: level,
+                      flag: flag,
+                      context: context,
+                      callsite: callsite,
+                      tag: tag,
+                      options: [.dontCopyMessage],
+                      timestamp: timestamp)
+#endif
+            return
+        }
         self.init(format: format.format,
                   formatted: format.formatted,
                   level: level,
@@ -397,4 +422,19 @@ extension DDLogMessage {
                   options: [.dontCopyMessage],
                   timestamp: timestamp)
     }
+
+    @usableFromInline
+    static func _callsite(file: StaticString, function: StaticString, line: UInt) -> UnsafeMutablePointer<DDLogCallsite>? {
+        // Static strings live forever, so their addresses identify the callsite.
+        guard file.hasPointerRepresentation && function.hasPointerRepresentation else { return nil }
+#if compiler(>=6.2)
+        return unsafe DDLogCallsiteForLocation(UnsafeRawPointer(file.utf8Start).assumingMemoryBound(to: CChar.self),
+                                               UnsafeRawPointer(function.utf8Start).assumingMemoryBound(to: CChar.self),
+                                               line)
+#else
+        return DDLogCallsiteForLocation(UnsafeRawPointer(file.utf8Start).assumingMemoryBound(to: CChar.self),
+                                        UnsafeRawPointer(function.utf8Start).assumingMemoryBound(to: CChar.self),
+                                        line)
+#endif
+    }
 }
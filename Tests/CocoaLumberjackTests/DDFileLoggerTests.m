@@ -49,6 +49,52 @@ static const DDLogLevel ddLogLevel = DDLogLevelAll;
 
 @end
 
+@interface DDCountingFileLogger : DDFileLogger
+@property (nonatomic) NSUInteger loggedMessageCount;
+@end
+
+@implementation DDCountingFileLogger
+
+- (void)logMessage:(DDLogMessage *)logMessage {
+    self.loggedMessageCount++;
+    [super logMessage:logMessage];
+}
+
+@end
+
+@interface DDHookCountingFileLogger : DDFileLogger
+@property (nonatomic) NSUInteger willLogMessageCount;
+@property (nonatomic) NSUInteger didLogMessageCount;
+@end
+
+@implementation DDHookCountingFileLogger
+
+- (void)willLogMessage:(DDLogFileInfo *)logFileInfo {
+    [super willLogMessage:logFileInfo];
+    self.willLogMessageCount++;
+}
+
+- (void)didLogMessage:(DDLogFileInfo *)logFileInfo {
+    self.didLogMessageCount++;
+    [super didLogMessage:logFileInfo];
+}
+
+@end
+
+// Takes a while to log each message, and doesn't persist them.
+@interface DDSlowLogger : DDAbstractLogger
+@property (atomic) NSUInteger loggedMessageCount;
+@end
+
+@implementation DDSlowLogger
+
+- (void)logMessage:(DDLogMessage * __unused)logMessage {
+    [NSThread sleepForTimeInterval:0.1];
+    self.loggedMessageCount++;
+}
+
+@end
+
 @interface DDFileLoggerTests : XCTestCase {
     DDSampleFileManager *logFileManager;
     DDFileLogger *logger;
@@ -117,6 +163,26 @@ static const DDLogLevel ddLogLevel = DDLogLevelAll;
     XCTAssertFalse(newLogFileInfo.isArchived);
 }
 
+- (void)testStatisticsCountRollsAndFlushes {
+    [DDLog addLogger:logger];
+    DDLogError(@"Some log in the old file");
+    __auto_type expectation = [self expectationWithDescription:@"Waiting for the log file to be rolled"];
+    [logger rollLogFileWithCompletionBlock:^{
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:3 handler:^(NSError * _Nullable error) {
+        XCTAssertNil(error);
+    }];
+    DDLogError(@"Some log in the new file");
+    [DDLog flushLog];
+
+    __auto_type statistics = [logger statistics];
+    XCTAssertEqualObjects(statistics[DDFileLoggerStatisticsRollCountKey], @1);
+    XCTAssertEqualObjects(statistics[DDFileLoggerStatisticsFlushCountKey], @1);
+    XCTAssertGreaterThanOrEqual(statistics[DDFileLoggerStatisticsMaximumFlushDurationKey].doubleValue, 0);
+    XCTAssertEqualObjects(statistics[DDFileLoggerStatisticsTotalFlushDurationKey], statistics[DDFileLoggerStatisticsMaximumFlushDurationKey]);
+}
+
 - (void)testLoggingAfterLogFileRolling {
     [DDLog addLogger:logger];
     DDLogError(@"Some log in the old file");
@@ -307,6 +373,42 @@ static const DDLogLevel ddLogLevel = DDLogLevelAll;
     XCTAssertEqual(unwrapped2, unwrapped);
 }
 
+- (void)testBufferedLoggerIsNotDurable {
+    XCTAssertTrue(logger.isDurable);
+    logger = [logger wrapWithBuffer];
+    XCTAssertFalse(logger.isDurable);
+
+    // Without any durable logger, a synchronous log message waits for every logger.
+    __auto_type slowLogger = [DDSlowLogger new];
+    [DDLog addLogger:logger];
+    [DDLog addLogger:slowLogger];
+
+    DDLogError(@"%@", @"error");
+    XCTAssertEqual(slowLogger.loggedMessageCount, 1);
+}
+
+- (void)testPropertiesSetRightAfterAddingGoThroughTheInstance {
+    __auto_type log = [[DDLog alloc] init];
+
+    // The logging queue of the instance didn't add the logger yet.
+    __auto_type gate = dispatch_semaphore_create(0);
+    dispatch_async(log.loggingQueue, ^{
+        dispatch_semaphore_wait(gate, DISPATCH_TIME_FOREVER);
+    });
+    [log addLogger:logger];
+    XCTAssertEqual([DDLog logOwningLogger:logger], log);
+    XCTAssertEqual(logger.owningLoggingQueue, log.loggingQueue);
+    logger.maximumFileSize = 1234;
+    dispatch_semaphore_signal(gate);
+
+    XCTAssertEqual(logger.maximumFileSize, 1234);
+
+    [log removeLogger:logger];
+    XCTAssertNil([DDLog logOwningLogger:logger]);
+    XCTAssertEqual(logger.owningLoggingQueue, DDLog.loggingQueue);
+    [log flushLog];
+}
+
 - (void)testWriteToFileUnbuffered {
     logger = [logger unwrapFromBuffer];
     [DDLog addLogger:logger];
@@ -353,6 +455,110 @@ static const DDLogLevel ddLogLevel = DDLogLevelAll;
     XCTAssertEqual([contents componentsSeparatedByString:@"\n"].count, 5 + 2);
 }
 
+- (void)testWriteBatchToFile {
+    logger = [logger unwrapFromBuffer];
+    [DDLog addLogger:logger];
+
+    __auto_type logMessages = [NSMutableArray<DDLogMessage *> array];
+    for (NSString *message in @[ @"error", @"warn", @"info", @"debug", @"verbose" ]) {
+        [logMessages addObject:[[DDLogMessage alloc] initWithMessage:message
+                                                               level:DDLogLevelAll
+                                                                flag:DDLogFlagInfo
+                                                             context:0
+                                                                file:@"FILE"
+                                                            function:@"FUNCTION"
+                                                                line:1
+                                                                 tag:nil
+                                                             options:0
+                                                           timestamp:nil]];
+    }
+
+    dispatch_sync(DDLog.loggingQueue, ^{
+        dispatch_sync(self->logger.loggerQueue, ^{
+            [self->logger logMessages:logMessages];
+        });
+    });
+
+    [DDLog flushLog];
+
+    NSString* filePath = logger.currentLogFileInfo.filePath;
+    XCTAssertNotNil(filePath);
+
+    NSError *error = nil;
+    NSData *data = [NSData dataWithContentsOfFile:filePath options:NSDataReadingUncached error:&error];
+    XCTAssertNil(error);
+
+    NSString *contents = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+    XCTAssertEqual([contents componentsSeparatedByString:@"\n"].count, 5 + 2);
+}
+
+- (NSArray<DDLogMessage *> *)batchOfLogMessages:(NSUInteger)count {
+    __auto_type logMessages = [NSMutableArray<DDLogMessage *> arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        [logMessages addObject:[[DDLogMessage alloc] initWithMessage:[NSString stringWithFormat:@"message %lu", (unsigned long)i]
+                                                               level:DDLogLevelAll
+                                                                flag:DDLogFlagInfo
+                                                             context:0
+                                                                file:@"FILE"
+                                                            function:@"FUNCTION"
+                                                                line:1
+                                                                 tag:nil
+                                                             options:0
+                                                           timestamp:nil]];
+    }
+    return logMessages;
+}
+
+- (void)testWriteBatchRollsLogFileDueToSize {
+    logger = [logger unwrapFromBuffer];
+    logFileManager.maximumNumberOfLogFiles = 20;
+    logger.maximumFileSize = 100;
+    [DDLog addLogger:logger];
+
+    __auto_type logMessages = [self batchOfLogMessages:10];
+    dispatch_sync(DDLog.loggingQueue, ^{
+        dispatch_sync(self->logger.loggerQueue, ^{
+            [self->logger logMessages:logMessages];
+        });
+    });
+
+    [DDLog flushLog];
+
+    // Written as a single batch, the messages would all have ended up in the first log file.
+    XCTAssertGreaterThan(logFileManager.unsortedLogFileInfos.count, 2);
+}
+
+- (void)testWriteBatchGoesThroughOverriddenLogMessage {
+    __auto_type countingLogger = [[DDCountingFileLogger alloc] initWithLogFileManager:logFileManager];
+    logger = countingLogger;
+    [DDLog addLogger:logger];
+
+    dispatch_sync(DDLog.loggingQueue, ^{
+        dispatch_sync(self->logger.loggerQueue, ^{
+            [self->logger logMessages:[self batchOfLogMessages:5]];
+        });
+    });
+
+    [DDLog flushLog];
+    XCTAssertEqual(countingLogger.loggedMessageCount, 5);
+}
+
+- (void)testWriteBatchCallsOverriddenHooksForEveryMessage {
+    __auto_type countingLogger = [[DDHookCountingFileLogger alloc] initWithLogFileManager:logFileManager];
+    logger = countingLogger;
+    [DDLog addLogger:logger];
+
+    dispatch_sync(DDLog.loggingQueue, ^{
+        dispatch_sync(self->logger.loggerQueue, ^{
+            [self->logger logMessages:[self batchOfLogMessages:5]];
+        });
+    });
+
+    [DDLog flushLog];
+    XCTAssertEqual(countingLogger.willLogMessageCount, 5);
+    XCTAssertEqual(countingLogger.didLogMessageCount, 5);
+}
+
 - (void)testOverwriteSymlink {
     NSString* customFileName = @"testIgnoreSymlink_file_name.log";
     logFileManager.customLogFileName = customFileName;
@@ -0,0 +1,133 @@
+// Software License Agreement (BSD License)
+//
+// Copyright (c) 2010-2026, Deusty, LLC
+// All rights reserved.
+//
+// Redistribution and use of this software in source and binary forms,
+// with or without modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+//
+// * Neither the name of Deusty nor the names of its contributors may be used
+//   to endorse or promote products derived from this software without specific
+//   prior written permission of Deusty, LLC.
+
+@import XCTest;
+
+#import <CocoaLumberjack/DDFlightRecorderLogger.h>
+#import <CocoaLumberjack/DDLogMacros.h>
+
+@interface DDFlightRecorderLoggerTests : XCTestCase
+@end
+
+@implementation DDFlightRecorderLoggerTests {
+    NSString *_filePath;
+}
+
+- (void)setUp {
+    [super setUp];
+    _filePath = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:_filePath error:nil];
+    [super tearDown];
+}
+
+- (DDLogMessage *)logMessageWithText:(NSString *)text flag:(DDLogFlag)flag {
+    return [[DDLogMessage alloc] initWithFormat:text
+                                      formatted:text
+                                          level:DDLogLevelAll
+                                           flag:flag
+                                        context:42
+                                           file:@(__FILE__)
+                                       function:@(__PRETTY_FUNCTION__)
+                                           line:__LINE__
+                                            tag:nil
+                                        options:(DDLogMessageOptions)0
+                                      timestamp:nil];
+}
+
+- (void)testRecordsCanBeRecoveredWithoutClosingTheLogger {
+    NSError *error;
+    __auto_type logger = [[DDFlightRecorderLogger alloc] initWithFilePath:_filePath capacity:64 * 1024 error:&error];
+    XCTAssertNotNil(logger, @"%@", error);
+    XCTAssertEqualObjects(logger.loggerName, DDLoggerNameFlightRecorder);
+
+    __auto_type first = [self logMessageWithText:@"First 🛫" flag:DDLogFlagInfo];
+    __auto_type second = [self logMessageWithText:@"Second" flag:DDLogFlagError];
+    [logger logMessage:first];
+    [logger logMessage:second];
+
+    // As if the process had died right now: nothing was written to the file explicitly.
+    __auto_type logMessages = [DDFlightRecorderLogger recoverLogMessagesFromFileAtPath:_filePath error:&error];
+    XCTAssertNotNil(logMessages, @"%@", error);
+    XCTAssertEqual(logMessages.count, 2);
+    XCTAssertEqualObjects(logMessages[0].message, @"First 🛫");
+    XCTAssertEqualObjects(logMessages[1].message, @"Second");
+    XCTAssertEqual(logMessages[1].flag, DDLogFlagError);
+    XCTAssertEqual(logMessages[1].level, DDLogLevelAll);
+    XCTAssertEqual(logMessages[1].context, 42);
+    XCTAssertEqualObjects(logMessages[1].file, second.file);
+    XCTAssertEqualObjects(logMessages[1].function, second.function);
+    XCTAssertEqual(logMessages[1].line, second.line);
+    XCTAssertEqualWithAccuracy(logMessages[1].timestamp.timeIntervalSince1970, second.timestamp.timeIntervalSince1970, 0.000001);
+}
+
+- (void)testOldestRecordsAreOverwritten {
+    NSError *error;
+    __auto_type logger = [[DDFlightRecorderLogger alloc] initWithFilePath:_filePath capacity:4096 error:&error];
+    XCTAssertNotNil(logger, @"%@", error);
+
+    const NSUInteger count = 1000;
+    for (NSUInteger i = 0; i < count; i++) {
+        [logger logMessage:[self logMessageWithText:[NSString stringWithFormat:@"%lu", (unsigned long)i] flag:DDLogFlagInfo]];
+    }
+
+    // Only the most recent messages are left, in order.
+    __auto_type logMessages = [DDFlightRecorderLogger recoverLogMessagesFromFileAtPath:_filePath error:&error];
+    XCTAssertNotNil(logMessages, @"%@", error);
+    XCTAssertGreaterThan(logMessages.count, 0);
+    XCTAssertLessThan(logMessages.count, count);
+    [logMessages enumerateObjectsUsingBlock:^(DDLogMessage *logMessage, NSUInteger idx, BOOL *stop) {
+        XCTAssertEqual(logMessage.message.integerValue, (NSInteger)(count - logMessages.count + idx));
+    }];
+}
+
+- (void)testLongMessagesAreTruncated {
+    NSError *error;
+    __auto_type logger = [[DDFlightRecorderLogger alloc] initWithFilePath:_filePath capacity:4096 error:&error];
+    XCTAssertNotNil(logger, @"%@", error);
+
+    __auto_type text = [@"" stringByPaddingToLength:10000 withString:@"é" startingAtIndex:0];
+    [logger logMessage:[self logMessageWithText:text flag:DDLogFlagInfo]];
+
+    __auto_type logMessages = [DDFlightRecorderLogger recoverLogMessagesFromFileAtPath:_filePath error:&error];
+    XCTAssertEqual(logMessages.count, 1);
+    XCTAssertGreaterThan(logMessages[0].message.length, 0);
+    XCTAssertTrue([text hasPrefix:logMessages[0].message]);
+}
+
+- (void)testNewRecordingDiscardsThePreviousOne {
+    NSError *error;
+    __auto_type logger = [[DDFlightRecorderLogger alloc] initWithFilePath:_filePath capacity:4096 error:&error];
+    [logger logMessage:[self logMessageWithText:@"Previous run" flag:DDLogFlagInfo]];
+    logger = nil;
+
+    XCTAssertEqual([DDFlightRecorderLogger recoverLogMessagesFromFileAtPath:_filePath error:&error].count, 1);
+
+    logger = [[DDFlightRecorderLogger alloc] initWithFilePath:_filePath capacity:4096 error:&error];
+    XCTAssertEqual([DDFlightRecorderLogger recoverLogMessagesFromFileAtPath:_filePath error:&error].count, 0);
+}
+
+- (void)testRecoveringAnotherFileFails {
+    [@"Not a flight recorder" writeToFile:_filePath atomically:YES encoding:NSUTF8StringEncoding error:nil];
+
+    NSError *error;
+    XCTAssertNil([DDFlightRecorderLogger recoverLogMessagesFromFileAtPath:_filePath error:&error]);
+    XCTAssertEqualObjects(error.domain, DDFlightRecorderLoggerErrorDomain);
+    XCTAssertEqual(error.code, DDFlightRecorderLoggerErrorInvalidFile);
+}
+
+@end
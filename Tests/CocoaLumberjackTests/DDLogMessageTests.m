@@ -164,6 +164,18 @@ static NSString * const kDefaultMessage = @"Log message";
 @end
 
 
+@interface DDCountingFormatter : NSObject <DDLogFormatter>
+@property (nonatomic, getter=isPure) BOOL pure;
+@property (nonatomic) NSUInteger formatCount;
+@end
+
+@implementation DDCountingFormatter
+- (NSString *)formatLogMessage:(DDLogMessage *)logMessage {
+    self.formatCount += 1;
+    return [NSString stringWithFormat:@"[%lu] %@", (unsigned long)self.formatCount, logMessage.message];
+}
+@end
+
 @interface DDLogMessageTests : XCTestCase
 @property (nonatomic, strong, readwrite) DDLogMessage *message;
 @end
@@ -319,4 +331,37 @@ static NSString * const kDefaultMessage = @"Log message";
     XCTAssertEqualObjects(message, copy);
 }
 
+- (void)testMessageUTF8DataIsEncodedOnceAndShared {
+    __auto_type message = [DDLogMessage test_messageWithMessage:@"caf\u00e9 \U0001F600"];
+    __auto_type data = message.messageUTF8Data;
+    XCTAssertEqualObjects(data, [message.message dataUsingEncoding:NSUTF8StringEncoding]);
+    XCTAssertEqual(((const char *)data.bytes)[data.length], '\0');
+    XCTAssertEqual(message.messageUTF8Data, data);
+
+    __auto_type copy = (typeof(message))[message copy];
+    XCTAssertEqual(copy.messageUTF8Data, data);
+}
+
+- (void)testPureFormatterFormatsOncePerMessage {
+    __auto_type pureFormatter = [DDCountingFormatter new];
+    pureFormatter.pure = YES;
+    __auto_type otherPureFormatter = [DDCountingFormatter new];
+    otherPureFormatter.pure = YES;
+    __auto_type impureFormatter = [DDCountingFormatter new];
+
+    __auto_type formatted = [self.message formattedMessageUsingFormatter:pureFormatter];
+    XCTAssertEqualObjects(formatted, @"[1] Log message");
+    XCTAssertEqual([self.message formattedMessageUsingFormatter:pureFormatter], formatted);
+    XCTAssertEqual(pureFormatter.formatCount, 1);
+
+    XCTAssertEqualObjects([self.message formattedMessageUsingFormatter:otherPureFormatter], @"[1] Log message");
+    XCTAssertEqual([self.message formattedMessageUsingFormatter:pureFormatter], formatted);
+
+    [self.message formattedMessageUsingFormatter:impureFormatter];
+    XCTAssertEqualObjects([self.message formattedMessageUsingFormatter:impureFormatter], @"[2] Log message");
+
+    __auto_type otherMessage = [DDLogMessage test_message];
+    XCTAssertEqualObjects([otherMessage formattedMessageUsingFormatter:pureFormatter], @"[2] Log message");
+}
+
 @end
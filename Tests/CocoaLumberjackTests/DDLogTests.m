@@ -14,7 +14,9 @@
 //   prior written permission of Deusty, LLC.
 
 @import XCTest;
+#import <objc/runtime.h>
 #import <CocoaLumberjack/DDLog.h>
+#import <CocoaLumberjack/DDLogMacros.h>
 
 @interface DDTestLogger : NSObject <DDLogger>
 @end
@@ -24,6 +26,157 @@
 - (void)logMessage:(nonnull DDLogMessage *)logMessage {}
 @end
 
+@interface DDRecordingLogger : NSObject <DDLogger>
+@property (nonatomic, copy, readonly) NSArray<DDLogMessage *> *messages;
+@property (nonatomic, assign) useconds_t delay;
+@end
+
+@implementation DDRecordingLogger {
+    NSMutableArray<DDLogMessage *> *_messages;
+}
+@synthesize logFormatter;
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        _messages = [NSMutableArray new];
+    }
+    return self;
+}
+
+- (void)logMessage:(nonnull DDLogMessage *)logMessage {
+    if (self.delay > 0) {
+        usleep(self.delay);
+    }
+    @synchronized (self) {
+        [_messages addObject:logMessage];
+    }
+}
+
+- (NSArray<DDLogMessage *> *)messages {
+    @synchronized (self) {
+        return [_messages copy];
+    }
+}
+
+@end
+
+@interface DDBatchRecordingLogger : DDRecordingLogger
+@property (atomic, assign) NSUInteger batchCount;
+@end
+
+@implementation DDBatchRecordingLogger
+
+- (void)logMessages:(NSArray<DDLogMessage *> *)logMessages {
+    self.batchCount++;
+    for (DDLogMessage *logMessage in logMessages) {
+        [self logMessage:logMessage];
+    }
+}
+
+@end
+
+// Copies the log messages, as required with recyclesLogMessages, and remembers their addresses.
+@interface DDCopyingLogger : DDRecordingLogger
+@property (nonatomic, readonly) NSUInteger distinctMessageCount;
+@end
+
+@implementation DDCopyingLogger {
+    NSMutableSet<NSValue *> *_addresses;
+}
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        _addresses = [NSMutableSet new];
+    }
+    return self;
+}
+
+- (void)logMessage:(nonnull DDLogMessage *)logMessage {
+    @synchronized (self) {
+        [_addresses addObject:[NSValue valueWithPointer:(__bridge void *)logMessage]];
+    }
+    [super logMessage:[logMessage copy]];
+}
+
+- (NSUInteger)distinctMessageCount {
+    @synchronized (self) {
+        return _addresses.count;
+    }
+}
+
+@end
+
+@interface DDDurableRecordingLogger : DDRecordingLogger
+@end
+
+@implementation DDDurableRecordingLogger
+
+- (BOOL)isDurable {
+    return YES;
+}
+
+@end
+
+// Holds every log message until opened.
+@interface DDGatedLogger : DDRecordingLogger
+- (void)open;
+@end
+
+@implementation DDGatedLogger {
+    dispatch_semaphore_t _gate;
+}
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        _gate = dispatch_semaphore_create(0);
+    }
+    return self;
+}
+
+- (void)logMessage:(nonnull DDLogMessage *)logMessage {
+    dispatch_semaphore_wait(_gate, DISPATCH_TIME_FOREVER);
+    dispatch_semaphore_signal(_gate);
+    [super logMessage:logMessage];
+}
+
+- (void)open {
+    dispatch_semaphore_signal(_gate);
+}
+
+@end
+
+DD_LOG_NAME(DDLogTestsRetryName, "ddlogtests.net.http.retry");
+
+static DDLogLevel DDRegisteredTestClassLogLevel = DDLogLevelWarning;
+
+@interface DDRegisteredTestClass : NSObject <DDRegisteredDynamicLogging>
+@end
+
+@implementation DDRegisteredTestClass
+
++ (DDLogLevel)ddLogLevel {
+    return DDRegisteredTestClassLogLevel;
+}
+
++ (void)ddSetLogLevel:(DDLogLevel)level {
+    DDRegisteredTestClassLogLevel = level;
+}
+
+@end
+
+@interface DDCountingDescription : NSObject
+@property (atomic) NSUInteger descriptionCount;
+@end
+
+@implementation DDCountingDescription
+
+- (NSString *)description {
+    self.descriptionCount++;
+    return @"described";
+}
+
+@end
+
 @interface DDLogTests : XCTestCase
 @end
 
@@ -91,4 +244,954 @@
     XCTAssertEqual([[DDLog allLoggersWithLevel][2] level], DDLogLevelInfo);
 }
 
+#pragma mark - Ingress
+
+- (void)testRingBufferIngressDeliversMessagesInOrder {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    [log addLogger:logger];
+    log.ingressMode = DDLogIngressModeRingBuffer;
+
+    // More messages than the ring can hold, so that the dispatch fallback is exercised as well.
+    const NSUInteger count = 10000;
+    for (NSUInteger i = 0; i < count; i++) {
+        [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"%lu", (unsigned long)i];
+    }
+    [log flushLog];
+
+    __auto_type messages = logger.messages;
+    XCTAssertEqual(messages.count, count);
+    [messages enumerateObjectsUsingBlock:^(DDLogMessage *message, NSUInteger idx, BOOL *stop) {
+        XCTAssertEqualObjects(message.message, ([NSString stringWithFormat:@"%lu", (unsigned long)idx]));
+    }];
+}
+
+- (void)testRingBufferIngressKeepsPerThreadOrder {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    [log addLogger:logger];
+    log.ingressMode = DDLogIngressModeRingBuffer;
+
+    enum { threadCount = 4 };
+    const NSUInteger count = 2000;
+    dispatch_apply(threadCount, dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^(size_t thread) {
+        for (NSUInteger i = 0; i < count; i++) {
+            [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:(NSInteger)thread file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"%lu", (unsigned long)i];
+        }
+    });
+    [log flushLog];
+
+    __auto_type messages = logger.messages;
+    XCTAssertEqual(messages.count, threadCount * count);
+
+    NSInteger next[threadCount] = { 0 };
+    for (DDLogMessage *message in messages) {
+        XCTAssertEqual(message.message.integerValue, next[message.context]);
+        next[message.context]++;
+    }
+}
+
+- (void)testRingBufferIngressKeepsPerThreadOrderWhenFull {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    [log addLogger:logger];
+    log.ingressMode = DDLogIngressModeRingBuffer;
+
+    // Hold the logging queue until the ring is full, so that the later messages take the fallback path.
+    __auto_type gate = dispatch_semaphore_create(0);
+    dispatch_async(log.loggingQueue, ^{
+        dispatch_semaphore_wait(gate, DISPATCH_TIME_FOREVER);
+    });
+
+    enum { threadCount = 4 };
+    const NSUInteger count = 3000;
+    dispatch_apply(threadCount, dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^(size_t thread) {
+        for (NSUInteger i = 0; i < count; i++) {
+            [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:(NSInteger)thread file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"%lu", (unsigned long)i];
+        }
+    });
+    dispatch_semaphore_signal(gate);
+
+    // Synchronous messages must not overtake the messages still in the ring either.
+    dispatch_apply(threadCount, dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^(size_t thread) {
+        [log log:NO level:DDLogLevelAll flag:DDLogFlagInfo context:(NSInteger)thread file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"%lu", (unsigned long)count];
+    });
+    [log flushLog];
+
+    __auto_type messages = logger.messages;
+    XCTAssertEqual(messages.count, threadCount * (count + 1));
+
+    NSInteger next[threadCount] = { 0 };
+    for (DDLogMessage *message in messages) {
+        XCTAssertEqual(message.message.integerValue, next[message.context]);
+        next[message.context]++;
+    }
+}
+
+- (void)testRingBufferIngressDeliversBatches {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDBatchRecordingLogger new];
+    logger.delay = 5000;
+    [log addLogger:logger];
+    log.ingressMode = DDLogIngressModeRingBuffer;
+
+    const NSUInteger count = 200;
+    for (NSUInteger i = 0; i < count; i++) {
+        [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"%lu", (unsigned long)i];
+    }
+    [log flushLog];
+
+    __auto_type messages = logger.messages;
+    XCTAssertEqual(messages.count, count);
+    [messages enumerateObjectsUsingBlock:^(DDLogMessage *message, NSUInteger idx, BOOL *stop) {
+        XCTAssertEqualObjects(message.message, ([NSString stringWithFormat:@"%lu", (unsigned long)idx]));
+    }];
+
+    // The first message keeps the logger busy, while the others pile up in the ring.
+    XCTAssertGreaterThan(logger.batchCount, 0);
+}
+
+- (void)testShardedIngressKeepsPerThreadOrder {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    [log addLogger:logger];
+    log.ingressMode = DDLogIngressModeShardedRingBuffer;
+
+    // More messages per thread than a shard can hold, so that the dispatch fallback is exercised as well.
+    enum { threadCount = 8 };
+    const NSUInteger count = 5000;
+    dispatch_apply(threadCount, dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^(size_t thread) {
+        for (NSUInteger i = 0; i < count; i++) {
+            [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:(NSInteger)thread file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"%lu", (unsigned long)i];
+        }
+    });
+    [log log:NO level:DDLogLevelAll flag:DDLogFlagInfo context:threadCount file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"last"];
+
+    __auto_type messages = logger.messages;
+    XCTAssertEqual(messages.count, threadCount * count + 1);
+    XCTAssertEqualObjects(messages.lastObject.message, @"last");
+
+    NSInteger next[threadCount] = { 0 };
+    for (DDLogMessage *message in [messages subarrayWithRange:NSMakeRange(0, threadCount * count)]) {
+        XCTAssertEqual(message.message.integerValue, next[message.context]);
+        next[message.context]++;
+    }
+}
+
+- (void)testSynchronousMessagesOnlyWaitForDurableLoggers {
+    if (NSProcessInfo.processInfo.activeProcessorCount < 2) {
+        // Loggers run one after the other on a single core.
+        return;
+    }
+
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type durableLogger = [DDDurableRecordingLogger new];
+    __auto_type gatedLogger = [DDGatedLogger new];
+    [log addLogger:durableLogger];
+    [log addLogger:gatedLogger];
+
+    [log log:NO level:DDLogLevelAll flag:DDLogFlagError context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"error"];
+    XCTAssertEqualObjects([durableLogger.messages valueForKey:@"message"], @[@"error"]);
+    XCTAssertEqual(gatedLogger.messages.count, 0);
+
+    [gatedLogger open];
+    [log flushLog];
+    XCTAssertEqualObjects([gatedLogger.messages valueForKey:@"message"], @[@"error"]);
+}
+
+- (void)testPriorityLaneOvertakesBacklog {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    [log addLogger:logger];
+    log.priorityFlags = DDLogFlagError;
+
+    // Hold the logging queue, so that a backlog builds up.
+    __auto_type gate = dispatch_semaphore_create(0);
+    dispatch_async(log.loggingQueue, ^{
+        dispatch_semaphore_wait(gate, DISPATCH_TIME_FOREVER);
+    });
+    for (NSString *message in @[@"a", @"b", @"c"]) {
+        [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"%@", message];
+    }
+    [log log:YES level:DDLogLevelAll flag:DDLogFlagError context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"error"];
+    dispatch_semaphore_signal(gate);
+
+    [log log:NO level:DDLogLevelAll flag:DDLogFlagError context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"synchronous error"];
+    XCTAssertTrue([[logger.messages valueForKey:@"message"] containsObject:@"synchronous error"]);
+
+    [log flushLog];
+    __auto_type messages = [logger.messages valueForKey:@"message"];
+    XCTAssertEqual([messages count], 5);
+    XCTAssertEqualObjects([messages firstObject], @"error");
+    __auto_type infoMessages = [messages filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"SELF.length == 1"]];
+    XCTAssertEqualObjects(infoMessages, (@[@"a", @"b", @"c"]));
+}
+
+- (void)testPriorityLaneOvertakesTheRing {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    [log addLogger:logger];
+    log.ingressMode = DDLogIngressModeRingBuffer;
+    log.priorityFlags = DDLogFlagError;
+
+    // The ring fills up while the error waits in the priority lane.
+    __auto_type gate = dispatch_semaphore_create(0);
+    dispatch_async(log.loggingQueue, ^{
+        dispatch_semaphore_wait(gate, DISPATCH_TIME_FOREVER);
+    });
+    [log log:YES level:DDLogLevelAll flag:DDLogFlagError context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"error"];
+    const NSUInteger count = 4096;
+    for (NSUInteger i = 0; i < count; i++) {
+        [log log:YES level:DDLogLevelAll flag:DDLogFlagVerbose context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"%lu", (unsigned long)i];
+    }
+    dispatch_semaphore_signal(gate);
+    [log flushLog];
+
+    __auto_type messages = [logger.messages valueForKey:@"message"];
+    XCTAssertEqual([messages count], count + 1);
+    XCTAssertEqualObjects([messages firstObject], @"error");
+    XCTAssertEqualObjects([messages lastObject], ([NSString stringWithFormat:@"%lu", (unsigned long)count - 1]));
+}
+
+- (void)testRoutesOnlyDeliverRoutedMessages {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type routedLogger = [DDRecordingLogger new];
+    __auto_type logger = [DDRecordingLogger new];
+    __block NSUInteger routeCount = 0;
+    [log addLogger:routedLogger withLevel:DDLogLevelAll route:^BOOL(NSInteger context, DDLogFlag flag) {
+        routeCount++;
+        return context == 1 && flag != DDLogFlagVerbose;
+    } tagPredicate:^BOOL(id tag) {
+        return ![tag isEqual:@"skip"];
+    }];
+    [log addLogger:logger withLevel:DDLogLevelInfo];
+
+    for (NSUInteger i = 0; i < 2; i++) {
+        [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"other context"];
+        [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:1 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"routed"];
+        [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:1 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:@"skip" format:@"skipped tag"];
+        [log log:YES level:DDLogLevelAll flag:DDLogFlagVerbose context:1 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"verbose"];
+    }
+    [log flushLog];
+
+    XCTAssertEqualObjects([routedLogger.messages valueForKey:@"message"], (@[@"routed", @"routed"]));
+    XCTAssertEqualObjects([logger.messages valueForKey:@"message"], (@[@"other context", @"routed", @"skipped tag", @"other context", @"routed", @"skipped tag"]));
+    // Each context and flag is only routed once.
+    XCTAssertEqual(routeCount, 3);
+}
+
+- (void)testSeparateInstancesLogIndependently {
+    __auto_type blockedLog = [[DDLog alloc] init];
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    [log addLogger:logger];
+    XCTAssertNotEqual(log.loggingQueue, blockedLog.loggingQueue);
+    XCTAssertNotEqual(log.loggingQueue, DDLog.loggingQueue);
+
+    // Holding the logging queue of one instance doesn't hold up the other one.
+    __auto_type gate = dispatch_semaphore_create(0);
+    dispatch_async(blockedLog.loggingQueue, ^{
+        dispatch_semaphore_wait(gate, DISPATCH_TIME_FOREVER);
+    });
+    [log log:NO level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"independent"];
+    XCTAssertEqualObjects([logger.messages valueForKey:@"message"], @[@"independent"]);
+    XCTAssertEqual([DDLog logOwningLogger:logger], log);
+    dispatch_semaphore_signal(gate);
+
+    [log removeLogger:logger];
+    [log flushLog];
+    XCTAssertNil([DDLog logOwningLogger:logger]);
+}
+
+#pragma mark - Bounded queue
+
+- (void)testDropNewestOverflowPolicyDropsAndReportsMessages {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    logger.delay = 2000;
+    [log addLogger:logger];
+    log.maximumQueueSize = 5;
+    log.overflowPolicy = DDLogOverflowPolicyDropNewest;
+
+    const NSUInteger count = 100;
+    for (NSUInteger i = 0; i < count; i++) {
+        [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"%lu", (unsigned long)i];
+    }
+    [log flushLog];
+
+    __auto_type droppedCount = log.droppedMessageCount;
+    XCTAssertGreaterThan(droppedCount, 0);
+
+    NSUInteger deliveredCount = 0;
+    NSUInteger reportedCount = 0;
+    for (DDLogMessage *message in logger.messages) {
+        if (message.flag == DDLogFlagWarning) {
+            XCTAssertTrue([message.message containsString:@"dropped"]);
+            reportedCount += (NSUInteger)message.message.integerValue;
+        } else {
+            deliveredCount++;
+        }
+    }
+    XCTAssertEqual(deliveredCount, count - droppedCount);
+    XCTAssertEqual(reportedCount, droppedCount);
+}
+
+- (void)testBlockOverflowPolicyDeliversAllMessages {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    logger.delay = 500;
+    [log addLogger:logger];
+    log.maximumQueueSize = 2;
+    log.overflowPolicy = DDLogOverflowPolicyBlock;
+
+    const NSUInteger count = 50;
+    dispatch_apply(2, dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^(size_t thread) {
+        for (NSUInteger i = 0; i < count; i++) {
+            [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:(NSInteger)thread file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"%lu", (unsigned long)i];
+        }
+    });
+    [log flushLog];
+
+    XCTAssertEqual(log.droppedMessageCount, 0);
+    XCTAssertEqual(logger.messages.count, 2 * count);
+}
+
+- (void)testDropBelowFlagOverflowPolicyKeepsSevereMessages {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    logger.delay = 500;
+    [log addLogger:logger];
+    log.maximumQueueSize = 4;
+    log.overflowPolicy = DDLogOverflowPolicyDropBelowFlag;
+    log.overflowThresholdFlag = DDLogFlagWarning;
+
+    const NSUInteger count = 50;
+    for (NSUInteger i = 0; i < count; i++) {
+        [log log:YES level:DDLogLevelAll flag:DDLogFlagWarning context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"warning %lu", (unsigned long)i];
+        [log log:YES level:DDLogLevelAll flag:DDLogFlagVerbose context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"verbose %lu", (unsigned long)i];
+    }
+    [log flushLog];
+
+    NSUInteger warningCount = 0;
+    NSUInteger verboseCount = 0;
+    for (DDLogMessage *message in logger.messages) {
+        if ([message.message hasPrefix:@"warning"]) {
+            warningCount++;
+        } else if (message.flag == DDLogFlagVerbose) {
+            verboseCount++;
+        }
+    }
+    XCTAssertEqual(warningCount, count);
+    XCTAssertEqual(verboseCount, count - log.droppedMessageCount);
+}
+
+- (void)testPendingMessagesPerLoggerDecouplesLoggers {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type slowLogger = [DDGatedLogger new];
+    __auto_type fastLogger = [DDRecordingLogger new];
+    // The window of the slow logger fills up long before the fast logger is done.
+    log.maximumPendingMessagesPerLogger = 5;
+    [log addLogger:slowLogger];
+    [log addLogger:fastLogger];
+
+    const NSUInteger count = 50;
+    for (NSUInteger i = 0; i < count; i++) {
+        [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"%lu", (unsigned long)i];
+    }
+
+    __auto_type fastLoggerDone = [[XCTNSPredicateExpectation alloc] initWithPredicate:[NSPredicate predicateWithBlock:^BOOL(id object, NSDictionary *bindings) {
+        return fastLogger.messages.count == count;
+    }] object:nil];
+    [self waitForExpectations:@[fastLoggerDone] timeout:5];
+    XCTAssertEqual(slowLogger.messages.count, 0);
+
+    [slowLogger open];
+    [log flushLog];
+
+    XCTAssertEqual(slowLogger.messages.count, count);
+    for (NSUInteger i = 0; i < count; i++) {
+        XCTAssertEqualObjects(slowLogger.messages[i].message, ([NSString stringWithFormat:@"%lu", (unsigned long)i]));
+        XCTAssertEqualObjects(fastLogger.messages[i].message, ([NSString stringWithFormat:@"%lu", (unsigned long)i]));
+    }
+}
+
+- (void)testAggregateLevelFollowsLoggers {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type infoLogger = [DDRecordingLogger new];
+    __auto_type errorLogger = [DDRecordingLogger new];
+    XCTAssertEqual(log.aggregateLevel, DDLogLevelOff);
+
+    // Log messages following the addition must not be discarded.
+    [log addLogger:infoLogger withLevel:DDLogLevelInfo];
+    XCTAssertEqual(log.aggregateLevel, DDLogLevelInfo);
+    [log log:NO level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"info"];
+    [log log:NO level:DDLogLevelAll flag:DDLogFlagDebug context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"debug"];
+    XCTAssertEqual(infoLogger.messages.count, 1);
+
+    [log addLogger:errorLogger withLevel:DDLogLevelError];
+    [log removeLogger:infoLogger];
+    [log flushLog];
+    XCTAssertEqual(log.aggregateLevel, DDLogLevelError);
+
+    [log removeAllLoggers];
+    [log flushLog];
+    XCTAssertEqual(log.aggregateLevel, DDLogLevelOff);
+}
+
+- (void)testRecycledLogMessagesAreReused {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDCopyingLogger new];
+    log.recyclesLogMessages = YES;
+    [log addLogger:logger];
+
+    const NSUInteger count = 100;
+    for (NSUInteger i = 0; i < count; i++) {
+        [log log:NO level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"%lu", (unsigned long)i];
+    }
+    [log flushLog];
+
+    XCTAssertEqual(logger.messages.count, count);
+    XCTAssertLessThan(logger.distinctMessageCount, count);
+    for (NSUInteger i = 0; i < count; i++) {
+        XCTAssertEqualObjects(logger.messages[i].message, ([NSString stringWithFormat:@"%lu", (unsigned long)i]));
+    }
+}
+
+- (void)testDeferredFormattingMatchesImmediateFormatting {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    log.defersMessageFormatting = YES;
+    [log addLogger:logger];
+
+    char buffer[] = "mutable";
+    __auto_type mutableString = [NSMutableString stringWithString:@"before"];
+    [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil
+      format:@"%d|%5.2f|%s|%@|%lu|%lld|%zu|%c|%x|%%|%@|%Lf|%@", -42, 3.14159, buffer, mutableString, 42UL, -7LL, (size_t)9, 'z', 255u, @[@1], 2.5L, nil];
+    buffer[0] = 'M';
+    [mutableString setString:@"after"];
+    [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil
+      format:@"%2$@ %1$@", @"positional", @"arguments"];
+    [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil
+      format:@"%*d", 4, 2];
+    [log flushLog];
+
+    __auto_type expected = [NSString stringWithFormat:@"%d|%5.2f|%s|%@|%lu|%lld|%zu|%c|%x|%%|%@|%Lf|%@", -42, 3.14159, "mutable", @"before", 42UL, -7LL, (size_t)9, 'z', 255u, @[@1], 2.5L, nil];
+    XCTAssertEqual(logger.messages.count, 3);
+    XCTAssertEqualObjects(logger.messages[0].message, expected);
+    XCTAssertEqualObjects(logger.messages[1].message, @"arguments positional");
+    XCTAssertEqualObjects(logger.messages[2].message, @"   2");
+}
+
+- (void)testDeferredFormattingDescribesObjectsOnTheCallingThread {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    log.defersMessageFormatting = YES;
+    [log addLogger:logger];
+
+    __auto_type object = [DDCountingDescription new];
+    __auto_type array = [NSMutableArray arrayWithObject:@"before"];
+    [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"%@ %@ %@", object, array.firstObject, @42];
+    [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"%@", array];
+    XCTAssertEqual(object.descriptionCount, 1);
+    [array addObject:@"after"];
+    [log flushLog];
+
+    // The message is only formatted once a logger asks for it.
+    __auto_type messages = logger.messages;
+    XCTAssertEqual(messages.count, 2);
+    XCTAssertEqualObjects(messages[0]->_message, @"%@ %@ %@");
+    XCTAssertEqualObjects(messages[0].message, @"described before 42");
+    XCTAssertEqual(messages[0].message, messages[0].message);
+    XCTAssertEqualObjects(messages[1].message, ([NSString stringWithFormat:@"%@", @[@"before"]]));
+    XCTAssertEqual(object.descriptionCount, 1);
+}
+
+- (void)testCachedMetadataFollowsThreadAndQueue {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    [log addLogger:logger];
+
+    __auto_type done = [self expectationWithDescription:@"thread done"];
+    __auto_type thread = [[NSThread alloc] initWithBlock:^{
+        NSThread.currentThread.name = @"first";
+        [log log:NO level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"1"];
+        NSThread.currentThread.name = @"second";
+        [log log:NO level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"2"];
+        dispatch_sync(dispatch_queue_create("cocoalumberjack.tests.metadata", NULL), ^{
+            [log log:NO level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"3"];
+        });
+        [done fulfill];
+    }];
+    [thread start];
+    [self waitForExpectations:@[done] timeout:5];
+    [log log:NO level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"4"];
+
+    __auto_type messages = logger.messages;
+    XCTAssertEqual(messages.count, 4);
+    XCTAssertEqualObjects(messages[0].threadName, @"first");
+    XCTAssertEqualObjects(messages[1].threadName, @"second");
+    XCTAssertEqualObjects(messages[0].threadID, messages[1].threadID);
+    XCTAssertEqualObjects(messages[1].threadID, messages[2].threadID);
+    XCTAssertNotEqualObjects(messages[2].threadID, messages[3].threadID);
+    XCTAssertEqualObjects(messages[2].queueLabel, @"cocoalumberjack.tests.metadata");
+    XCTAssertNotEqualObjects(messages[3].queueLabel, @"cocoalumberjack.tests.metadata");
+    for (DDLogMessage *message in messages) {
+        XCTAssertEqualObjects(message.fileName, @"DDLogTests");
+        XCTAssertEqualObjects(message.file, @(__FILE__));
+    }
+}
+
+- (void)testCallsiteStringsAreSharedByItsMessages {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    [log addLogger:logger];
+
+    for (NSUInteger i = 0; i < 3; i++) {
+        LOG_MAYBE_CALLSITE_TO_DDLOG(log, NO, DDLogLevelAll, DDLogFlagInfo, 0, nil, __PRETTY_FUNCTION__, @"%lu", (unsigned long)i);
+    }
+
+    __auto_type messages = logger.messages;
+    XCTAssertEqual(messages.count, 3);
+    XCTAssertTrue(messages[0].callsite != NULL);
+    XCTAssertEqual(messages[0].callsite, messages[2].callsite);
+    XCTAssertEqual(messages[0].file, messages[2].file);
+    XCTAssertEqual(messages[0].fileName, messages[2].fileName);
+    XCTAssertEqualObjects(messages[0].file, @(__FILE__));
+    XCTAssertEqualObjects(messages[0].fileName, @"DDLogTests");
+    XCTAssertEqualObjects(messages[0].function, @(__PRETTY_FUNCTION__));
+    XCTAssertEqualObjects(messages[2].message, @"2");
+    XCTAssertEqualObjects([messages[1] copy], messages[1]);
+
+    // Without a callsite, the function doesn't need to be a constant.
+    __auto_type function = NSStringFromSelector(_cmd).UTF8String;
+    LOG_MAYBE_TO_DDLOG(log, NO, DDLogLevelAll, DDLogFlagInfo, 0, nil, function, @"no callsite");
+    XCTAssertEqual(logger.messages.count, 4);
+    XCTAssertTrue(logger.messages[3].callsite == NULL);
+    XCTAssertEqualObjects(logger.messages[3].function, NSStringFromSelector(_cmd));
+
+    __auto_type callsite = DDLogCallsiteForLocation(__FILE__, __PRETTY_FUNCTION__, __LINE__);
+    XCTAssertTrue(callsite != NULL);
+    XCTAssertEqual(callsite, DDLogCallsiteForLocation(callsite->file, callsite->function, callsite->line));
+}
+
+- (void)testTimestampsAreCapturedRaw {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    [log addLogger:logger];
+
+    __auto_type before = [NSDate date];
+    for (NSUInteger i = 0; i < 10; i++) {
+        LOG_MAYBE_CALLSITE_TO_DDLOG(log, NO, DDLogLevelAll, DDLogFlagInfo, 0, nil, __PRETTY_FUNCTION__, @"%lu", (unsigned long)i);
+    }
+    __auto_type after = [NSDate date];
+
+    __auto_type messages = logger.messages;
+    XCTAssertEqual(messages.count, 10);
+    for (NSUInteger i = 0; i < messages.count; i++) {
+        __auto_type message = messages[i];
+        XCTAssertNotNil(message->_timestamp);
+        XCTAssertEqualWithAccuracy(message.timestamp.timeIntervalSince1970,
+                                   (NSTimeInterval)message.timestampNanoseconds / NSEC_PER_SEC, 0.000001);
+        XCTAssertGreaterThanOrEqual(message.timestamp.timeIntervalSince1970, before.timeIntervalSince1970 - 0.001);
+        XCTAssertLessThanOrEqual(message.timestamp.timeIntervalSince1970, after.timeIntervalSince1970 + 0.001);
+        if (i > 0) {
+            XCTAssertGreaterThanOrEqual(message.monotonicTimestampNanoseconds, messages[i - 1].monotonicTimestampNanoseconds);
+        }
+    }
+    XCTAssertEqualObjects([messages[3] copy], messages[3]);
+
+    __auto_type date = [NSDate dateWithTimeIntervalSince1970:1000.5];
+    __auto_type message = [[DDLogMessage alloc] initWithMessage:@"message"
+                                                          level:DDLogLevelAll
+                                                           flag:DDLogFlagInfo
+                                                        context:0
+                                                           file:@(__FILE__)
+                                                       function:@(__PRETTY_FUNCTION__)
+                                                           line:__LINE__
+                                                            tag:nil
+                                                        options:(DDLogMessageOptions)0
+                                                      timestamp:date];
+    XCTAssertEqualObjects(message.timestamp, date);
+    XCTAssertEqual(message.timestampNanoseconds, 1000500000000ull);
+}
+
+- (void)testDuplicatesAreSuppressedAndSummarized {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    [log addLogger:logger];
+    log.suppressionMode = DDLogSuppressionModeCallsite;
+    log.suppressionWindow = 60;
+
+    for (NSUInteger i = 0; i < 5; i++) {
+        LOG_MAYBE_CALLSITE_TO_DDLOG(log, NO, DDLogLevelWarning, DDLogFlagWarning, 0, nil, __PRETTY_FUNCTION__, @"retry %lu", (unsigned long)i);
+    }
+    [log flushLog];
+
+    __auto_type messages = logger.messages;
+    XCTAssertEqual(messages.count, 2);
+    XCTAssertEqualObjects(messages[0].message, @"retry 0");
+    XCTAssertEqualObjects(messages[1].message, @"Last message repeated 4 times");
+    XCTAssertEqual(messages[1].line, messages[0].line);
+    XCTAssertEqual(messages[1].flag, DDLogFlagWarning);
+    XCTAssertEqual(messages[1].level, DDLogLevelWarning);
+    XCTAssertEqual(log.suppressedMessageCount, 4);
+
+    log.suppressionMode = DDLogSuppressionModeMessage;
+    log.suppressionWindow = 0.1;
+    for (NSUInteger i = 0; i < 3; i++) {
+        [log log:NO level:DDLogLevelAll flag:DDLogFlagWarning context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"same %@", @"message"];
+    }
+
+    // The summary is logged once the window closes, without further log messages.
+    __auto_type expectation = [self expectationWithDescription:@"summary"];
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.5 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [expectation fulfill];
+    });
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [log flushLog];
+
+    messages = logger.messages;
+    XCTAssertEqual(messages.count, 4);
+    XCTAssertEqualObjects(messages[2].message, @"same message");
+    XCTAssertEqualObjects(messages[3].message, @"Last message repeated 2 times");
+    XCTAssertEqual(log.suppressedMessageCount, 6);
+}
+
+- (void)testMessageSuppressionComparesFormattedMessagesWhenDeferring {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    [log addLogger:logger];
+    log.defersMessageFormatting = YES;
+    log.suppressionMode = DDLogSuppressionModeMessage;
+    log.suppressionWindow = 60;
+
+    for (NSString *user in @[@"alice", @"bob", @"bob"]) {
+        [log log:NO level:DDLogLevelAll flag:DDLogFlagWarning context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"user %@", user];
+    }
+    [log flushLog];
+
+    __auto_type messages = logger.messages;
+    XCTAssertEqual(messages.count, 2);
+    XCTAssertEqualObjects(messages[0].message, @"user alice");
+    XCTAssertEqualObjects(messages[1].message, @"user bob");
+    XCTAssertEqual(log.suppressedMessageCount, 1);
+}
+
+- (void)testSamplingPoliciesKeepASampleOfLogMessages {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    [log addLogger:logger];
+
+    __auto_type everyTenth = [DDLogSamplingPolicy everyNthPolicyWithInterval:10];
+    [log setSamplingPolicy:everyTenth forContext:1 flags:DDLogFlagDebug | DDLogFlagVerbose];
+    XCTAssertEqual([log samplingPolicyForContext:1 flag:DDLogFlagVerbose], everyTenth);
+    XCTAssertNil([log samplingPolicyForContext:1 flag:DDLogFlagInfo]);
+    XCTAssertNil([log samplingPolicyForContext:0 flag:DDLogFlagDebug]);
+
+    for (NSUInteger i = 0; i < 100; i++) {
+        [log log:NO level:DDLogLevelAll flag:DDLogFlagDebug context:1 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"%lu", (unsigned long)i];
+        [log log:NO level:DDLogLevelAll flag:DDLogFlagInfo context:1 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"info"];
+    }
+    XCTAssertEqual(logger.messages.count, 110);
+    XCTAssertEqualObjects(logger.messages[0].message, @"0");
+    XCTAssertEqual(everyTenth.sampledInCount, 10);
+    XCTAssertEqual(everyTenth.sampledOutCount, 90);
+    XCTAssertEqual(log.sampledOutMessageCount, 90);
+
+    // The same log statements are kept every time.
+    __auto_type none = [DDLogSamplingPolicy callsitePolicyWithRate:0];
+    __auto_type all = [DDLogSamplingPolicy callsitePolicyWithRate:1];
+    __auto_type half = [DDLogSamplingPolicy callsitePolicyWithRate:0.5];
+    [log setSamplingPolicy:none forContext:2 flags:DDLogFlagInfo];
+    [log setSamplingPolicy:all forContext:3 flags:DDLogFlagInfo];
+    [log setSamplingPolicy:half forContext:4 flags:DDLogFlagInfo];
+    for (NSUInteger i = 0; i < 10; i++) {
+        LOG_MAYBE_CALLSITE_TO_DDLOG(log, NO, DDLogLevelAll, DDLogFlagInfo, 2, nil, __PRETTY_FUNCTION__, @"none");
+        LOG_MAYBE_CALLSITE_TO_DDLOG(log, NO, DDLogLevelAll, DDLogFlagInfo, 3, nil, __PRETTY_FUNCTION__, @"all");
+        LOG_MAYBE_CALLSITE_TO_DDLOG(log, NO, DDLogLevelAll, DDLogFlagInfo, 4, nil, __PRETTY_FUNCTION__, @"half");
+    }
+    XCTAssertEqual(none.sampledOutCount, 10);
+    XCTAssertEqual(all.sampledInCount, 10);
+    XCTAssertTrue(half.sampledInCount == 0 || half.sampledInCount == 10);
+
+    __auto_type random = [DDLogSamplingPolicy randomPolicyWithRate:0.5];
+    [log setSamplingPolicy:random forContext:5 flags:DDLogFlagInfo];
+    for (NSUInteger i = 0; i < 1000; i++) {
+        LOG_MAYBE_CALLSITE_TO_DDLOG(log, YES, DDLogLevelAll, DDLogFlagInfo, 5, nil, __PRETTY_FUNCTION__, @"random");
+    }
+    XCTAssertEqual(random.sampledInCount + random.sampledOutCount, 1000);
+    XCTAssertGreaterThan(random.sampledInCount, 300);
+    XCTAssertLessThan(random.sampledInCount, 700);
+
+    // Removing the policy keeps all the log messages again.
+    [log setSamplingPolicy:nil forContext:1 flags:DDLogFlagDebug | DDLogFlagVerbose];
+    XCTAssertNil([log samplingPolicyForContext:1 flag:DDLogFlagDebug]);
+    [log log:NO level:DDLogLevelAll flag:DDLogFlagDebug context:1 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"kept"];
+    [log flushLog];
+    XCTAssertEqualObjects(logger.messages.lastObject.message, @"kept");
+    XCTAssertEqual(everyTenth.sampledOutCount, 90);
+}
+
+- (void)testStatisticsDescribeThePipeline {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type infoLogger = [DDRecordingLogger new];
+    __auto_type slowLogger = [DDRecordingLogger new];
+    slowLogger.delay = 2000;
+    [log addLogger:infoLogger withLevel:DDLogLevelInfo];
+    [log addLogger:slowLogger withLevel:DDLogLevelAll];
+    log.collectsStatistics = YES;
+
+    for (NSUInteger i = 0; i < 10; i++) {
+        [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"info"];
+        [log log:NO level:DDLogLevelAll flag:DDLogFlagDebug context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"debug"];
+    }
+    [log flushLog];
+
+    __auto_type statistics = log.statistics;
+    XCTAssertEqual([statistics enqueuedMessageCountForFlag:DDLogFlagInfo], 10);
+    XCTAssertEqual([statistics enqueuedMessageCountForFlag:DDLogFlagInfo | DDLogFlagDebug], 20);
+    XCTAssertEqual([statistics deliveredMessageCountForFlag:DDLogFlagDebug], 10);
+    XCTAssertEqual(statistics.enqueuedMessageCount, 20);
+    XCTAssertEqual(statistics.deliveredMessageCount, 20);
+    XCTAssertEqual(statistics.queueDepth, 0);
+    XCTAssertGreaterThanOrEqual(statistics.maximumQueueDepth, 1);
+    XCTAssertEqual(statistics.loggerStatistics.count, 2);
+
+    __auto_type infoStatistics = statistics.loggerStatistics[0];
+    __auto_type slowStatistics = statistics.loggerStatistics[1];
+    XCTAssertEqual(infoStatistics.logger, infoLogger);
+    XCTAssertEqual(infoStatistics.deliveredMessageCount, 10);
+    XCTAssertEqual(slowStatistics.deliveredMessageCount, 20);
+    XCTAssertGreaterThanOrEqual(slowStatistics.maximumServiceTime, 0.002);
+    XCTAssertGreaterThanOrEqual(slowStatistics.medianServiceTime, 0.001);
+    XCTAssertLessThanOrEqual(slowStatistics.medianServiceTime, slowStatistics.ninetyNinthPercentileServiceTime);
+    XCTAssertLessThanOrEqual(slowStatistics.ninetyNinthPercentileServiceTime, slowStatistics.maximumServiceTime);
+    XCTAssertLessThan(infoStatistics.maximumServiceTime, slowStatistics.maximumServiceTime);
+    XCTAssertEqualObjects(slowStatistics.additionalStatistics, @{});
+
+    // Nothing is collected once disabled.
+    log.collectsStatistics = NO;
+    [log log:NO level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"info"];
+    XCTAssertEqual(log.statistics.enqueuedMessageCount, 20);
+}
+
+- (void)testStatisticsDontWaitForTheLoggingQueue {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type logger = [DDRecordingLogger new];
+    [log addLogger:logger];
+    log.collectsStatistics = YES;
+    [log log:NO level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"info"];
+
+    __auto_type gate = dispatch_semaphore_create(0);
+    dispatch_async(log.loggingQueue, ^{
+        dispatch_semaphore_wait(gate, DISPATCH_TIME_FOREVER);
+    });
+    __auto_type statistics = log.statistics;
+    dispatch_semaphore_signal(gate);
+
+    XCTAssertEqual(statistics.loggerStatistics.count, 1);
+    XCTAssertEqual(statistics.loggerStatistics.firstObject.logger, logger);
+    XCTAssertEqual(statistics.loggerStatistics.firstObject.deliveredMessageCount, 1);
+}
+
+- (void)testFlushWithTimeoutReportsUnflushedLoggers {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type gatedLogger = [DDGatedLogger new];
+    [log addLogger:gatedLogger];
+
+    // The logging queue is stuck behind the gated logger.
+    [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"stuck"];
+    __auto_type unflushedLoggers = [log flushLogWithTimeout:0.1];
+    XCTAssertEqual(unflushedLoggers.count, 1);
+    XCTAssertEqual(unflushedLoggers.firstObject, gatedLogger);
+
+    [gatedLogger open];
+    XCTAssertEqualObjects([log flushLogWithTimeout:5], @[]);
+    XCTAssertEqual(gatedLogger.messages.count, 1);
+
+    __auto_type expectation = [self expectationWithDescription:@"flushed"];
+    [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"flushed"];
+    [log flushLogWithCompletion:^{
+        XCTAssertEqual(gatedLogger.messages.count, 2);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+}
+
+- (void)testFlushWithTimeoutShedsDiscardedFlags {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type gatedLogger = [DDGatedLogger new];
+    [log addLogger:gatedLogger];
+
+    [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"stuck"];
+    for (NSUInteger i = 0; i < 5; i++) {
+        [log log:YES level:DDLogLevelAll flag:DDLogFlagDebug context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"debug"];
+    }
+    [log log:YES level:DDLogLevelAll flag:DDLogFlagError context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"error"];
+
+    __auto_type expectation = [self expectationWithDescription:@"flushed"];
+    [log flushLogWithTimeout:5 discardingFlags:DDLogFlagDebug | DDLogFlagVerbose completion:^(NSArray<id<DDLogger>> *unflushedLoggers) {
+        XCTAssertEqualObjects(unflushedLoggers, @[]);
+        [expectation fulfill];
+    }];
+    [gatedLogger open];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    // Debug messages are logged again once the flush is over.
+    [log log:NO level:DDLogLevelAll flag:DDLogFlagDebug context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"debug"];
+
+    // The discarded messages aren't dropped because the queue was full, so no warning reports them.
+    __auto_type messages = [gatedLogger.messages valueForKey:@"message"];
+    XCTAssertEqual(log.discardedMessageCount, 5);
+    XCTAssertEqual(log.droppedMessageCount, 0);
+    XCTAssertEqualObjects(messages, (@[@"stuck", @"error", @"debug"]));
+}
+
+- (void)testFlushOnlyShedsMessagesLoggedBeforeItStarted {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type gatedLogger = [DDGatedLogger new];
+    [log addLogger:gatedLogger];
+
+    [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"stuck"];
+    [log log:YES level:DDLogLevelAll flag:DDLogFlagDebug context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"before"];
+
+    __auto_type expectation = [self expectationWithDescription:@"flushed"];
+    [log flushLogWithTimeout:5 discardingFlags:DDLogFlagDebug completion:^(NSArray<id<DDLogger>> *unflushedLoggers) {
+        XCTAssertEqualObjects(unflushedLoggers, @[]);
+        [expectation fulfill];
+    }];
+    // Still queued behind the stuck message while the flush is in progress.
+    [log log:YES level:DDLogLevelAll flag:DDLogFlagDebug context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"after"];
+    [gatedLogger open];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [log flushLog];
+
+    __auto_type messages = [gatedLogger.messages valueForKey:@"message"];
+    XCTAssertEqual(log.discardedMessageCount, 1);
+    XCTAssertEqualObjects(messages, (@[@"stuck", @"after"]));
+}
+
+- (void)testOverlappingFlushesKeepSheddingUntilTheLastOneIsOver {
+    __auto_type log = [[DDLog alloc] init];
+    __auto_type gatedLogger = [DDGatedLogger new];
+    [log addLogger:gatedLogger];
+
+    [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"stuck"];
+    for (NSUInteger i = 0; i < 3; i++) {
+        [log log:YES level:DDLogLevelAll flag:DDLogFlagDebug context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"debug"];
+    }
+
+    __auto_type shortFlush = [self expectationWithDescription:@"short flush"];
+    [log flushLogWithTimeout:0.1 discardingFlags:DDLogFlagDebug completion:^(NSArray<id<DDLogger>> *unflushedLoggers) {
+        XCTAssertEqual(unflushedLoggers.count, 1);
+        [shortFlush fulfill];
+    }];
+    __auto_type longFlush = [self expectationWithDescription:@"long flush"];
+    [log flushLogWithTimeout:5 discardingFlags:DDLogFlagDebug completion:^(NSArray<id<DDLogger>> *unflushedLoggers) {
+        XCTAssertEqualObjects(unflushedLoggers, @[]);
+        [longFlush fulfill];
+    }];
+    [self waitForExpectations:@[shortFlush] timeout:5];
+
+    // The debug messages reach the front of the logging queue after the short flush is over,
+    // the long flush still sheds them.
+    [gatedLogger open];
+    [self waitForExpectations:@[longFlush] timeout:5];
+
+    XCTAssertEqual(log.discardedMessageCount, 3);
+}
+
+- (void)testWorkerPoolKeepsLoggersSerialAndOrdered {
+    __auto_type log = [[DDLog alloc] init];
+    log.schedulerMode = DDLogSchedulerModeWorkerPool;
+    log.maximumPendingMessagesPerLogger = 10;
+
+    __auto_type loggers = [NSMutableArray<DDRecordingLogger *> new];
+    for (NSUInteger i = 0; i < 16; i++) {
+        __auto_type logger = [DDRecordingLogger new];
+        logger.delay = 100;
+        [loggers addObject:logger];
+        [log addLogger:logger];
+    }
+
+    const NSUInteger count = 100;
+    __auto_type expectedMessages = [NSMutableArray<NSString *> new];
+    for (NSUInteger i = 0; i < count; i++) {
+        [log log:YES level:DDLogLevelAll flag:DDLogFlagInfo context:0 file:__FILE__ function:__PRETTY_FUNCTION__ line:__LINE__ tag:nil format:@"%lu", (unsigned long)i];
+        [expectedMessages addObject:[NSString stringWithFormat:@"%lu", (unsigned long)i]];
+    }
+    [log flushLog];
+
+    for (DDRecordingLogger *logger in loggers) {
+        XCTAssertEqualObjects([logger.messages valueForKey:@"message"], expectedMessages);
+    }
+    [log removeAllLoggers];
+}
+
+- (void)testRegisteredClassesAreIndexed {
+    XCTAssertTrue([DDLog.registeredClasses containsObject:[DDRegisteredTestClass class]]);
+    XCTAssertTrue([DDLog.registeredClassNames containsObject:@"DDRegisteredTestClass"]);
+    XCTAssertFalse([DDLog.registeredClasses containsObject:[DDLogTests class]]);
+
+    [DDLog setLevel:DDLogLevelVerbose forClassWithName:@"DDRegisteredTestClass"];
+    XCTAssertEqual([DDLog levelForClass:[DDRegisteredTestClass class]], DDLogLevelVerbose);
+    XCTAssertEqual([DDLog levelForClassWithName:@"DDLogTests"], (DDLogLevel)-1);
+    [DDLog setLevel:DDLogLevelWarning forClass:[DDRegisteredTestClass class]];
+    XCTAssertEqual(DDRegisteredTestClassLogLevel, DDLogLevelWarning);
+}
+
+static DDLogLevel DDRuntimeTestClassLevel(id __unused self, SEL __unused _cmd) {
+    return DDLogLevelInfo;
+}
+
+static void DDRuntimeTestClassSetLevel(id __unused self, SEL __unused _cmd, DDLogLevel __unused level) {}
+
+- (void)testClassesCreatedAtRuntimeAreIndexed {
+    // Index all classes before the new one is created.
+    XCTAssertTrue([DDLog.registeredClasses containsObject:[DDRegisteredTestClass class]]);
+
+    __auto_type name = [NSString stringWithFormat:@"DDRuntimeTestClass%@", [NSUUID UUID].UUIDString];
+    Class runtimeClass = objc_allocateClassPair([NSObject class], name.UTF8String, 0);
+    XCTAssertNotNil(runtimeClass);
+    class_addMethod(object_getClass(runtimeClass), @selector(ddLogLevel), (IMP)DDRuntimeTestClassLevel, "Q@:");
+    class_addMethod(object_getClass(runtimeClass), @selector(ddSetLogLevel:), (IMP)DDRuntimeTestClassSetLevel, "v@:Q");
+    objc_registerClassPair(runtimeClass);
+
+    XCTAssertTrue([DDLog.registeredClassNames containsObject:name]);
+    XCTAssertEqual([DDLog levelForClassWithName:name], DDLogLevelInfo);
+}
+
+- (void)testNamedLevelsAreInherited {
+    XCTAssertEqual(DDLogLevelForName(&DDLogTestsRetryName), DDLogLevelAll);
+
+    [DDLog setLevel:DDLogLevelWarning forName:@"ddlogtests.net"];
+    XCTAssertEqual(DDLogLevelForName(&DDLogTestsRetryName), DDLogLevelWarning);
+
+    [DDLog setLevel:DDLogLevelVerbose forName:@"ddlogtests.net.http"];
+    XCTAssertEqual(DDLogLevelForName(&DDLogTestsRetryName), DDLogLevelVerbose);
+    XCTAssertEqual([DDLog levelForName:@"ddlogtests.net.dns"], DDLogLevelWarning);
+
+    [DDLog removeLevelForName:@"ddlogtests.net.http"];
+    XCTAssertEqual(DDLogLevelForName(&DDLogTestsRetryName), DDLogLevelWarning);
+
+    [DDLog removeLevelForName:@"ddlogtests.net"];
+    XCTAssertEqual(DDLogLevelForName(&DDLogTestsRetryName), DDLogLevelAll);
+}
+
+- (void)testNamedLevelsBeyondTheFirstChunkOfTheTable {
+    // Names must live forever, so neither the names nor their storage are freed.
+    const NSUInteger count = 2000;
+    DDLogName *names = calloc(count, sizeof(DDLogName));
+    for (NSUInteger i = 0; i < count; i++) {
+        names[i].name = strdup([NSString stringWithFormat:@"ddlogtests.many.%lu", (unsigned long)i].UTF8String);
+        XCTAssertEqual(DDLogLevelForName(&names[i]), DDLogLevelAll);
+    }
+
+    [DDLog setLevel:DDLogLevelError forName:@"ddlogtests.many"];
+    XCTAssertEqual(DDLogLevelForName(&names[0]), DDLogLevelError);
+    XCTAssertEqual(DDLogLevelForName(&names[count - 1]), DDLogLevelError);
+    [DDLog removeLevelForName:@"ddlogtests.many"];
+    XCTAssertEqual(DDLogLevelForName(&names[count - 1]), DDLogLevelAll);
+}
+
 @end